@@ -0,0 +1,92 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <squareball.h>
+
+// helpers shared by benchmarks. not part of the library.
+
+
+static inline uint64_t
+bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static inline uint64_t
+bench_rand(uint64_t *state)
+{
+    // xorshift64*, deterministic and good enough to generate keys.
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+
+static inline size_t*
+bench_sizes(int argc, char **argv, size_t *n_sizes, const size_t *defaults,
+    size_t n_defaults)
+{
+    // sizes may be overriden by command line arguments.
+    if (argc <= 1) {
+        size_t *rv = malloc(n_defaults * sizeof(size_t));
+        for (size_t i = 0; i < n_defaults; i++)
+            rv[i] = defaults[i];
+        *n_sizes = n_defaults;
+        return rv;
+    }
+    size_t *rv = malloc((argc - 1) * sizeof(size_t));
+    for (int i = 1; i < argc; i++)
+        rv[i - 1] = strtoull(argv[i], NULL, 10);
+    *n_sizes = argc - 1;
+    return rv;
+}
+
+
+static inline char**
+bench_keys(size_t n, uint64_t seed)
+{
+    // keys with long shared prefixes and a wide fan-out level, similar to
+    // the ones found in configuration files and routing tables.
+    static const char *prefixes[] = {
+        "server.http.", "server.https.", "routes/api/v1/users/",
+        "routes/api/v1/groups/", "routes/static/", "cache.",
+    };
+    char **rv = malloc(n * sizeof(char*));
+    for (size_t i = 0; i < n; i++) {
+        uint64_t r = bench_rand(&seed);
+        rv[i] = sb_strdup_printf("%s%c%08zx.%04x",
+            prefixes[r % (sizeof(prefixes) / sizeof(prefixes[0]))],
+            (int) ('0' + (r >> 8) % 75), i, (unsigned int) ((r >> 16) & 0xffff));
+    }
+    return rv;
+}
+
+
+static inline void
+bench_shuffle(char **keys, size_t n, uint64_t seed)
+{
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = bench_rand(&seed) % (i + 1);
+        char *tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+}
+
+#endif /* _BENCH_H */
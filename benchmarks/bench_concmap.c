@@ -0,0 +1,189 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+
+#include "bench.h"
+
+/*
+ * Multi-threaded benchmark for sb_concmap_t, compared to a regular
+ * sb_hashmap_t guarded by a mutex. Every thread looks up random keys, and
+ * one out of WRITE_RATIO operations inserts or removes one of its own keys.
+ * The share of the lock acquisitions of the concurrent map that had to wait
+ * is also reported.
+ *
+ * Usage: bench_concmap [NUM_THREADS ...]
+ */
+
+#define NUM_KEYS 100000
+#define NUM_CHURN_KEYS 1000
+#define OPS_PER_THREAD 1000000
+#define WRITE_RATIO 10
+
+typedef struct {
+    sb_hashmap_t *hashmap;
+    sb_concmap_t *concmap;
+    pthread_mutex_t *mutex;
+    char **keys;
+    char **churn_keys;
+    uint64_t seed;
+    size_t found;
+} bench_ctx_t;
+
+
+static void*
+worker(void *arg)
+{
+    bench_ctx_t *ctx = arg;
+    size_t churn = 0;
+    for (size_t i = 0; i < OPS_PER_THREAD; i++) {
+        uint64_t r = bench_rand(&ctx->seed);
+        if (r % WRITE_RATIO == 0) {
+            const char *key = ctx->churn_keys[churn];
+            churn = (churn + 1) % NUM_CHURN_KEYS;
+            if (ctx->concmap != NULL) {
+                if (!sb_concmap_remove(ctx->concmap, key))
+                    sb_concmap_insert(ctx->concmap, key, (void*) key);
+                continue;
+            }
+            pthread_mutex_lock(ctx->mutex);
+            if (!sb_hashmap_remove(ctx->hashmap, key))
+                sb_hashmap_insert(ctx->hashmap, key, (void*) key);
+            pthread_mutex_unlock(ctx->mutex);
+            continue;
+        }
+        const char *key = ctx->keys[(r / WRITE_RATIO) % NUM_KEYS];
+        if (ctx->concmap != NULL) {
+            if (sb_concmap_lookup(ctx->concmap, key) != NULL)
+                ctx->found++;
+            continue;
+        }
+        pthread_mutex_lock(ctx->mutex);
+        if (sb_hashmap_lookup(ctx->hashmap, key) != NULL)
+            ctx->found++;
+        pthread_mutex_unlock(ctx->mutex);
+    }
+    return NULL;
+}
+
+
+static double
+run(sb_hashmap_t *hashmap, sb_concmap_t *concmap, pthread_mutex_t *mutex,
+    char **keys, char ***churn_keys, size_t num_threads)
+{
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    bench_ctx_t *ctxs = malloc(num_threads * sizeof(bench_ctx_t));
+
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < num_threads; i++) {
+        bench_ctx_t ctx = {hashmap, concmap, mutex, keys, churn_keys[i],
+            0x5eed + i, 0};
+        ctxs[i] = ctx;
+        pthread_create(&threads[i], NULL, worker, &ctxs[i]);
+    }
+    for (size_t i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    uint64_t elapsed = bench_now() - start;
+
+    for (size_t i = 0; i < num_threads; i++) {
+        if (ctxs[i].found == 0) {
+            fprintf(stderr, "error: lookup returned unexpected data\n");
+            exit(1);
+        }
+    }
+
+    free(ctxs);
+    free(threads);
+    return (double) num_threads * OPS_PER_THREAD * 1000 / elapsed;
+}
+
+
+static void
+contention(sb_concmap_t *map, size_t *acquisitions, size_t *contended)
+{
+    *acquisitions = 0;
+    *contended = 0;
+    for (size_t i = 0; i < sb_concmap_num_shards(map); i++) {
+        size_t a, c;
+        sb_concmap_shard_stats(map, i, &a, &c);
+        *acquisitions += a;
+        *contended += c;
+    }
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {1, 2, 4, 8};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    size_t max_threads = 0;
+    for (size_t s = 0; s < n_sizes; s++)
+        if (sizes[s] > max_threads)
+            max_threads = sizes[s];
+
+    char **keys = bench_keys(NUM_KEYS, 0x5eed);
+    char ***churn_keys = malloc(max_threads * sizeof(char**));
+    for (size_t i = 0; i < max_threads; i++) {
+        churn_keys[i] = malloc(NUM_CHURN_KEYS * sizeof(char*));
+        for (size_t j = 0; j < NUM_CHURN_KEYS; j++)
+            churn_keys[i][j] = sb_strdup_printf("churn/%zu/%zu", i, j);
+    }
+
+    sb_hashmap_t *hashmap = sb_hashmap_new(NULL);
+    sb_concmap_t *concmap = sb_concmap_new(NULL);
+    if (concmap == NULL) {
+        fprintf(stderr, "error: concurrent hash maps not supported\n");
+        return 1;
+    }
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        sb_hashmap_insert(hashmap, keys[i], keys[i]);
+        sb_concmap_insert(concmap, keys[i], keys[i]);
+    }
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    printf("%10s  %16s  %16s  %8s  %10s\n", "threads", "mutex Mops/s",
+        "concmap Mops/s", "speedup", "contended");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        double locked_ops = run(hashmap, NULL, &mutex, keys, churn_keys,
+            sizes[s]);
+
+        size_t acq_before, cont_before, acq_after, cont_after;
+        contention(concmap, &acq_before, &cont_before);
+        double concurrent_ops = run(NULL, concmap, NULL, keys, churn_keys,
+            sizes[s]);
+        contention(concmap, &acq_after, &cont_after);
+
+        printf("%10zu  %16.2f  %16.2f  %7.2fx  %9.4f%%\n", sizes[s],
+            locked_ops, concurrent_ops, concurrent_ops / locked_ops,
+            100.0 * (cont_after - cont_before) / (acq_after - acq_before));
+    }
+
+    sb_hashmap_free(hashmap);
+    sb_concmap_free(concmap);
+    for (size_t i = 0; i < NUM_KEYS; i++)
+        free(keys[i]);
+    for (size_t i = 0; i < max_threads; i++) {
+        for (size_t j = 0; j < NUM_CHURN_KEYS; j++)
+            free(churn_keys[i][j]);
+        free(churn_keys[i]);
+    }
+    free(keys);
+    free(churn_keys);
+    free(sizes);
+    return 0;
+}
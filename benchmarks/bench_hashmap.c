@@ -0,0 +1,112 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Exact-match lookup benchmark for sb_hashmap_t, compared to sb_trie_t, with
+ * the same keys and elements. Small sizes are similar to configuration files,
+ * and are looked up repeatedly, to get stable measurements.
+ *
+ * Usage: bench_hashmap [NUM_KEYS ...]
+ */
+
+#define MIN_LOOKUPS 2000000
+
+
+static double
+trie_lookup_ns(sb_trie_t *trie, char **keys, size_t n, size_t rounds)
+{
+    size_t found = 0;
+    uint64_t start = bench_now();
+    for (size_t r = 0; r < rounds; r++)
+        for (size_t i = 0; i < n; i++)
+            found += sb_trie_lookup(trie, keys[i]) == keys[i];
+    double rv = (double) (bench_now() - start) / (n * rounds);
+    if (found != n * rounds) {
+        fprintf(stderr, "error: trie lookup returned unexpected data\n");
+        exit(1);
+    }
+    return rv;
+}
+
+
+static double
+hashmap_lookup_ns(sb_hashmap_t *map, char **keys, size_t n, size_t rounds)
+{
+    size_t found = 0;
+    uint64_t start = bench_now();
+    for (size_t r = 0; r < rounds; r++)
+        for (size_t i = 0; i < n; i++)
+            found += sb_hashmap_lookup(map, keys[i]) == keys[i];
+    double rv = (double) (bench_now() - start) / (n * rounds);
+    if (found != n * rounds) {
+        fprintf(stderr, "error: hash map lookup returned unexpected data\n");
+        exit(1);
+    }
+    return rv;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {32, 1000, 100000, 1000000};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    printf("%10s  %14s  %14s  %14s  %14s  %8s\n", "keys", "trie insert ms",
+        "map insert ms", "trie lookup ns", "map lookup ns", "speedup");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        if (n == 0)
+            continue;
+        size_t rounds = n < MIN_LOOKUPS ? MIN_LOOKUPS / n : 1;
+
+        char **keys = bench_keys(n, 0x5eed + n);
+
+        uint64_t start = bench_now();
+        sb_trie_t *trie = sb_trie_new(NULL);
+        for (size_t i = 0; i < n; i++)
+            sb_trie_insert(trie, keys[i], keys[i]);
+        double trie_insert_ms = (double) (bench_now() - start) / 1000000;
+
+        start = bench_now();
+        sb_hashmap_t *map = sb_hashmap_new(NULL);
+        for (size_t i = 0; i < n; i++)
+            sb_hashmap_insert(map, keys[i], keys[i]);
+        double map_insert_ms = (double) (bench_now() - start) / 1000000;
+
+        if (sb_hashmap_size(map) != sb_trie_size(trie)) {
+            fprintf(stderr, "error: sizes differ\n");
+            return 1;
+        }
+
+        bench_shuffle(keys, n, 0xbeef + n);
+        double trie_ns = trie_lookup_ns(trie, keys, n, rounds);
+        double map_ns = hashmap_lookup_ns(map, keys, n, rounds);
+
+        printf("%10zu  %14.2f  %14.2f  %14.1f  %14.1f  %7.2fx\n", n,
+            trie_insert_ms, map_insert_ms, trie_ns, map_ns, trie_ns / map_ns);
+
+        sb_trie_free(trie);
+        sb_hashmap_free(map);
+        for (size_t i = 0; i < n; i++)
+            free(keys[i]);
+        free(keys);
+    }
+
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Benchmark for splitting a buffer by newlines, with the original
+ * sb_str_split (strlen(3) called for every byte, and one allocation per
+ * piece), that is reimplemented below, sb_str_split and
+ * sb_str_split_iter_next. The original implementation is quadratic, and is
+ * only run for buffers up to LEGACY_MAX_KIB.
+ *
+ * Usage: bench_str_split [KIB ...]
+ */
+
+#define LEGACY_MAX_KIB 256
+
+
+static char**
+legacy_split(const char *str, char c, size_t max_pieces)
+{
+    char **rv = sb_malloc(sizeof(char*));
+    size_t i, start = 0, count = 0;
+    for (i = 0; i < strlen(str) + 1; i++) {
+        if (str[0] == '\0')
+            break;
+        if ((str[i] == c && (!max_pieces || count + 1 < max_pieces)) || str[i] == '\0') {
+            rv = sb_realloc(rv, (count + 1) * sizeof(char*));
+            rv[count] = sb_malloc(i - start + 1);
+            memcpy(rv[count], str + start, i - start);
+            rv[count++][i - start] = '\0';
+            start = i + 1;
+        }
+    }
+    rv = sb_realloc(rv, (count + 1) * sizeof(char*));
+    rv[count] = NULL;
+    return rv;
+}
+
+
+static size_t
+checksum(char **strv)
+{
+    size_t rv = 0;
+    for (size_t i = 0; strv[i] != NULL; i++)
+        rv += strlen(strv[i]) + 1;
+    return rv;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {16, 256, 4096, 65536};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    printf("%10s  %12s  %12s  %12s  %10s\n", "KiB", "legacy ns/B",
+        "split ns/B", "iter ns/B", "lines");
+
+    uint64_t state = 42;
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t total = sizes[s] * 1024;
+        if (total == 0)
+            continue;
+
+        // lines of 10 to 80 bytes.
+        char *buf = sb_malloc(total + 1);
+        for (size_t i = 0; i < total; i++)
+            buf[i] = 'a' + bench_rand(&state) % 26;
+        for (size_t i = bench_rand(&state) % 70 + 10; i < total;
+                i += bench_rand(&state) % 70 + 11)
+            buf[i] = '\n';
+        buf[total] = '\0';
+
+        char legacy_ns[16] = "-";
+        size_t legacy_sum = 0;
+        if (sizes[s] <= LEGACY_MAX_KIB) {
+            uint64_t start = bench_now();
+            char **strv = legacy_split(buf, '\n', 0);
+            legacy_sum = checksum(strv);
+            sb_strv_free(strv);
+            snprintf(legacy_ns, sizeof(legacy_ns), "%.3f",
+                (double) (bench_now() - start) / total);
+        }
+
+        uint64_t start = bench_now();
+        char **strv = sb_str_split(buf, '\n', 0);
+        size_t split_sum = checksum(strv);
+        size_t lines = sb_strv_length(strv);
+        sb_strv_free_packed(strv);
+        double split_ns = (double) (bench_now() - start) / total;
+
+        size_t iter_sum = 0;
+        sb_str_split_iter_t iter;
+        sb_strview_t piece;
+        start = bench_now();
+        sb_str_split_iter_init(&iter, buf, '\n', 0);
+        while (sb_str_split_iter_next(&iter, &piece))
+            iter_sum += piece.len + 1;
+        double iter_ns = (double) (bench_now() - start) / total;
+
+        if (split_sum != iter_sum ||
+            (sizes[s] <= LEGACY_MAX_KIB && legacy_sum != split_sum))
+        {
+            fprintf(stderr, "error: pieces differ\n");
+            return 1;
+        }
+        free(buf);
+
+        printf("%10zu  %12s  %12.3f  %12.3f  %10zu\n", sizes[s], legacy_ns,
+            split_ns, iter_ns, lines);
+    }
+
+    free(sizes);
+    return 0;
+}
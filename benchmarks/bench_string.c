@@ -0,0 +1,108 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Append benchmark for sb_string_t, compared to the original growth policy
+ * (buffer grown to the next multiple of 128 bytes on every append that
+ * doesn't fit), that is reimplemented below. Strings are built with appends
+ * of PIECE_LEN bytes, and the time per byte should not increase with the
+ * size of the string.
+ *
+ * Usage: bench_string [MIB ...]
+ */
+
+#define LEGACY_CHUNK_SIZE 128
+#define PIECE_LEN 100
+
+
+static sb_string_t*
+legacy_append_len(sb_string_t *str, const char *suffix, size_t len,
+    size_t *reallocs)
+{
+    size_t old_len = str->len;
+    str->len += len;
+    if (str->len + 1 > str->allocated_len) {
+        str->allocated_len = (((str->len + 1) / LEGACY_CHUNK_SIZE) + 1) *
+            LEGACY_CHUNK_SIZE;
+        str->str = sb_realloc(str->str, str->allocated_len);
+        (*reallocs)++;
+    }
+    memcpy(str->str + old_len, suffix, len);
+    str->str[str->len] = '\0';
+    return str;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {1, 16, 256, 1024};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    char piece[PIECE_LEN];
+    for (size_t i = 0; i < PIECE_LEN; i++)
+        piece[i] = 'a' + i % 26;
+
+    printf("%10s  %14s  %10s  %14s  %10s  %8s\n", "MiB", "legacy ns/B",
+        "reallocs", "sb_string ns/B", "reallocs", "speedup");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t total = sizes[s] * 1024 * 1024;
+        if (total == 0)
+            continue;
+        size_t n = total / PIECE_LEN;
+
+        size_t legacy_reallocs = 0;
+        sb_string_t *legacy = sb_malloc(sizeof(sb_string_t));
+        legacy->str = NULL;
+        legacy->len = 0;
+        legacy->allocated_len = 0;
+
+        uint64_t start = bench_now();
+        for (size_t i = 0; i < n; i++)
+            legacy = legacy_append_len(legacy, piece, PIECE_LEN,
+                &legacy_reallocs);
+        double legacy_ns = (double) (bench_now() - start) / total;
+        sb_string_free(legacy, true);
+
+        size_t reallocs = 0;
+        sb_string_t *str = sb_string_new();
+        size_t allocated_len = str->allocated_len;
+
+        start = bench_now();
+        for (size_t i = 0; i < n; i++) {
+            str = sb_string_append_len(str, piece, PIECE_LEN);
+            if (str->allocated_len != allocated_len) {
+                allocated_len = str->allocated_len;
+                reallocs++;
+            }
+        }
+        double string_ns = (double) (bench_now() - start) / total;
+
+        if (str->len != n * PIECE_LEN) {
+            fprintf(stderr, "error: string has unexpected length\n");
+            return 1;
+        }
+        sb_string_free(str, true);
+
+        printf("%10zu  %14.3f  %10zu  %14.3f  %10zu  %7.2fx\n", sizes[s],
+            legacy_ns, legacy_reallocs, string_ns, reallocs,
+            legacy_ns / string_ns);
+    }
+
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Benchmark for sb_string_append_printf, compared to the original
+ * implementation (output formatted into a temporary string allocated by
+ * sb_strdup_vprintf, and then appended), that is reimplemented below. Each
+ * round builds a string with N short formatted appends, like a serializer
+ * would do.
+ *
+ * Usage: bench_string_printf [N ...]
+ */
+
+#define ROUNDS_TOTAL 2000000
+
+
+static sb_string_t*
+legacy_append_printf(sb_string_t *str, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    char *tmp = sb_strdup_vprintf(format, ap);
+    va_end(ap);
+    str = sb_string_append(str, tmp);
+    free(tmp);
+    return str;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {1, 10, 100, 1000};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    printf("%10s  %14s  %14s  %8s\n", "N", "legacy ns/op", "printf ns/op",
+        "speedup");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        if (n == 0)
+            continue;
+        size_t rounds = ROUNDS_TOTAL / n;
+        if (rounds == 0)
+            rounds = 1;
+
+        size_t legacy_len = 0;
+        uint64_t start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            sb_string_t *str = sb_string_new();
+            for (size_t i = 0; i < n; i++)
+                str = legacy_append_printf(str, "key%zu=%d;", i, (int) r);
+            legacy_len += str->len;
+            sb_string_free(str, true);
+        }
+        double legacy_ns = (double) (bench_now() - start) / (rounds * n);
+
+        size_t len = 0;
+        start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            sb_string_t *str = sb_string_new();
+            for (size_t i = 0; i < n; i++)
+                str = sb_string_append_printf(str, "key%zu=%d;", i, (int) r);
+            len += str->len;
+            sb_string_free(str, true);
+        }
+        double printf_ns = (double) (bench_now() - start) / (rounds * n);
+
+        if (len != legacy_len) {
+            fprintf(stderr, "error: strings have different lengths\n");
+            return 1;
+        }
+
+        printf("%10zu  %14.1f  %14.1f  %7.2fx\n", n, legacy_ns, printf_ns,
+            legacy_ns / printf_ns);
+    }
+
+    free(sizes);
+    return 0;
+}
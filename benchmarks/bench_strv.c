@@ -0,0 +1,99 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Benchmark for string arrays, comparing arrays with one allocation per
+ * string (as sb_config_list_keys used to return), that are reimplemented
+ * below, with packed arrays, as returned by sb_strv_pack. Each round creates
+ * the array, reads all the strings and frees the array.
+ *
+ * Usage: bench_strv [N ...]
+ */
+
+#define ROUNDS_TOTAL 4000000
+
+
+static char**
+legacy_copy(char **strv, size_t n)
+{
+    char **rv = sb_malloc(sizeof(char*) * (n + 1));
+    for (size_t i = 0; i < n; i++)
+        rv[i] = sb_strdup(strv[i]);
+    rv[n] = NULL;
+    return rv;
+}
+
+
+static size_t
+checksum(char **strv)
+{
+    size_t rv = 0;
+    for (size_t i = 0; strv[i] != NULL; i++)
+        rv += strlen(strv[i]);
+    return rv;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {10, 100, 1000, 10000};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    printf("%10s  %14s  %14s  %8s\n", "N", "legacy ns/str", "packed ns/str",
+        "speedup");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        if (n == 0)
+            continue;
+        char **keys = sb_realloc(bench_keys(n, 42), sizeof(char*) * (n + 1));
+        keys[n] = NULL;
+        size_t rounds = ROUNDS_TOTAL / n;
+        if (rounds == 0)
+            rounds = 1;
+
+        size_t legacy_sum = 0;
+        uint64_t start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            char **strv = legacy_copy(keys, n);
+            legacy_sum += checksum(strv);
+            sb_strv_free(strv);
+        }
+        double legacy_ns = (double) (bench_now() - start) / (rounds * n);
+
+        size_t packed_sum = 0;
+        start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            char **strv = sb_strv_pack(keys);
+            packed_sum += checksum(strv);
+            sb_strv_free_packed(strv);
+        }
+        double packed_ns = (double) (bench_now() - start) / (rounds * n);
+
+        if (legacy_sum != packed_sum) {
+            fprintf(stderr, "error: arrays differ\n");
+            return 1;
+        }
+        sb_strv_free(keys);
+
+        printf("%10zu  %14.1f  %14.1f  %7.2fx\n", n, legacy_ns, packed_ns,
+            legacy_ns / packed_ns);
+    }
+
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Benchmark for sb_strv_join and sb_str_replace, compared to the original
+ * implementations (join appending each piece to a sb_string_t, and replace
+ * splitting the string and joining the pieces), that are reimplemented
+ * below. Arrays have N keys, and the replaced string is the result of the
+ * join. Times are in nanoseconds per key.
+ *
+ * Usage: bench_strv_join [N ...]
+ */
+
+#define ROUNDS_TOTAL 4000000
+
+
+static char*
+legacy_join(char **strv, const char *separator)
+{
+    sb_string_t *str = sb_string_new();
+    for (size_t i = 0; strv[i] != NULL; i++) {
+        str = sb_string_append(str, strv[i]);
+        if (strv[i + 1] != NULL)
+            str = sb_string_append(str, separator);
+    }
+    return sb_string_free(str, false);
+}
+
+
+static char*
+legacy_replace(const char *str, const char search, const char *replace)
+{
+    char **pieces = sb_str_split(str, search, 0);
+    char *rv = legacy_join(pieces, replace);
+    sb_strv_free_packed(pieces);
+    return rv;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {10, 100, 1000, 10000};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    printf("%10s  %12s  %12s  %12s  %12s\n", "N", "legacy join",
+        "join ns/str", "legacy repl", "repl ns/str");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        if (n == 0)
+            continue;
+        char **keys = sb_realloc(bench_keys(n, 42), sizeof(char*) * (n + 1));
+        keys[n] = NULL;
+        size_t rounds = ROUNDS_TOTAL / n;
+        if (rounds == 0)
+            rounds = 1;
+
+        size_t legacy_len = 0;
+        uint64_t start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            char *str = legacy_join(keys, ", ");
+            legacy_len += strlen(str);
+            free(str);
+        }
+        double legacy_join_ns = (double) (bench_now() - start) / (rounds * n);
+
+        size_t len = 0;
+        start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            char *str = sb_strv_join(keys, ", ");
+            len += strlen(str);
+            free(str);
+        }
+        double join_ns = (double) (bench_now() - start) / (rounds * n);
+
+        char *joined = sb_strv_join(keys, ",");
+        start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            char *str = legacy_replace(joined, ',', "\n");
+            legacy_len += strlen(str);
+            free(str);
+        }
+        double legacy_replace_ns = (double) (bench_now() - start) /
+            (rounds * n);
+
+        start = bench_now();
+        for (size_t r = 0; r < rounds; r++) {
+            char *str = sb_str_replace(joined, ',', "\n");
+            len += strlen(str);
+            free(str);
+        }
+        double replace_ns = (double) (bench_now() - start) / (rounds * n);
+
+        if (len != legacy_len) {
+            fprintf(stderr, "error: strings have different lengths\n");
+            return 1;
+        }
+        free(joined);
+        sb_strv_free(keys);
+
+        printf("%10zu  %12.1f  %12.1f  %12.1f  %12.1f\n", n, legacy_join_ns,
+            join_ns, legacy_replace_ns, replace_ns);
+    }
+
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Lookup benchmark for sb_trie_t, compared to the original trie layout (one
+ * node per byte, children stored as a linked list of siblings), that is
+ * reimplemented below.
+ *
+ * Usage: bench_trie [NUM_KEYS ...]
+ */
+
+typedef struct legacy_node {
+    char key;
+    void *data;
+    struct legacy_node *next, *child;
+} legacy_node_t;
+
+
+static void
+legacy_insert(legacy_node_t **root, const char *key, void *data)
+{
+    legacy_node_t **ref = root;
+    while (1) {
+        legacy_node_t *tmp;
+        for (tmp = *ref; tmp != NULL; tmp = tmp->next)
+            if (tmp->key == *key)
+                break;
+        if (tmp == NULL) {
+            tmp = malloc(sizeof(legacy_node_t));
+            tmp->key = *key;
+            tmp->data = NULL;
+            tmp->child = NULL;
+            tmp->next = NULL;
+            while (*ref != NULL)
+                ref = &(*ref)->next;
+            *ref = tmp;
+        }
+        if (*key == '\0') {
+            tmp->data = data;
+            return;
+        }
+        ref = &tmp->child;
+        key++;
+    }
+}
+
+
+static void*
+legacy_lookup(legacy_node_t *root, const char *key)
+{
+    legacy_node_t *tmp = root;
+    while (1) {
+        for (; tmp != NULL; tmp = tmp->next)
+            if (tmp->key == *key)
+                break;
+        if (tmp == NULL)
+            return NULL;
+        if (*key == '\0')
+            return tmp->data;
+        tmp = tmp->child;
+        key++;
+    }
+}
+
+
+static void
+legacy_free(legacy_node_t *node)
+{
+    // iterative on siblings, to survive wide levels.
+    while (node != NULL) {
+        legacy_node_t *next = node->next;
+        legacy_free(node->child);
+        free(node);
+        node = next;
+    }
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {10000, 100000, 1000000};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    printf("%10s  %14s  %14s  %8s\n", "keys", "legacy ns/op", "sb_trie ns/op",
+        "speedup");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        if (n == 0)
+            continue;
+
+        char **keys = bench_keys(n, 0x5eed + n);
+
+        legacy_node_t *legacy = NULL;
+        sb_trie_t *trie = sb_trie_new(NULL);
+        for (size_t i = 0; i < n; i++) {
+            legacy_insert(&legacy, keys[i], keys[i]);
+            sb_trie_insert(trie, keys[i], keys[i]);
+        }
+
+        bench_shuffle(keys, n, 0xbeef + n);
+
+        // a few rounds, so small tries are measured for long enough.
+        size_t rounds = n >= 1000000 ? 1 : 1000000 / n;
+        size_t found = 0;
+
+        uint64_t start = bench_now();
+        for (size_t r = 0; r < rounds; r++)
+            for (size_t i = 0; i < n; i++)
+                found += legacy_lookup(legacy, keys[i]) == keys[i];
+        double legacy_ns = (double) (bench_now() - start) / (n * rounds);
+
+        start = bench_now();
+        for (size_t r = 0; r < rounds; r++)
+            for (size_t i = 0; i < n; i++)
+                found += sb_trie_lookup(trie, keys[i]) == keys[i];
+        double trie_ns = (double) (bench_now() - start) / (n * rounds);
+
+        if (found != 2 * n * rounds) {
+            fprintf(stderr, "error: lookup returned unexpected data\n");
+            return 1;
+        }
+
+        printf("%10zu  %14.1f  %14.1f  %7.2fx\n", n, legacy_ns, trie_ns,
+            legacy_ns / trie_ns);
+
+        legacy_free(legacy);
+        sb_trie_free(trie);
+        for (size_t i = 0; i < n; i++)
+            free(keys[i]);
+        free(keys);
+    }
+
+    free(sizes);
+    return 0;
+}
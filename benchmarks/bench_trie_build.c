@@ -0,0 +1,98 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Construction benchmark for sb_trie_t, comparing sb_trie_build_sorted() to
+ * repeated sb_trie_insert() calls with the same sorted keys. Lookups on both
+ * tries are measured too, to compare their layouts.
+ *
+ * Usage: bench_trie_build [NUM_KEYS ...]
+ */
+
+
+static int
+compare_keys(const void *a, const void *b)
+{
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+
+static double
+lookup_ns(sb_trie_t *trie, char **keys, size_t n)
+{
+    size_t found = 0;
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < n; i++)
+        found += sb_trie_lookup(trie, keys[i]) == keys[i];
+    double rv = (double) (bench_now() - start) / n;
+    if (found != n) {
+        fprintf(stderr, "error: lookup returned unexpected data\n");
+        exit(1);
+    }
+    return rv;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {10000, 100000, 1000000};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    printf("%10s  %10s  %10s  %8s  %16s  %16s\n", "keys", "insert ms",
+        "build ms", "speedup", "insert lookup ns", "build lookup ns");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        if (n == 0)
+            continue;
+
+        char **keys = bench_keys(n, 0x5eed + n);
+        qsort(keys, n, sizeof(char*), compare_keys);
+
+        uint64_t start = bench_now();
+        sb_trie_t *inserted = sb_trie_new(NULL);
+        for (size_t i = 0; i < n; i++)
+            sb_trie_insert(inserted, keys[i], keys[i]);
+        double insert_ms = (double) (bench_now() - start) / 1000000;
+
+        start = bench_now();
+        sb_trie_t *built = sb_trie_build_sorted((const char *const*) keys,
+            (void**) keys, n, NULL);
+        double build_ms = (double) (bench_now() - start) / 1000000;
+
+        if (built == NULL || sb_trie_size(built) != n) {
+            fprintf(stderr, "error: failed to build trie\n");
+            return 1;
+        }
+
+        bench_shuffle(keys, n, 0xbeef + n);
+        double inserted_ns = lookup_ns(inserted, keys, n);
+        double built_ns = lookup_ns(built, keys, n);
+
+        printf("%10zu  %10.1f  %10.1f  %7.2fx  %16.1f  %16.1f\n", n,
+            insert_ms, build_ms, insert_ms / build_ms, inserted_ns, built_ns);
+
+        sb_trie_free(inserted);
+        sb_trie_free(built);
+        for (size_t i = 0; i < n; i++)
+            free(keys[i]);
+        free(keys);
+    }
+
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+
+#include "bench.h"
+
+/*
+ * Multi-threaded lookup benchmark for concurrent sb_trie_t, compared to a
+ * regular sb_trie_t guarded by a mutex. Readers look up random keys, while a
+ * single writer keeps inserting and removing keys.
+ *
+ * Usage: bench_trie_concurrent [NUM_THREADS ...]
+ */
+
+#define NUM_KEYS 100000
+#define NUM_CHURN_KEYS 1000
+#define LOOKUPS_PER_THREAD 1000000
+
+typedef struct {
+    sb_trie_t *trie;
+    pthread_mutex_t *mutex;
+    char **keys;
+    uint64_t seed;
+    size_t found;
+    volatile bool *done;
+} bench_ctx_t;
+
+
+static void*
+reader(void *arg)
+{
+    bench_ctx_t *ctx = arg;
+    for (size_t i = 0; i < LOOKUPS_PER_THREAD; i++) {
+        const char *key = ctx->keys[bench_rand(&ctx->seed) % NUM_KEYS];
+        if (ctx->mutex != NULL)
+            pthread_mutex_lock(ctx->mutex);
+        if (sb_trie_lookup(ctx->trie, key) != NULL)
+            ctx->found++;
+        if (ctx->mutex != NULL)
+            pthread_mutex_unlock(ctx->mutex);
+    }
+    return NULL;
+}
+
+
+static void*
+writer(void *arg)
+{
+    bench_ctx_t *ctx = arg;
+    for (size_t i = 0; !*ctx->done; i = (i + 1) % NUM_CHURN_KEYS) {
+        if (ctx->mutex != NULL)
+            pthread_mutex_lock(ctx->mutex);
+        if (!sb_trie_remove(ctx->trie, ctx->keys[i]))
+            sb_trie_insert(ctx->trie, ctx->keys[i], ctx->keys[i]);
+        if (ctx->mutex != NULL)
+            pthread_mutex_unlock(ctx->mutex);
+    }
+    return NULL;
+}
+
+
+static double
+run(sb_trie_t *trie, pthread_mutex_t *mutex, char **keys, char **churn_keys,
+    size_t num_threads)
+{
+    volatile bool done = false;
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    bench_ctx_t *ctxs = malloc(num_threads * sizeof(bench_ctx_t));
+    bench_ctx_t wctx = {trie, mutex, churn_keys, 0, 0, &done};
+    pthread_t wthread;
+
+    pthread_create(&wthread, NULL, writer, &wctx);
+
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < num_threads; i++) {
+        bench_ctx_t ctx = {trie, mutex, keys, 0x5eed + i, 0, &done};
+        ctxs[i] = ctx;
+        pthread_create(&threads[i], NULL, reader, &ctxs[i]);
+    }
+    for (size_t i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    uint64_t elapsed = bench_now() - start;
+
+    done = true;
+    pthread_join(wthread, NULL);
+
+    for (size_t i = 0; i < num_threads; i++) {
+        if (ctxs[i].found != LOOKUPS_PER_THREAD) {
+            fprintf(stderr, "error: lookup returned unexpected data\n");
+            exit(1);
+        }
+    }
+
+    free(ctxs);
+    free(threads);
+    return (double) num_threads * LOOKUPS_PER_THREAD * 1000 / elapsed;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {1, 2, 4, 8};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    char **keys = bench_keys(NUM_KEYS, 0x5eed);
+    char **churn_keys = malloc(NUM_CHURN_KEYS * sizeof(char*));
+    for (size_t i = 0; i < NUM_CHURN_KEYS; i++)
+        churn_keys[i] = sb_strdup_printf("churn/%zu", i);
+
+    sb_trie_t *locked = sb_trie_new(NULL);
+    sb_trie_t *concurrent = sb_trie_new_concurrent(NULL);
+    if (concurrent == NULL) {
+        fprintf(stderr, "error: concurrent tries not supported\n");
+        return 1;
+    }
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        sb_trie_insert(locked, keys[i], keys[i]);
+        sb_trie_insert(concurrent, keys[i], keys[i]);
+    }
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    printf("%10s  %16s  %16s  %8s\n", "threads", "mutex Mops/s",
+        "concurrent Mops/s", "speedup");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        double locked_ops = run(locked, &mutex, keys, churn_keys, sizes[s]);
+        double concurrent_ops = run(concurrent, NULL, keys, churn_keys,
+            sizes[s]);
+        printf("%10zu  %16.2f  %16.2f  %7.2fx\n", sizes[s], locked_ops,
+            concurrent_ops, concurrent_ops / locked_ops);
+    }
+
+    sb_trie_free(locked);
+    sb_trie_free(concurrent);
+    for (size_t i = 0; i < NUM_KEYS; i++)
+        free(keys[i]);
+    for (size_t i = 0; i < NUM_CHURN_KEYS; i++)
+        free(churn_keys[i]);
+    free(keys);
+    free(churn_keys);
+    free(sizes);
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball.h>
+#include "bench.h"
+
+/*
+ * Lookup benchmark for sb_trie_t with an approximate membership filter
+ * (1% false positive rate), compared to the same trie without the filter.
+ * Missing keys extend existing keys, so lookups without the filter walk the
+ * whole path before failing.
+ *
+ * Usage: bench_trie_filter [NUM_KEYS ...]
+ */
+
+
+static double
+lookup(sb_trie_t *trie, char **keys, size_t n, size_t rounds, bool hit)
+{
+    size_t found = 0;
+    uint64_t start = bench_now();
+    for (size_t r = 0; r < rounds; r++)
+        for (size_t i = 0; i < n; i++)
+            found += sb_trie_lookup(trie, keys[i]) != NULL;
+    double ns = (double) (bench_now() - start) / (n * rounds);
+    if (found != (hit ? n * rounds : 0)) {
+        fprintf(stderr, "error: lookup returned unexpected data\n");
+        exit(1);
+    }
+    return ns;
+}
+
+
+int
+main(int argc, char **argv)
+{
+    static const size_t defaults[] = {10000, 100000, 1000000};
+    size_t n_sizes;
+    size_t *sizes = bench_sizes(argc, argv, &n_sizes, defaults,
+        sizeof(defaults) / sizeof(defaults[0]));
+
+    printf("%10s  %14s  %14s  %8s  %14s  %14s  %10s  %10s\n", "keys",
+        "miss ns/op", "filtered ns/op", "speedup", "hit ns/op",
+        "filtered ns/op", "filter KiB", "rejected");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n = sizes[s];
+        if (n == 0)
+            continue;
+
+        char **keys = bench_keys(n, 0x5eed + n);
+        char **missing = malloc(n * sizeof(char*));
+        for (size_t i = 0; i < n; i++)
+            missing[i] = sb_strdup_printf("%s.opt", keys[i]);
+
+        sb_trie_t *trie = sb_trie_new(NULL);
+        for (size_t i = 0; i < n; i++)
+            sb_trie_insert(trie, keys[i], keys[i]);
+
+        bench_shuffle(keys, n, 0xbeef + n);
+        bench_shuffle(missing, n, 0xbeef + n);
+
+        // a few rounds, so small tries are measured for long enough.
+        size_t rounds = n >= 1000000 ? 1 : 1000000 / n;
+
+        double miss_ns = lookup(trie, missing, n, rounds, false);
+        double hit_ns = lookup(trie, keys, n, rounds, true);
+
+        size_t before, after;
+        sb_trie_memory_usage(trie, NULL, &before);
+        sb_trie_enable_filter(trie, 0.01);
+        sb_trie_memory_usage(trie, NULL, &after);
+
+        double filtered_miss_ns = lookup(trie, missing, n, rounds, false);
+        size_t filtered;
+        sb_trie_filter_stats(trie, &filtered, NULL);
+        double filtered_hit_ns = lookup(trie, keys, n, rounds, true);
+
+        printf("%10zu  %14.1f  %14.1f  %7.2fx  %14.1f  %14.1f  %10.1f  "
+            "%9.2f%%\n", n, miss_ns, filtered_miss_ns,
+            miss_ns / filtered_miss_ns, hit_ns, filtered_hit_ns,
+            (after - before) / 1024.0, 100.0 * filtered / (n * rounds));
+
+        sb_trie_free(trie);
+        for (size_t i = 0; i < n; i++) {
+            free(keys[i]);
+            free(missing[i]);
+        }
+        free(keys);
+        free(missing);
+    }
+
+    free(sizes);
+    return 0;
+}
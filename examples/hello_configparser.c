@@ -53,10 +53,10 @@ main(int argc, char **argv)
                 sb_config_get(t, sections[i], keys[j]));
         }
         printf("\n");
-        sb_strv_free(keys);
+        sb_strv_free_packed(keys);
     }
 
-    sb_strv_free(sections);
+    sb_strv_free_packed(sections);
     sb_config_free(t);
 
     return 0;
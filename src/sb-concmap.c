@@ -0,0 +1,310 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball/sb-concmap.h>
+#include <squareball/sb-concmap-private.h>
+#include <squareball/sb-hashmap.h>
+#include <squareball/sb-hash-private.h>
+#include <squareball/sb-hashmap-private.h>
+#include <squareball/sb-mem.h>
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+
+// concurrent hash maps are only supported if the compiler provides atomic
+// builtins. the fallbacks are never used, and their results are ignored.
+#ifdef HAVE_ATOMIC_BUILTINS
+#define SB_CONCMAP_USE_ATOMICS
+#define sb_concmap_atomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define sb_concmap_atomic_store(ptr, val) \
+    __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define sb_concmap_atomic_cas(ptr, expected, val) \
+    __atomic_compare_exchange_n(ptr, expected, val, false, __ATOMIC_ACQUIRE, \
+        __ATOMIC_RELAXED)
+#define sb_concmap_atomic_or(ptr, val) \
+    __atomic_fetch_or(ptr, val, __ATOMIC_RELAXED)
+#define sb_concmap_atomic_add(ptr, val) \
+    __atomic_fetch_add(ptr, val, __ATOMIC_RELAXED)
+#define sb_concmap_atomic_sub(ptr, val) \
+    __atomic_fetch_sub(ptr, val, __ATOMIC_RELEASE)
+#else
+#define sb_concmap_atomic_load(ptr) (*(ptr))
+#define sb_concmap_atomic_store(ptr, val) (*(ptr) = (val))
+#define sb_concmap_atomic_cas(ptr, expected, val) \
+    (*(ptr) == *(expected) ? (*(ptr) = (val), true) : \
+        (*(expected) = *(ptr), false))
+#define sb_concmap_atomic_or(ptr, val) (*(ptr) |= (val))
+#define sb_concmap_atomic_add(ptr, val) (*(ptr) += (val))
+#define sb_concmap_atomic_sub(ptr, val) (*(ptr) -= (val))
+#endif
+
+
+sb_concmap_t*
+sb_concmap_new(sb_free_func_t free_func)
+{
+#ifdef SB_CONCMAP_USE_ATOMICS
+    sb_concmap_t *map = sb_malloc_aligned(SB_CONCMAP_CACHE_LINE,
+        sizeof(sb_concmap_t));
+    memset(map, 0, sizeof(sb_concmap_t));
+    for (size_t i = 0; i < SB_CONCMAP_SHARDS; i++)
+        map->shards[i].map = sb_hashmap_new(free_func);
+    return map;
+#else
+    return NULL;
+#endif
+}
+
+
+void
+sb_concmap_free(sb_concmap_t *map)
+{
+    if (map == NULL)
+        return;
+    for (size_t i = 0; i < SB_CONCMAP_SHARDS; i++)
+        sb_hashmap_free(map->shards[i].map);
+    free(map);
+}
+
+
+static void
+sb_concmap_pause(size_t spins)
+{
+    // waits are usually short, as locks are only held for a single
+    // operation. give up the cpu if it is taking long, e.g. because the
+    // holder was preempted.
+#ifdef HAVE_SCHED_H
+    if (spins >= 64)
+        sched_yield();
+#endif
+}
+
+
+static sb_concmap_shard_t*
+sb_concmap_read_lock(sb_concmap_t *map, uint64_t hash)
+{
+    sb_concmap_shard_t *shard = &map->shards[SB_CONCMAP_SHARD(hash)];
+    size_t spins = 0;
+    size_t lock = sb_concmap_atomic_load(&shard->lock);
+    for (;;) {
+        if ((lock & (SB_CONCMAP_LOCK_WRITER | SB_CONCMAP_LOCK_PENDING)) == 0 &&
+            sb_concmap_atomic_cas(&shard->lock, &lock, lock + 1))
+            break;
+        if ((lock & (SB_CONCMAP_LOCK_WRITER | SB_CONCMAP_LOCK_PENDING)) != 0) {
+            sb_concmap_pause(spins++);
+            lock = sb_concmap_atomic_load(&shard->lock);
+        }
+    }
+    sb_concmap_atomic_add(&shard->acquisitions, 1);
+    if (spins > 0)
+        sb_concmap_atomic_add(&shard->contended, 1);
+    return shard;
+}
+
+
+static void
+sb_concmap_read_unlock(sb_concmap_shard_t *shard)
+{
+    sb_concmap_atomic_sub(&shard->lock, 1);
+}
+
+
+static sb_concmap_shard_t*
+sb_concmap_write_lock(sb_concmap_t *map, uint64_t hash)
+{
+    // the pending flag is set while waiting for the readers to leave. it is
+    // cleared when any writer releases the lock, and set again by the
+    // writers that are still waiting.
+    sb_concmap_shard_t *shard = &map->shards[SB_CONCMAP_SHARD(hash)];
+    size_t spins = 0;
+    size_t lock = sb_concmap_atomic_load(&shard->lock);
+    for (;;) {
+        if ((lock & ~((size_t) SB_CONCMAP_LOCK_PENDING)) == 0 &&
+            sb_concmap_atomic_cas(&shard->lock, &lock,
+                SB_CONCMAP_LOCK_WRITER))
+            break;
+        if ((lock & SB_CONCMAP_LOCK_PENDING) == 0)
+            sb_concmap_atomic_or(&shard->lock, SB_CONCMAP_LOCK_PENDING);
+        sb_concmap_pause(spins++);
+        lock = sb_concmap_atomic_load(&shard->lock);
+    }
+    sb_concmap_atomic_add(&shard->acquisitions, 1);
+    if (spins > 0)
+        sb_concmap_atomic_add(&shard->contended, 1);
+    return shard;
+}
+
+
+static void
+sb_concmap_write_unlock(sb_concmap_shard_t *shard)
+{
+    sb_concmap_atomic_store(&shard->lock, 0);
+}
+
+
+void
+sb_concmap_insert(sb_concmap_t *map, const char *key, void *data)
+{
+    if (key == NULL)
+        return;
+    sb_concmap_insert_len(map, key, strlen(key), data);
+}
+
+
+void
+sb_concmap_insert_len(sb_concmap_t *map, const char *key, size_t key_len,
+    void *data)
+{
+    if (map == NULL || key == NULL || data == NULL)
+        return;
+
+    uint64_t hash = sb_hash(key, key_len);
+    sb_concmap_shard_t *shard = sb_concmap_write_lock(map, hash);
+    sb_hashmap_insert_hashed(shard->map, key, key_len, hash, data);
+    sb_concmap_write_unlock(shard);
+}
+
+
+void*
+sb_concmap_lookup(sb_concmap_t *map, const char *key)
+{
+    if (key == NULL)
+        return NULL;
+    return sb_concmap_lookup_len(map, key, strlen(key));
+}
+
+
+void*
+sb_concmap_lookup_len(sb_concmap_t *map, const char *key, size_t key_len)
+{
+    if (map == NULL || key == NULL)
+        return NULL;
+
+    uint64_t hash = sb_hash(key, key_len);
+    sb_concmap_shard_t *shard = sb_concmap_read_lock(map, hash);
+    void *rv = sb_hashmap_lookup_hashed(shard->map, key, key_len, hash);
+    sb_concmap_read_unlock(shard);
+    return rv;
+}
+
+
+bool
+sb_concmap_lookup_func(sb_concmap_t *map, const char *key,
+    sb_concmap_lookup_func_t func, void *user_data)
+{
+    if (key == NULL)
+        return false;
+    return sb_concmap_lookup_func_len(map, key, strlen(key), func, user_data);
+}
+
+
+bool
+sb_concmap_lookup_func_len(sb_concmap_t *map, const char *key, size_t key_len,
+    sb_concmap_lookup_func_t func, void *user_data)
+{
+    if (map == NULL || key == NULL || func == NULL)
+        return false;
+
+    uint64_t hash = sb_hash(key, key_len);
+    sb_concmap_shard_t *shard = sb_concmap_read_lock(map, hash);
+    void *data = sb_hashmap_lookup_hashed(shard->map, key, key_len, hash);
+    if (data != NULL)
+        func(data, user_data);
+    sb_concmap_read_unlock(shard);
+    return data != NULL;
+}
+
+
+bool
+sb_concmap_remove(sb_concmap_t *map, const char *key)
+{
+    if (key == NULL)
+        return false;
+    return sb_concmap_remove_len(map, key, strlen(key));
+}
+
+
+bool
+sb_concmap_remove_len(sb_concmap_t *map, const char *key, size_t key_len)
+{
+    if (map == NULL || key == NULL)
+        return false;
+
+    uint64_t hash = sb_hash(key, key_len);
+    sb_concmap_shard_t *shard = sb_concmap_write_lock(map, hash);
+    bool rv = sb_hashmap_remove_hashed(shard->map, key, key_len, hash);
+    sb_concmap_write_unlock(shard);
+    return rv;
+}
+
+
+size_t
+sb_concmap_size(sb_concmap_t *map)
+{
+    if (map == NULL)
+        return 0;
+
+    // any hash of the shard can be used to lock it.
+    size_t rv = 0;
+    for (uint64_t i = 0; i < SB_CONCMAP_SHARDS; i++) {
+        sb_concmap_shard_t *shard = sb_concmap_read_lock(map,
+            i << (64 - SB_CONCMAP_SHARDS_BITS));
+        rv += sb_hashmap_size(shard->map);
+        sb_concmap_read_unlock(shard);
+    }
+    return rv;
+}
+
+
+void
+sb_concmap_foreach(sb_concmap_t *map, sb_hashmap_foreach_func_t func,
+    void *user_data)
+{
+    if (map == NULL || func == NULL)
+        return;
+
+    for (uint64_t i = 0; i < SB_CONCMAP_SHARDS; i++) {
+        sb_concmap_shard_t *shard = sb_concmap_read_lock(map,
+            i << (64 - SB_CONCMAP_SHARDS_BITS));
+        sb_hashmap_foreach(shard->map, func, user_data);
+        sb_concmap_read_unlock(shard);
+    }
+}
+
+
+size_t
+sb_concmap_num_shards(sb_concmap_t *map)
+{
+    return map == NULL ? 0 : SB_CONCMAP_SHARDS;
+}
+
+
+void
+sb_concmap_shard_stats(sb_concmap_t *map, size_t shard, size_t *acquisitions,
+    size_t *contended)
+{
+    if (acquisitions != NULL)
+        *acquisitions = 0;
+    if (contended != NULL)
+        *contended = 0;
+    if (map == NULL || shard >= SB_CONCMAP_SHARDS)
+        return;
+    if (acquisitions != NULL)
+        *acquisitions = sb_concmap_atomic_load(
+            &map->shards[shard].acquisitions);
+    if (contended != NULL)
+        *contended = sb_concmap_atomic_load(&map->shards[shard].contended);
+}
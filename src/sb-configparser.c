@@ -18,7 +18,9 @@
 #include <squareball/sb-error.h>
 #include <squareball/sb-parsererror.h>
 #include <squareball/sb-strfuncs.h>
+#include <squareball/sb-strfuncs-private.h>
 #include <squareball/sb-string.h>
+#include <squareball/sb-strview.h>
 #include <squareball/sb-trie.h>
 
 
@@ -42,11 +44,20 @@ typedef enum {
     CONFIG_SECTION_TYPE_LIST,
 } sb_configparser_section_type_t;
 
+// tries walk their keys sorted, so sections and values store the position
+// where their names were first found in the source, that is used to list
+// them in order. it must be the first member of both.
 typedef struct {
+    size_t seq;
     sb_configparser_section_type_t type;
     void *data;
 } sb_configparser_section_t;
 
+typedef struct {
+    size_t seq;
+    char str[];
+} sb_configparser_value_t;
+
 
 static void
 free_section(sb_configparser_section_t *section)
@@ -66,6 +77,53 @@ free_section(sb_configparser_section_t *section)
 }
 
 
+static size_t
+next_seq(sb_trie_t *trie, sb_strview_t name)
+{
+    // nothing is removed from the tries while parsing, so new names are
+    // numbered by the size of the trie, and the positions of the names of a
+    // trie are always 0 to size - 1. names found again keep their positions.
+    size_t *seq = sb_trie_lookup_len(trie, name.str, name.len);
+    return seq != NULL ? *seq : sb_trie_size(trie);
+}
+
+
+static void
+insert_value(sb_trie_t *trie, sb_strview_t key, const char *str, size_t len)
+{
+    sb_configparser_value_t *v = sb_malloc(sizeof(sb_configparser_value_t) +
+        len + 1);
+    v->seq = next_seq(trie, key);
+    memcpy(v->str, str, len);
+    v->str[len] = '\0';
+    sb_trie_insert_len(trie, key.str, key.len, v);
+}
+
+
+static sb_string_t*
+value_start(sb_string_t *buf, const char *src, size_t src_len,
+    size_t current)
+{
+    // a single string object is reused for all the values, that are copied
+    // when done. unquoted values end at the end of the line, so reserving
+    // the length of the line avoids reallocations for most values.
+    buf->len = 0;
+    buf->str[0] = '\0';
+    const char *end = memchr(src + current, '\n', src_len - current);
+    return sb_string_reserve(buf, end == NULL ? src_len - current :
+        (size_t) (end - (src + current)));
+}
+
+
+static sb_strview_t
+slice(const char *src, size_t start, size_t end)
+{
+    // section names and keys are inserted without copying them, but still end
+    // at the first nul byte, if any, like nul-terminated strings would.
+    return sb_strview_len(src + start, strnlen(src + start, end - start));
+}
+
+
 sb_config_t*
 sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
     sb_error_t **err)
@@ -78,9 +136,9 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
 
     sb_configparser_section_t *section = NULL;
 
-    char *section_name = NULL;
-    char *key = NULL;
+    sb_strview_t key = {NULL, 0};
     sb_string_t *value = NULL;
+    sb_string_t *value_buf = sb_string_new();
     bool escaped = false;
 
     sb_config_t *rv = sb_malloc(sizeof(sb_config_t));
@@ -131,7 +189,8 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
                         case CONFIG_SECTION_TYPE_LIST:
                             state = CONFIG_SECTION_LIST_START;
                             if (value == NULL)
-                                value = sb_string_new();
+                                value = value_start(value_buf, src, src_len,
+                                    current);
                             break;
                     }
                     continue;
@@ -148,12 +207,14 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
 
             case CONFIG_SECTION:
                 if (c == ']') {
-                    section_name = sb_strndup(src + start, current - start);
+                    sb_strview_t section_name = slice(src, start, current);
                     section = sb_malloc(sizeof(sb_configparser_section_t));
                     section->type = CONFIG_SECTION_TYPE_MAP;
                     if (list_sections != NULL) {
                         for (size_t i = 0; list_sections[i] != NULL; i++) {
-                            if (0 == strcmp(section_name, list_sections[i])) {
+                            if (sb_strview_equal(section_name,
+                                    sb_strview(list_sections[i])))
+                            {
                                 section->type = CONFIG_SECTION_TYPE_LIST;
                                 break;
                             }
@@ -167,9 +228,9 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
                             section->data = NULL;
                             break;
                     }
-                    sb_trie_insert(rv->root, section_name, section);
-                    free(section_name);
-                    section_name = NULL;
+                    section->seq = next_seq(rv->root, section_name);
+                    sb_trie_insert_len(rv->root, section_name.str,
+                        section_name.len, section);
                     state = CONFIG_START;
                     break;
                 }
@@ -182,17 +243,14 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
 
             case CONFIG_SECTION_KEY:
                 if (c == '=') {
-                    key = sb_strndup(src + start, current - start);
+                    key = sb_strview_strip(slice(src, start, current));
                     state = CONFIG_SECTION_VALUE_START;
                     if (is_last) {
-                        sb_trie_insert(section->data, sb_str_strip(key),
-                            sb_strdup(""));
-                        free(key);
-                        key = NULL;
+                        insert_value(section->data, key, "", 0);
                         break;
                     }
                     if (value == NULL)
-                        value = sb_string_new();
+                        value = value_start(value_buf, src, src_len, current);
                     break;
                 }
                 if (c != '\r' && c != '\n' && !is_last)
@@ -201,11 +259,10 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
                 if (err != NULL) {
                     size_t end = is_last && c != '\n' && c != '\r' ? src_len :
                         current;
-                    key = sb_strndup(src + start, end - start);
+                    sb_strview_t k = slice(src, start, end);
                     *err = sb_parser_error_new_printf(src, src_len, current,
-                        "configparser: Key without value: %s.", key);
-                    free(key);
-                    key = NULL;
+                        "configparser: Key without value: %.*s.", (int) k.len,
+                        k.str);
                 }
                 break;
 
@@ -226,10 +283,7 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
 
             case CONFIG_SECTION_VALUE_QUOTE:
                 if (c == '"') {
-                    sb_trie_insert(section->data, sb_str_strip(key),
-                        sb_string_free(value, false));
-                    free(key);
-                    key = NULL;
+                    insert_value(section->data, key, value->str, value->len);
                     value = NULL;
                     state = CONFIG_SECTION_VALUE_POST_QUOTED;
                     break;
@@ -253,11 +307,8 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
                 if (c == '\r' || c == '\n' || is_last) {
                     if (is_last && c != '\r' && c != '\n')
                         sb_string_append_c(value, c);
-                    sb_trie_insert(section->data, sb_str_strip(key),
-                        sb_strdup(sb_str_rstrip(value->str)));
-                    free(key);
-                    key = NULL;
-                    sb_string_free(value, true);
+                    const char *v = sb_str_rstrip(value->str);
+                    insert_value(section->data, key, v, strlen(v));
                     value = NULL;
                     state = CONFIG_START;
                     break;
@@ -279,7 +330,7 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
             case CONFIG_SECTION_LIST_QUOTE:
                 if (c == '"') {
                     section->data = sb_slist_append(section->data,
-                        sb_string_free(value, false));
+                        sb_strndup(value->str, value->len));
                     value = NULL;
                     state = CONFIG_SECTION_LIST_POST_QUOTED;
                     break;
@@ -306,7 +357,6 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
                         sb_string_append_c(value, c);
                     section->data = sb_slist_append(section->data,
                         sb_strdup(sb_str_strip(value->str)));
-                    sb_string_free(value, true);
                     value = NULL;
                     state = CONFIG_START;
                     break;
@@ -326,43 +376,70 @@ sb_config_parse(const char *src, size_t src_len, const char *list_sections[],
         current++;
     }
 
-    free(section_name);
-    free(key);
-    sb_string_free(value, true);
+    sb_string_free(value_buf, true);
 
     return rv;
 }
 
 
 static void
-list_keys(const char *key, const char *value, sb_slist_t **l)
+measure_names(const char *name, size_t name_len, size_t *seq, size_t *lens)
 {
-    *l = sb_slist_append(*l, sb_strdup(key));
+    (void) name;
+    lens[*seq] = name_len + 1;
 }
 
 
-char**
-sb_config_list_sections(sb_config_t *config)
+static void
+list_names(const char *name, size_t name_len, size_t *seq, char **strv)
 {
-    if (config == NULL)
-        return NULL;
-
-    sb_slist_t *l = NULL;
-    sb_trie_foreach(config->root, (sb_trie_foreach_func_t) list_keys, &l);
+    memcpy(strv[*seq], name, name_len);
+    strv[*seq][name_len] = '\0';
+}
 
-    char **rv = sb_malloc(sizeof(char*) * (sb_slist_length(l) + 1));
 
-    size_t i = 0;
-    for (sb_slist_t *tmp = l; tmp != NULL; tmp = tmp->next, i++)
-        rv[i] = tmp->data;
-    rv[i] = NULL;
+static char**
+list_ordered(sb_trie_t *trie)
+{
+    // names are walked twice, to measure them, and to copy them to a packed
+    // array, that uses a single memory allocation, at their positions in the
+    // source (see next_seq()).
+    size_t count = sb_trie_size(trie);
+    if (count == 0)
+        return sb_strv_alloc_packed(0, 0);
+
+    size_t *lens = sb_malloc(count * sizeof(size_t));
+    sb_trie_foreach_len(trie, (sb_trie_foreach_len_func_t) measure_names,
+        lens);
+
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++)
+        len += lens[i];
+
+    char **rv = sb_strv_alloc_packed(count, len);
+    char *buf = SB_STRV_PACKED_DATA(rv, count);
+    for (size_t i = 0; i < count; i++) {
+        rv[i] = buf;
+        buf += lens[i];
+    }
+    free(lens);
 
-    sb_slist_free(l);
+    sb_trie_foreach_len(trie, (sb_trie_foreach_len_func_t) list_names, rv);
 
     return rv;
 }
 
 
+char**
+sb_config_list_sections(sb_config_t *config)
+{
+    if (config == NULL)
+        return NULL;
+
+    return list_ordered(config->root);
+}
+
+
 char**
 sb_config_list_keys(sb_config_t *config, const char *section)
 {
@@ -376,19 +453,7 @@ sb_config_list_keys(sb_config_t *config, const char *section)
     if (s->type != CONFIG_SECTION_TYPE_MAP)
         return NULL;
 
-    sb_slist_t *l = NULL;
-    sb_trie_foreach(s->data, (sb_trie_foreach_func_t) list_keys, &l);
-
-    char **rv = sb_malloc(sizeof(char*) * (sb_slist_length(l) + 1));
-
-    size_t i = 0;
-    for (sb_slist_t *tmp = l; tmp != NULL; tmp = tmp->next, i++)
-        rv[i] = tmp->data;
-    rv[i] = NULL;
-
-    sb_slist_free(l);
-
-    return rv;
+    return list_ordered(s->data);
 }
 
 
@@ -405,7 +470,8 @@ sb_config_get(sb_config_t *config, const char *section, const char *key)
     if (s->type != CONFIG_SECTION_TYPE_MAP)
         return NULL;
 
-    return sb_trie_lookup(s->data, key);
+    sb_configparser_value_t *v = sb_trie_lookup(s->data, key);
+    return v != NULL ? v->str : NULL;
 }
 
 
@@ -433,17 +499,48 @@ sb_config_get_list(sb_config_t *config, const char *section)
     if (s->type != CONFIG_SECTION_TYPE_LIST)
         return NULL;
 
-    char **rv = sb_malloc(sizeof(char*) * (sb_slist_length(s->data) + 1));
+    size_t count = 0;
+    size_t len = 0;
+    for (sb_slist_t *tmp = s->data; tmp != NULL; tmp = tmp->next, count++)
+        len += strlen(tmp->data) + 1;
+
+    char **rv = sb_strv_alloc_packed(count, len);
+    char *buf = SB_STRV_PACKED_DATA(rv, count);
 
     size_t i = 0;
-    for (sb_slist_t *tmp = s->data; tmp != NULL; tmp = tmp->next, i++)
-        rv[i] = sb_strdup(tmp->data);
-    rv[i] = NULL;
+    for (sb_slist_t *tmp = s->data; tmp != NULL; tmp = tmp->next, i++) {
+        size_t l = strlen(tmp->data) + 1;
+        rv[i] = buf;
+        memcpy(buf, tmp->data, l);
+        buf += l;
+    }
 
     return rv;
 }
 
 
+static void
+enable_filter(const char *key, sb_configparser_section_t *section,
+    double *fp_rate)
+{
+    (void) key;
+    if (section->type == CONFIG_SECTION_TYPE_MAP)
+        sb_trie_enable_filter(section->data, *fp_rate);
+}
+
+
+bool
+sb_config_enable_filter(sb_config_t *config, double fp_rate)
+{
+    if (config == NULL || !sb_trie_enable_filter(config->root, fp_rate))
+        return false;
+
+    sb_trie_foreach(config->root, (sb_trie_foreach_func_t) enable_filter,
+        &fp_rate);
+    return true;
+}
+
+
 void
 sb_config_free(sb_config_t *config)
 {
@@ -41,6 +41,15 @@ file_get_contents(const char *path, bool utf8, size_t *len, sb_error_t **err)
 
     *len = 0;
 
+    // the size of the file, if available, is used to allocate the string at
+    // once. the file may change before being read, so it is just a hint.
+    size_t size_hint = 0;
+#ifdef HAVE_SYS_STAT_H
+    struct stat st;
+    if (0 == stat(path, &st) && S_ISREG(st.st_mode))
+        size_hint = st.st_size;
+#endif /* HAVE_SYS_STAT_H */
+
     FILE *fp = fopen(path, "r");
     int tmp_errno = errno;
 
@@ -52,7 +61,7 @@ file_get_contents(const char *path, bool utf8, size_t *len, sb_error_t **err)
         return NULL;
     }
 
-    sb_string_t *str = sb_string_new();
+    sb_string_t *str = sb_string_new_sized(size_hint);
 
     char buffer[1024];
     char *tmp;
@@ -0,0 +1,53 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdint.h>
+#include <string.h>
+#include <squareball/sb-hash-private.h>
+
+
+uint64_t
+sb_hash(const char *key, size_t len)
+{
+    // MurmurHash64A, by Austin Appleby (public domain). keys are read 8 bytes
+    // at a time, in the native byte order, since hashes never leave memory.
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const uint8_t *k = (const uint8_t*) key;
+    const uint8_t *end = k + (len & ~((size_t) 7));
+    uint64_t h = 0x5eed ^ (len * m);
+
+    for (; k != end; k += 8) {
+        uint64_t v;
+        memcpy(&v, k, sizeof(uint64_t));
+        v *= m;
+        v ^= v >> 47;
+        v *= m;
+        h ^= v;
+        h *= m;
+    }
+
+    switch (len & 7) {
+        case 7: h ^= (uint64_t) k[6] << 48;  // fall through
+        case 6: h ^= (uint64_t) k[5] << 40;  // fall through
+        case 5: h ^= (uint64_t) k[4] << 32;  // fall through
+        case 4: h ^= (uint64_t) k[3] << 24;  // fall through
+        case 3: h ^= (uint64_t) k[2] << 16;  // fall through
+        case 2: h ^= (uint64_t) k[1] << 8;   // fall through
+        case 1: h ^= (uint64_t) k[0];
+            h *= m;
+    }
+
+    h ^= h >> 47;
+    h *= m;
+    h ^= h >> 47;
+    return h;
+}
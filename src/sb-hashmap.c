@@ -0,0 +1,403 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball/sb-hash-private.h>
+#include <squareball/sb-hashmap.h>
+#include <squareball/sb-hashmap-private.h>
+#include <squareball/sb-mem.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define SB_HASHMAP_USE_SSE2
+#endif
+
+
+static inline unsigned int
+sb_hashmap_ctz(uint32_t mask)
+{
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    unsigned int rv = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        rv++;
+    }
+    return rv;
+#endif
+}
+
+
+static inline unsigned int
+sb_hashmap_clz16(uint32_t mask)
+{
+    // leading zeros of a 16 bits mask, that is not zero.
+#ifdef __GNUC__
+    return __builtin_clz(mask) - 16;
+#else
+    unsigned int rv = 0;
+    while ((mask & 0x8000) == 0) {
+        mask <<= 1;
+        rv++;
+    }
+    return rv;
+#endif
+}
+
+
+static inline uint32_t
+sb_hashmap_group_match(const uint8_t *group, uint8_t c)
+{
+    // returns a mask with a bit set for each control byte equal to c.
+#ifdef SB_HASHMAP_USE_SSE2
+    __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char) c), ctrl));
+#else
+    uint32_t rv = 0;
+    for (size_t i = 0; i < SB_HASHMAP_GROUP_WIDTH; i++)
+        if (group[i] == c)
+            rv |= 1U << i;
+    return rv;
+#endif
+}
+
+
+static inline uint32_t
+sb_hashmap_group_match_free(const uint8_t *group)
+{
+    // empty and deleted control bytes are the only ones with the high bit
+    // set.
+#ifdef SB_HASHMAP_USE_SSE2
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+#else
+    uint32_t rv = 0;
+    for (size_t i = 0; i < SB_HASHMAP_GROUP_WIDTH; i++)
+        if ((group[i] & 0x80) != 0)
+            rv |= 1U << i;
+    return rv;
+#endif
+}
+
+
+static inline void
+sb_hashmap_set_ctrl(sb_hashmap_t *map, size_t i, uint8_t c)
+{
+    map->ctrl[i] = c;
+    if (i < SB_HASHMAP_GROUP_WIDTH)
+        map->ctrl[map->capacity + i] = c;
+}
+
+
+sb_hashmap_t*
+sb_hashmap_new(sb_free_func_t free_func)
+{
+    sb_hashmap_t *map = sb_malloc(sizeof(sb_hashmap_t));
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->capacity = 0;
+    map->size = 0;
+    map->growth_left = 0;
+    map->free_func = free_func;
+    return map;
+}
+
+
+void
+sb_hashmap_free(sb_hashmap_t *map)
+{
+    if (map == NULL)
+        return;
+    for (size_t i = 0; i < map->capacity; i++) {
+        if ((map->ctrl[i] & 0x80) != 0)
+            continue;
+        if (map->free_func != NULL)
+            map->free_func(map->slots[i].data);
+        free(map->slots[i].key);
+    }
+    free(map->ctrl);
+    free(map->slots);
+    free(map);
+}
+
+
+static sb_hashmap_slot_t*
+sb_hashmap_find(sb_hashmap_t *map, const char *key, size_t len, uint64_t hash)
+{
+    if (map->capacity == 0)
+        return NULL;
+
+    // groups are probed with triangular steps, that visit every group of a
+    // table with a power of two capacity. the load factor guarantees that
+    // there are empty slots to stop the probing.
+    size_t mask = map->capacity - 1;
+    size_t pos = SB_HASHMAP_H1(hash) & mask;
+    uint8_t h2 = SB_HASHMAP_H2(hash);
+
+    for (size_t stride = SB_HASHMAP_GROUP_WIDTH;;
+        pos = (pos + stride) & mask, stride += SB_HASHMAP_GROUP_WIDTH)
+    {
+        const uint8_t *group = map->ctrl + pos;
+        for (uint32_t m = sb_hashmap_group_match(group, h2); m != 0;
+            m &= m - 1)
+        {
+            sb_hashmap_slot_t *slot =
+                &map->slots[(pos + sb_hashmap_ctz(m)) & mask];
+            if (slot->hash == hash && slot->key_len == len &&
+                0 == memcmp(slot->key, key, len))
+                return slot;
+        }
+        if (sb_hashmap_group_match(group, SB_HASHMAP_CTRL_EMPTY) != 0)
+            return NULL;
+    }
+}
+
+
+static size_t
+sb_hashmap_find_free(sb_hashmap_t *map, uint64_t hash)
+{
+    // returns the first empty or deleted slot of the probe sequence of hash.
+    size_t mask = map->capacity - 1;
+    size_t pos = SB_HASHMAP_H1(hash) & mask;
+
+    for (size_t stride = SB_HASHMAP_GROUP_WIDTH;;
+        pos = (pos + stride) & mask, stride += SB_HASHMAP_GROUP_WIDTH)
+    {
+        uint32_t m = sb_hashmap_group_match_free(map->ctrl + pos);
+        if (m != 0)
+            return (pos + sb_hashmap_ctz(m)) & mask;
+    }
+}
+
+
+static void
+sb_hashmap_resize(sb_hashmap_t *map, size_t capacity)
+{
+    uint8_t *ctrl = map->ctrl;
+    sb_hashmap_slot_t *slots = map->slots;
+    size_t old_capacity = map->capacity;
+
+    map->ctrl = sb_malloc(capacity + SB_HASHMAP_GROUP_WIDTH);
+    memset(map->ctrl, SB_HASHMAP_CTRL_EMPTY,
+        capacity + SB_HASHMAP_GROUP_WIDTH);
+    map->slots = sb_malloc(capacity * sizeof(sb_hashmap_slot_t));
+    map->capacity = capacity;
+    map->growth_left = capacity - capacity / 8 - map->size;
+
+    // the hashes are stored in the slots, and the keys are known to be
+    // unique, so elements are moved without touching the keys.
+    for (size_t i = 0; i < old_capacity; i++) {
+        if ((ctrl[i] & 0x80) != 0)
+            continue;
+        size_t j = sb_hashmap_find_free(map, slots[i].hash);
+        sb_hashmap_set_ctrl(map, j, ctrl[i]);
+        map->slots[j] = slots[i];
+    }
+
+    free(ctrl);
+    free(slots);
+}
+
+
+static void
+sb_hashmap_rehash(sb_hashmap_t *map)
+{
+    // the table is full, counting tombstones. if tombstones are using a good
+    // part of it, they are dropped without growing the table.
+    if (map->capacity == 0) {
+        sb_hashmap_resize(map, SB_HASHMAP_GROUP_WIDTH);
+        return;
+    }
+    if (map->size * 16 <= map->capacity * 7) {
+        sb_hashmap_resize(map, map->capacity);
+        return;
+    }
+    sb_hashmap_resize(map, map->capacity * 2);
+}
+
+
+void
+sb_hashmap_insert(sb_hashmap_t *map, const char *key, void *data)
+{
+    if (key == NULL)
+        return;
+    sb_hashmap_insert_len(map, key, strlen(key), data);
+}
+
+
+void
+sb_hashmap_insert_len(sb_hashmap_t *map, const char *key, size_t key_len,
+    void *data)
+{
+    if (map == NULL || key == NULL || data == NULL)
+        return;
+    sb_hashmap_insert_hashed(map, key, key_len, sb_hash(key, key_len),
+        data);
+}
+
+
+void
+sb_hashmap_insert_hashed(sb_hashmap_t *map, const char *key, size_t key_len,
+    uint64_t hash, void *data)
+{
+    sb_hashmap_slot_t *slot = sb_hashmap_find(map, key, key_len, hash);
+    if (slot != NULL) {
+        if (map->free_func != NULL)
+            map->free_func(slot->data);
+        slot->data = data;
+        return;
+    }
+
+    // deleted slots can be reused without rehashing, empty ones can't.
+    size_t i = map->capacity == 0 ? 0 : sb_hashmap_find_free(map, hash);
+    if (map->growth_left == 0 &&
+        (map->capacity == 0 || map->ctrl[i] == SB_HASHMAP_CTRL_EMPTY))
+    {
+        sb_hashmap_rehash(map);
+        i = sb_hashmap_find_free(map, hash);
+    }
+
+    if (map->ctrl[i] == SB_HASHMAP_CTRL_EMPTY)
+        map->growth_left--;
+    sb_hashmap_set_ctrl(map, i, SB_HASHMAP_H2(hash));
+
+    slot = &map->slots[i];
+    slot->hash = hash;
+    slot->key = sb_malloc(key_len + 1);
+    memcpy(slot->key, key, key_len);
+    slot->key[key_len] = '\0';
+    slot->key_len = key_len;
+    slot->data = data;
+    map->size++;
+}
+
+
+void*
+sb_hashmap_lookup(sb_hashmap_t *map, const char *key)
+{
+    if (key == NULL)
+        return NULL;
+    return sb_hashmap_lookup_len(map, key, strlen(key));
+}
+
+
+void*
+sb_hashmap_lookup_len(sb_hashmap_t *map, const char *key, size_t key_len)
+{
+    if (map == NULL || key == NULL)
+        return NULL;
+    return sb_hashmap_lookup_hashed(map, key, key_len,
+        sb_hash(key, key_len));
+}
+
+
+void*
+sb_hashmap_lookup_hashed(sb_hashmap_t *map, const char *key, size_t key_len,
+    uint64_t hash)
+{
+    sb_hashmap_slot_t *slot = sb_hashmap_find(map, key, key_len, hash);
+    return slot == NULL ? NULL : slot->data;
+}
+
+
+bool
+sb_hashmap_remove(sb_hashmap_t *map, const char *key)
+{
+    if (key == NULL)
+        return false;
+    return sb_hashmap_remove_len(map, key, strlen(key));
+}
+
+
+bool
+sb_hashmap_remove_len(sb_hashmap_t *map, const char *key, size_t key_len)
+{
+    if (map == NULL || key == NULL)
+        return false;
+    return sb_hashmap_remove_hashed(map, key, key_len,
+        sb_hash(key, key_len));
+}
+
+
+bool
+sb_hashmap_remove_hashed(sb_hashmap_t *map, const char *key, size_t key_len,
+    uint64_t hash)
+{
+    sb_hashmap_slot_t *slot = sb_hashmap_find(map, key, key_len, hash);
+    if (slot == NULL)
+        return false;
+
+    if (map->free_func != NULL)
+        map->free_func(slot->data);
+    free(slot->key);
+    map->size--;
+
+    // the slot must become a tombstone if it may be in the middle of the
+    // probe sequence of another key, i.e. if a probe may have found no empty
+    // slots in a group that contains it. this is not the case if the run of
+    // full and deleted slots around it is shorter than a group.
+    size_t i = slot - map->slots;
+    size_t mask = map->capacity - 1;
+    uint32_t empty_before = sb_hashmap_group_match(
+        map->ctrl + ((i - SB_HASHMAP_GROUP_WIDTH) & mask),
+        SB_HASHMAP_CTRL_EMPTY);
+    uint32_t empty_after = sb_hashmap_group_match(map->ctrl + i,
+        SB_HASHMAP_CTRL_EMPTY);
+    if (empty_before != 0 && empty_after != 0 &&
+        sb_hashmap_ctz(empty_after) + sb_hashmap_clz16(empty_before) <
+        SB_HASHMAP_GROUP_WIDTH)
+    {
+        sb_hashmap_set_ctrl(map, i, SB_HASHMAP_CTRL_EMPTY);
+        map->growth_left++;
+    }
+    else {
+        sb_hashmap_set_ctrl(map, i, SB_HASHMAP_CTRL_DELETED);
+    }
+    return true;
+}
+
+
+size_t
+sb_hashmap_size(sb_hashmap_t *map)
+{
+    if (map == NULL)
+        return 0;
+    return map->size;
+}
+
+
+void
+sb_hashmap_foreach(sb_hashmap_t *map, sb_hashmap_foreach_func_t func,
+    void *user_data)
+{
+    if (map == NULL || func == NULL)
+        return;
+    for (size_t i = 0; i < map->capacity; i++)
+        if ((map->ctrl[i] & 0x80) == 0)
+            func(map->slots[i].key, map->slots[i].data, user_data);
+}
+
+
+void
+sb_hashmap_foreach_len(sb_hashmap_t *map, sb_hashmap_foreach_len_func_t func,
+    void *user_data)
+{
+    if (map == NULL || func == NULL)
+        return;
+    for (size_t i = 0; i < map->capacity; i++)
+        if ((map->ctrl[i] & 0x80) == 0)
+            func(map->slots[i].key, map->slots[i].key_len,
+                map->slots[i].data, user_data);
+}
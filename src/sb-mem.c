@@ -40,3 +40,25 @@ sb_realloc(void *ptr, size_t size)
     }
     return rv;
 }
+
+
+void*
+sb_malloc_aligned(size_t alignment, size_t size)
+{
+#if defined(HAVE_POSIX_MEMALIGN)
+    void *rv = NULL;
+    if (posix_memalign(&rv, alignment, size) != 0)
+        rv = NULL;
+#elif defined(HAVE_ALIGNED_ALLOC)
+    // size must be a multiple of the alignment.
+    void *rv = aligned_alloc(alignment,
+        (size + alignment - 1) / alignment * alignment);
+#else
+    void *rv = malloc(size);
+#endif
+    if (rv == NULL) {
+        fprintf(stderr, "fatal: Failed to allocate memory!\n");
+        abort();
+    }
+    return rv;
+}
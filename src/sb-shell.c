@@ -17,10 +17,15 @@
 char*
 sb_shell_quote(const char *str)
 {
-    sb_string_t *rv = sb_string_new();
+    // quotes and exclamation marks are replaced by 4 characters.
+    size_t len = 0;
+    if (str != NULL)
+        for (size_t i = 0; str[i] != '\0'; i++)
+            len += str[i] == '!' || str[i] == '\'' ? 4 : 1;
+    sb_string_t *rv = sb_string_new_sized(len + 2);
     sb_string_append_c(rv, '\'');
     if (str != NULL) {
-        for (size_t i = 0; i < strlen(str); i++) {
+        for (size_t i = 0; str[i] != '\0'; i++) {
             switch (str[i]) {
                 case '!':
                     sb_string_append(rv, "'\\!'");
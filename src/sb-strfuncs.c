@@ -22,7 +22,8 @@
 #include <stdlib.h>
 #include <squareball/sb-mem.h>
 #include <squareball/sb-strfuncs.h>
-#include <squareball/sb-string.h>
+#include <squareball/sb-strfuncs-private.h>
+#include <squareball/sb-strview.h>
 
 #if defined(WIN32) || defined(_WIN32)
 #define strcasecmp _stricmp
@@ -96,25 +97,58 @@ sb_strdup_printf(const char *format, ...)
 }
 
 
+char*
+sb_str_concatv(size_t n, va_list ap)
+{
+    va_list ap2;
+    va_copy(ap2, ap);
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        const char *piece = va_arg(ap2, const char*);
+        if (piece != NULL)
+            len += strlen(piece);
+    }
+    va_end(ap2);
+
+    // pieces are measured again while copying, instead of storing their
+    // lengths, to not allocate memory for them.
+    char *rv = sb_malloc(len + 1);
+    char *tmp = rv;
+    for (size_t i = 0; i < n; i++) {
+        const char *piece = va_arg(ap, const char*);
+        if (piece == NULL)
+            continue;
+        size_t l = strlen(piece);
+        memcpy(tmp, piece, l);
+        tmp += l;
+    }
+    *tmp = '\0';
+    return rv;
+}
+
+
+char*
+sb_str_concat(size_t n, ...)
+{
+    va_list ap;
+    va_start(ap, n);
+    char *rv = sb_str_concatv(n, ap);
+    va_end(ap);
+    return rv;
+}
+
+
 bool
 sb_str_starts_with(const char *str, const char *prefix)
 {
-    int str_l = strlen(str);
-    int str_lp = strlen(prefix);
-    if (str_lp > str_l)
-        return false;
-    return strncmp(str, prefix, str_lp) == 0;
+    return sb_strview_starts_with(sb_strview(str), sb_strview(prefix));
 }
 
 
 bool
 sb_str_ends_with(const char *str, const char *suffix)
 {
-    int str_l = strlen(str);
-    int str_ls = strlen(suffix);
-    if (str_ls > str_l)
-        return false;
-    return strcmp(str + str_l - str_ls, suffix) == 0;
+    return sb_strview_ends_with(sb_strview(str), sb_strview(suffix));
 }
 
 
@@ -123,22 +157,7 @@ sb_str_lstrip(char *str)
 {
     if (str == NULL)
         return NULL;
-    int i;
-    size_t str_len = strlen(str);
-    for (i = 0; i < str_len; i++) {
-        if ((str[i] != ' ') && (str[i] != '\t') && (str[i] != '\n') &&
-            (str[i] != '\r') && (str[i] != '\t') && (str[i] != '\f') &&
-            (str[i] != '\v'))
-        {
-            str += i;
-            break;
-        }
-        if (i == str_len - 1) {
-            str += str_len;
-            break;
-        }
-    }
-    return str;
+    return (char*) sb_strview_lstrip(sb_strview(str)).str;
 }
 
 
@@ -147,21 +166,7 @@ sb_str_rstrip(char *str)
 {
     if (str == NULL)
         return NULL;
-    int i;
-    size_t str_len = strlen(str);
-    for (i = str_len - 1; i >= 0; i--) {
-        if ((str[i] != ' ') && (str[i] != '\t') && (str[i] != '\n') &&
-            (str[i] != '\r') && (str[i] != '\t') && (str[i] != '\f') &&
-            (str[i] != '\v'))
-        {
-            str[i + 1] = '\0';
-            break;
-        }
-        if (i == 0) {
-            str[0] = '\0';
-            break;
-        }
-    }
+    str[sb_strview_rstrip(sb_strview(str)).len] = '\0';
     return str;
 }
 
@@ -173,40 +178,117 @@ sb_str_strip(char *str)
 }
 
 
+char**
+sb_strv_alloc_packed(size_t count, size_t len)
+{
+    char **rv = sb_malloc((count + 1) * sizeof(char*) + len);
+    rv[count] = NULL;
+    return rv;
+}
+
+
 char**
 sb_str_split(const char *str, char c, size_t max_pieces)
 {
     if (str == NULL)
         return NULL;
-    char **rv = sb_malloc(sizeof(char*));
-    size_t i, start = 0, count = 0;
-    for (i = 0; i < strlen(str) + 1; i++) {
-        if (str[0] == '\0')
-            break;
-        if ((str[i] == c && (!max_pieces || count + 1 < max_pieces)) || str[i] == '\0') {
-            rv = sb_realloc(rv, (count + 1) * sizeof(char*));
-            rv[count] = sb_malloc(i - start + 1);
-            memcpy(rv[count], str + start, i - start);
-            rv[count++][i - start] = '\0';
-            start = i + 1;
-        }
+
+    // pieces are counted first, and the string is copied at once after the
+    // array, with the separators replaced with nul bytes.
+    size_t len = strlen(str);
+    size_t count = 0;
+    sb_str_split_iter_t iter;
+    sb_str_split_iter_init_len(&iter, str, len, c, max_pieces);
+    while (sb_str_split_iter_next(&iter, NULL))
+        count++;
+
+    char **rv = sb_strv_alloc_packed(count, count == 0 ? 0 : len + 1);
+    if (count == 0)
+        return rv;
+    char *buf = SB_STRV_PACKED_DATA(rv, count);
+    memcpy(buf, str, len + 1);
+
+    sb_strview_t piece;
+    sb_str_split_iter_init_len(&iter, str, len, c, max_pieces);
+    for (size_t i = 0; sb_str_split_iter_next(&iter, &piece); i++) {
+        rv[i] = buf + (piece.str - str);
+        rv[i][piece.len] = '\0';
     }
-    rv = sb_realloc(rv, (count + 1) * sizeof(char*));
-    rv[count] = NULL;
     return rv;
 }
 
 
+void
+sb_str_split_iter_init(sb_str_split_iter_t *iter, const char *str, char c,
+    size_t max_pieces)
+{
+    sb_str_split_iter_init_len(iter, str, str == NULL ? 0 : strlen(str), c,
+        max_pieces);
+}
+
+
+void
+sb_str_split_iter_init_len(sb_str_split_iter_t *iter, const char *str,
+    size_t len, char c, size_t max_pieces)
+{
+    if (iter == NULL)
+        return;
+    iter->rest = sb_strview_len(str, len);
+    iter->pieces = 0;
+    iter->max_pieces = max_pieces;
+    iter->c = c;
+
+    // like sb_str_split, empty strings have no pieces.
+    iter->done = iter->rest.len == 0;
+}
+
+
+bool
+sb_str_split_iter_next(sb_str_split_iter_t *iter, sb_strview_t *piece)
+{
+    if (iter == NULL || iter->done)
+        return false;
+    sb_strview_t head = iter->rest;
+    iter->pieces++;
+    if (iter->max_pieces == 0 || iter->pieces < iter->max_pieces)
+        iter->done = !sb_strview_split(iter->rest, iter->c, &head,
+            &iter->rest);
+    else
+        iter->done = true;
+    if (piece != NULL)
+        *piece = head;
+    return true;
+}
+
+
 char*
 sb_str_replace(const char *str, const char search, const char *replace)
 {
-    char **pieces = sb_str_split(str, search, 0);
-    if (pieces == NULL)
+    if (str == NULL)
         return NULL;
-    char* rv = sb_strv_join(pieces, replace);
-    sb_strv_free(pieces);
-    if (rv == NULL)
+    if (replace == NULL)
         return sb_strdup(str);
+
+    // occurrences are counted first, so the result is allocated once.
+    size_t len = strlen(str);
+    size_t replace_len = strlen(replace);
+    size_t count = 0;
+    for (const char *p = str; (p = memchr(p, search, len - (p - str))) != NULL;
+            p++)
+        count++;
+
+    char *rv = sb_malloc(len - count + count * replace_len + 1);
+    char *tmp = rv;
+    const char *start = str;
+    for (const char *p = str; (p = memchr(p, search, len - (p - str))) != NULL;
+            start = ++p)
+    {
+        memcpy(tmp, start, p - start);
+        tmp += p - start;
+        memcpy(tmp, replace, replace_len);
+        tmp += replace_len;
+    }
+    memcpy(tmp, start, len - (start - str) + 1);
     return rv;
 }
 
@@ -268,18 +350,80 @@ sb_strv_free(char **strv)
 }
 
 
+void
+sb_strv_free_packed(char **strv)
+{
+    free(strv);
+}
+
+
+char**
+sb_strv_new_packed(const sb_strview_t *pieces, size_t n)
+{
+    if (pieces == NULL && n > 0)
+        return NULL;
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++)
+        len += pieces[i].len + 1;
+    char **rv = sb_strv_alloc_packed(n, len);
+    char *buf = SB_STRV_PACKED_DATA(rv, n);
+    for (size_t i = 0; i < n; i++) {
+        rv[i] = buf;
+        if (pieces[i].len > 0)
+            memcpy(buf, pieces[i].str, pieces[i].len);
+        buf[pieces[i].len] = '\0';
+        buf += pieces[i].len + 1;
+    }
+    return rv;
+}
+
+
+char**
+sb_strv_pack(char **strv)
+{
+    if (strv == NULL)
+        return NULL;
+    size_t count = 0;
+    size_t len = 0;
+    for (; strv[count] != NULL; count++)
+        len += strlen(strv[count]) + 1;
+    char **rv = sb_strv_alloc_packed(count, len);
+    char *buf = SB_STRV_PACKED_DATA(rv, count);
+    for (size_t i = 0; i < count; i++) {
+        size_t l = strlen(strv[i]) + 1;
+        rv[i] = buf;
+        memcpy(buf, strv[i], l);
+        buf += l;
+    }
+    return rv;
+}
+
+
 char*
 sb_strv_join(char **strv, const char *separator)
 {
     if (strv == NULL || separator == NULL)
         return NULL;
-    sb_string_t *str = sb_string_new();
+
+    // the length of the result is measured first, so it is allocated once.
+    size_t len = 0;
+    size_t separator_len = strlen(separator);
+    for (size_t i = 0; strv[i] != NULL; i++)
+        len += strlen(strv[i]) + (strv[i + 1] != NULL ? separator_len : 0);
+
+    char *rv = sb_malloc(len + 1);
+    char *tmp = rv;
     for (size_t i = 0; strv[i] != NULL; i++) {
-        str = sb_string_append(str, strv[i]);
-        if (strv[i + 1] != NULL)
-            str = sb_string_append(str, separator);
+        size_t l = strlen(strv[i]);
+        memcpy(tmp, strv[i], l);
+        tmp += l;
+        if (strv[i + 1] != NULL) {
+            memcpy(tmp, separator, separator_len);
+            tmp += separator_len;
+        }
     }
-    return sb_string_free(str, false);
+    *tmp = '\0';
+    return rv;
 }
 
 
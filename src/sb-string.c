@@ -11,28 +11,90 @@
 #endif /* HAVE_CONFIG_H */
 
 #define SB_STRING_CHUNK_SIZE 128
+#define SB_STRING_MAX_DOUBLING (64 * 1024 * 1024)
 
 #include <ctype.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <squareball/sb-mem.h>
 #include <squareball/sb-strfuncs.h>
 #include <squareball/sb-string.h>
 
 
+static void
+sb_string_resize(sb_string_t *str, size_t allocated_len)
+{
+    // small strings are stored in the object itself. they are moved to the
+    // heap when they grow, and back when they shrink.
+    bool small = str->str == str->small_str;
+    if (allocated_len <= SB_STRING_SMALL_SIZE) {
+        if (!small) {
+            memcpy(str->small_str, str->str, str->len + 1);
+            free(str->str);
+            str->str = str->small_str;
+        }
+        str->allocated_len = SB_STRING_SMALL_SIZE;
+        return;
+    }
+    if (small) {
+        char *tmp = sb_malloc(allocated_len);
+        memcpy(tmp, str->str, str->len + 1);
+        str->str = tmp;
+    }
+    else {
+        str->str = sb_realloc(str->str, allocated_len);
+    }
+    str->allocated_len = allocated_len;
+}
+
+
+static void
+sb_string_grow(sb_string_t *str, size_t size)
+{
+    // size includes the NUL byte.
+    //
+    // the buffer grows geometrically, so appending n bytes costs O(n)
+    // amortized: it doubles until SB_STRING_MAX_DOUBLING, and grows by half
+    // after that, to not waste too much memory on huge strings. if the
+    // requested size is bigger than that, e.g. when appending a big chunk,
+    // it is allocated as is, to avoid overshooting. sizes are rounded to
+    // SB_STRING_CHUNK_SIZE.
+    if (size <= str->allocated_len)
+        return;
+    size_t increment = str->allocated_len < SB_STRING_MAX_DOUBLING ?
+        str->allocated_len : str->allocated_len / 2;
+    size_t allocated_len = str->allocated_len + increment;
+    if (allocated_len < size)
+        allocated_len = size;
+    if (allocated_len <= SIZE_MAX - SB_STRING_CHUNK_SIZE)
+        allocated_len = ((allocated_len + SB_STRING_CHUNK_SIZE - 1) /
+            SB_STRING_CHUNK_SIZE) * SB_STRING_CHUNK_SIZE;
+    sb_string_resize(str, allocated_len);
+}
+
+
 sb_string_t*
 sb_string_new(void)
 {
     sb_string_t* rv = sb_malloc(sizeof(sb_string_t));
-    rv->str = NULL;
+    rv->str = rv->small_str;
+    rv->str[0] = '\0';
     rv->len = 0;
-    rv->allocated_len = 0;
+    rv->allocated_len = SB_STRING_SMALL_SIZE;
+    return rv;
+}
 
-    // initialize with empty string
-    rv = sb_string_append(rv, "");
 
+sb_string_t*
+sb_string_new_sized(size_t len)
+{
+    sb_string_t* rv = sb_string_new();
+    if (len + 1 > rv->allocated_len)
+        sb_string_resize(rv, len + 1);
     return rv;
 }
 
@@ -43,10 +105,18 @@ sb_string_free(sb_string_t *str, bool free_str)
     if (str == NULL)
         return NULL;
     char *rv = NULL;
-    if (free_str)
-        free(str->str);
-    else
+    bool small = str->str == str->small_str;
+    if (free_str) {
+        if (!small)
+            free(str->str);
+    }
+    else if (small) {
+        rv = sb_malloc(str->len + 1);
+        memcpy(rv, str->str, str->len + 1);
+    }
+    else {
         rv = str->str;
+    }
     free(str);
     return rv;
 }
@@ -69,13 +139,9 @@ sb_string_append_len(sb_string_t *str, const char *suffix, size_t len)
         return NULL;
     if (suffix == NULL)
         return str;
-    size_t old_len = str->len;
+    sb_string_grow(str, str->len + len + 1);
+    memcpy(str->str + str->len, suffix, len);
     str->len += len;
-    if (str->len + 1 > str->allocated_len) {
-        str->allocated_len = (((str->len + 1) / SB_STRING_CHUNK_SIZE) + 1) * SB_STRING_CHUNK_SIZE;
-        str->str = sb_realloc(str->str, str->allocated_len);
-    }
-    memcpy(str->str + old_len, suffix, len);
     str->str[str->len] = '\0';
     return str;
 }
@@ -96,18 +162,44 @@ sb_string_append_c(sb_string_t *str, char c)
 {
     if (str == NULL)
         return NULL;
-    size_t old_len = str->len;
-    str->len += 1;
-    if (str->len + 1 > str->allocated_len) {
-        str->allocated_len = (((str->len + 1) / SB_STRING_CHUNK_SIZE) + 1) * SB_STRING_CHUNK_SIZE;
-        str->str = sb_realloc(str->str, str->allocated_len);
-    }
-    str->str[old_len] = c;
+    sb_string_grow(str, str->len + 2);
+    str->str[str->len++] = c;
     str->str[str->len] = '\0';
     return str;
 }
 
 
+sb_string_t*
+sb_string_append_vprintf(sb_string_t *str, const char *format, va_list ap)
+{
+    if (str == NULL)
+        return NULL;
+
+    if (format == NULL)
+        return str;
+
+    // formats directly into the spare capacity of the string, and only
+    // formats again, after growing the string, if it doesn't fit.
+    va_list ap2;
+    va_copy(ap2, ap);
+    size_t available = str->allocated_len - str->len;
+    int l = vsnprintf(str->str + str->len, available, format, ap);
+    if (l >= 0 && (size_t) l >= available) {
+        sb_string_grow(str, str->len + l + 1);
+        l = vsnprintf(str->str + str->len, l + 1, format, ap2);
+    }
+    va_end(ap2);
+
+    // vsnprintf(3) may write partial output on errors.
+    if (l < 0) {
+        str->str[str->len] = '\0';
+        return str;
+    }
+    str->len += l;
+    return str;
+}
+
+
 sb_string_t*
 sb_string_append_printf(sb_string_t *str, const char *format, ...)
 {
@@ -119,10 +211,8 @@ sb_string_append_printf(sb_string_t *str, const char *format, ...)
 
     va_list ap;
     va_start(ap, format);
-    char *tmp = sb_strdup_vprintf(format, ap);
+    str = sb_string_append_vprintf(str, format, ap);
     va_end(ap);
-    str = sb_string_append(str, tmp);
-    free(tmp);
     return str;
 }
 
@@ -145,3 +235,25 @@ sb_string_append_escaped(sb_string_t *str, const char *suffix)
     }
     return str;
 }
+
+
+sb_string_t*
+sb_string_reserve(sb_string_t *str, size_t len)
+{
+    if (str == NULL)
+        return NULL;
+    if (str->len + len + 1 > str->allocated_len)
+        sb_string_resize(str, str->len + len + 1);
+    return str;
+}
+
+
+sb_string_t*
+sb_string_shrink_to_fit(sb_string_t *str)
+{
+    if (str == NULL)
+        return NULL;
+    if (str->len + 1 < str->allocated_len)
+        sb_string_resize(str, str->len + 1);
+    return str;
+}
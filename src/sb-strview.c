@@ -0,0 +1,157 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <squareball/sb-mem.h>
+#include <squareball/sb-strview.h>
+
+
+static bool
+is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' ||
+        c == '\v';
+}
+
+
+sb_strview_t
+sb_strview(const char *str)
+{
+    return sb_strview_len(str, str == NULL ? 0 : strlen(str));
+}
+
+
+sb_strview_t
+sb_strview_len(const char *str, size_t len)
+{
+    sb_strview_t rv = {str, str == NULL ? 0 : len};
+    return rv;
+}
+
+
+sb_strview_t
+sb_strview_slice(sb_strview_t view, size_t start, size_t len)
+{
+    if (start > view.len)
+        start = view.len;
+    if (len > view.len - start)
+        len = view.len - start;
+    return sb_strview_len(view.str == NULL ? NULL : view.str + start, len);
+}
+
+
+char*
+sb_strview_dup(sb_strview_t view)
+{
+    if (view.str == NULL)
+        return NULL;
+    char *rv = sb_malloc(view.len + 1);
+    memcpy(rv, view.str, view.len);
+    rv[view.len] = '\0';
+    return rv;
+}
+
+
+bool
+sb_strview_equal(sb_strview_t a, sb_strview_t b)
+{
+    return a.len == b.len && (a.len == 0 || memcmp(a.str, b.str, a.len) == 0);
+}
+
+
+int
+sb_strview_compare(sb_strview_t a, sb_strview_t b)
+{
+    size_t len = a.len < b.len ? a.len : b.len;
+    int rv = len == 0 ? 0 : memcmp(a.str, b.str, len);
+    if (rv != 0)
+        return rv;
+    return a.len < b.len ? -1 : a.len > b.len;
+}
+
+
+bool
+sb_strview_starts_with(sb_strview_t view, sb_strview_t prefix)
+{
+    if (prefix.len > view.len)
+        return false;
+    return prefix.len == 0 || memcmp(view.str, prefix.str, prefix.len) == 0;
+}
+
+
+bool
+sb_strview_ends_with(sb_strview_t view, sb_strview_t suffix)
+{
+    if (suffix.len > view.len)
+        return false;
+    return suffix.len == 0 ||
+        memcmp(view.str + view.len - suffix.len, suffix.str, suffix.len) == 0;
+}
+
+
+sb_strview_t
+sb_strview_lstrip(sb_strview_t view)
+{
+    while (view.len > 0 && is_space(view.str[0])) {
+        view.str++;
+        view.len--;
+    }
+    return view;
+}
+
+
+sb_strview_t
+sb_strview_rstrip(sb_strview_t view)
+{
+    while (view.len > 0 && is_space(view.str[view.len - 1]))
+        view.len--;
+    return view;
+}
+
+
+sb_strview_t
+sb_strview_strip(sb_strview_t view)
+{
+    return sb_strview_lstrip(sb_strview_rstrip(view));
+}
+
+
+const char*
+sb_strview_find(sb_strview_t view, char c)
+{
+    for (size_t i = 0; i < view.len; i++) {
+        if (view.str[i] == '\\') {
+            i++;
+            continue;
+        }
+        if (view.str[i] == c)
+            return view.str + i;
+    }
+    return NULL;
+}
+
+
+bool
+sb_strview_split(sb_strview_t view, char c, sb_strview_t *head,
+    sb_strview_t *tail)
+{
+    const char *p = view.len == 0 ? NULL : memchr(view.str, c, view.len);
+    size_t head_len = p == NULL ? view.len : (size_t) (p - view.str);
+    if (head != NULL)
+        *head = sb_strview_len(view.str, head_len);
+    if (tail != NULL)
+        *tail = sb_strview_slice(view, p == NULL ? view.len : head_len + 1,
+            view.len);
+    return p != NULL;
+}
@@ -10,13 +10,62 @@
 #include <config.h>
 #endif /* HAVE_CONFIG_H */
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_SYS_STAT_H) && \
+    defined(HAVE_FCNTL_H) && defined(HAVE_UNISTD_H)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SB_TRIE_USE_MMAP
+#endif
+
+#include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <squareball/sb-error.h>
+#include <squareball/sb-file.h>
+#include <squareball/sb-hash-private.h>
 #include <squareball/sb-mem.h>
+#include <squareball/sb-strerror.h>
 #include <squareball/sb-string.h>
 #include <squareball/sb-trie.h>
 #include <squareball/sb-trie-private.h>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define SB_TRIE_USE_SSE2
+#endif
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+
+// concurrent tries are only supported if the compiler provides atomic
+// builtins. the fallbacks are never used with concurrent tries, but the
+// counters of the filters are updated without them, as plain increments.
+#ifdef HAVE_ATOMIC_BUILTINS
+#define SB_TRIE_USE_ATOMICS
+#define sb_trie_atomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define sb_trie_atomic_store(ptr, val) \
+    __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST)
+#define sb_trie_atomic_add(ptr, val) \
+    __atomic_fetch_add(ptr, val, __ATOMIC_SEQ_CST)
+#define sb_trie_atomic_sub(ptr, val) \
+    __atomic_fetch_sub(ptr, val, __ATOMIC_SEQ_CST)
+#define sb_trie_atomic_load_relaxed(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define sb_trie_atomic_inc_relaxed(ptr) \
+    ((void) __atomic_fetch_add(ptr, 1, __ATOMIC_RELAXED))
+#else
+#define sb_trie_atomic_load(ptr) (*(ptr))
+#define sb_trie_atomic_store(ptr, val) (*(ptr) = (val))
+#define sb_trie_atomic_add(ptr, val) ((*(ptr) += (val)) - (val))
+#define sb_trie_atomic_sub(ptr, val) ((*(ptr) -= (val)) + (val))
+#define sb_trie_atomic_load_relaxed(ptr) (*(ptr))
+#define sb_trie_atomic_inc_relaxed(ptr) ((void) (*(ptr))++)
+#endif
+
 
 sb_trie_t*
 sb_trie_new(sb_free_func_t free_func)
@@ -24,178 +73,2351 @@ sb_trie_new(sb_free_func_t free_func)
     sb_trie_t *trie = sb_malloc(sizeof(sb_trie_t));
     trie->root = NULL;
     trie->free_func = free_func;
+    trie->size = 0;
+    trie->num_nodes = 0;
+    memset(&trie->arena, 0, sizeof(sb_trie_arena_t));
+    trie->sync = NULL;
+    trie->filter = NULL;
+    return trie;
+}
+
+
+sb_trie_t*
+sb_trie_new_concurrent(sb_free_func_t free_func)
+{
+#ifdef SB_TRIE_USE_ATOMICS
+    sb_trie_t *trie = sb_trie_new(free_func);
+    trie->sync = sb_malloc_aligned(SB_TRIE_SYNC_CACHE_LINE,
+        sizeof(sb_trie_sync_t));
+    memset(trie->sync, 0, sizeof(sb_trie_sync_t));
     return trie;
+#else
+    return NULL;
+#endif
+}
+
+
+static size_t
+sb_trie_arena_class(size_t size, size_t *class_size)
+{
+    // size classes are 16 bytes apart up to 256 bytes, 64 bytes apart up to
+    // 1024 bytes, and 256 bytes apart up to 4096 bytes.
+    size_t c;
+    if (size <= 256) {
+        c = size <= 16 ? 1 : (size + 15) / 16;
+        *class_size = c * 16;
+        return c - 1;
+    }
+    if (size <= 1024) {
+        c = (size - 256 + 63) / 64;
+        *class_size = 256 + c * 64;
+        return 15 + c;
+    }
+    c = (size - 1024 + 255) / 256;
+    *class_size = 1024 + c * 256;
+    return 27 + c;
+}
+
+
+static void*
+sb_trie_arena_alloc(sb_trie_arena_t *arena, size_t size)
+{
+    if (size > SB_TRIE_ARENA_MAX_CLASS_SIZE) {
+        sb_trie_arena_large_t *l = sb_malloc(sizeof(sb_trie_arena_large_t) +
+            size);
+        l->prev = NULL;
+        l->next = arena->large;
+        if (arena->large != NULL)
+            arena->large->prev = l;
+        arena->large = l;
+        arena->allocated_len += sizeof(sb_trie_arena_large_t) + size;
+        return l + 1;
+    }
+
+    size_t class_size;
+    size_t c = sb_trie_arena_class(size, &class_size);
+
+    void *rv = arena->free_list[c];
+    if (rv != NULL) {
+        arena->free_list[c] = *(void**) rv;
+        return rv;
+    }
+
+    if (arena->ptr == NULL || (size_t) (arena->end - arena->ptr) < class_size) {
+        // whatever is left in the current chunk is wasted. chunks grow
+        // geometrically, so this is bounded.
+        size_t chunk_size = SB_TRIE_ARENA_MIN_CHUNK_SIZE;
+        if (arena->chunks != NULL)
+            chunk_size = 2 * arena->chunks->size;
+        if (chunk_size > SB_TRIE_ARENA_MAX_CHUNK_SIZE)
+            chunk_size = SB_TRIE_ARENA_MAX_CHUNK_SIZE;
+        if (chunk_size < class_size)
+            chunk_size = class_size;
+        sb_trie_arena_chunk_t *chunk = sb_malloc(
+            sizeof(sb_trie_arena_chunk_t) + chunk_size);
+        chunk->next = arena->chunks;
+        chunk->size = chunk_size;
+        arena->chunks = chunk;
+        arena->allocated_len += sizeof(sb_trie_arena_chunk_t) + chunk_size;
+        arena->ptr = (uint8_t*) (chunk + 1);
+        arena->end = arena->ptr + chunk_size;
+    }
+
+    rv = arena->ptr;
+    arena->ptr += class_size;
+    return rv;
 }
 
 
 static void
-sb_trie_free_node(sb_trie_t *trie, sb_trie_node_t *node)
+sb_trie_arena_release(sb_trie_arena_t *arena, void *ptr, size_t size)
 {
-    if (trie == NULL || node == NULL)
+    // size may be smaller than the size originally requested (e.g. node keys
+    // are shortened in place when splitting edges). it is safe to reuse the
+    // block for the smaller size class.
+    if (size > SB_TRIE_ARENA_MAX_CLASS_SIZE) {
+        sb_trie_arena_large_t *l = (sb_trie_arena_large_t*) ptr - 1;
+        if (l->prev != NULL)
+            l->prev->next = l->next;
+        else
+            arena->large = l->next;
+        if (l->next != NULL)
+            l->next->prev = l->prev;
+        arena->allocated_len -= sizeof(sb_trie_arena_large_t) + size;
+        free(l);
         return;
-    if (node->data != NULL && trie->free_func != NULL)
-        trie->free_func(node->data);
-    sb_trie_free_node(trie, node->next);
-    sb_trie_free_node(trie, node->child);
-    free(node);
+    }
+
+    size_t class_size;
+    size_t c = sb_trie_arena_class(size, &class_size);
+    *(void**) ptr = arena->free_list[c];
+    arena->free_list[c] = ptr;
 }
 
 
-void
-sb_trie_free(sb_trie_t *trie)
+static void
+sb_trie_arena_free(sb_trie_arena_t *arena)
 {
-    if (trie == NULL)
+    while (arena->chunks != NULL) {
+        sb_trie_arena_chunk_t *tmp = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = tmp;
+    }
+    while (arena->large != NULL) {
+        sb_trie_arena_large_t *tmp = arena->large->next;
+        free(arena->large);
+        arena->large = tmp;
+    }
+}
+
+
+static sb_trie_node_t*
+sb_trie_node_new(sb_trie_t *trie, uint8_t type, const uint8_t *key,
+    size_t key_len)
+{
+    size_t size = sb_trie_node_size(type);
+    sb_trie_node_t *node = sb_trie_arena_alloc(&trie->arena, size + key_len);
+    trie->num_nodes++;
+    memset(node, 0, size);
+    node->type = type;
+    node->key_len = key_len;
+    if (key != NULL && key_len > 0)
+        memcpy((uint8_t*) node + size, key, key_len);
+
+    sb_trie_sync_t *sync = trie->sync;
+    if (sync != NULL) {
+        if (sync->fresh_len == sync->fresh_allocated_len) {
+            sync->fresh_allocated_len = sync->fresh_allocated_len == 0 ? 16 :
+                2 * sync->fresh_allocated_len;
+            sync->fresh = sb_realloc(sync->fresh,
+                sync->fresh_allocated_len * sizeof(sb_trie_node_t*));
+        }
+        sync->fresh[sync->fresh_len++] = node;
+    }
+
+    return node;
+}
+
+
+static void
+sb_trie_sync_retire(sb_trie_sync_t *sync, void *ptr, size_t size)
+{
+    if (sync->retired_len == sync->retired_allocated_len) {
+        sync->retired_allocated_len = sync->retired_allocated_len == 0 ? 16 :
+            2 * sync->retired_allocated_len;
+        sync->retired = sb_realloc(sync->retired,
+            sync->retired_allocated_len * sizeof(sb_trie_sync_retired_t));
+    }
+    sync->retired[sync->retired_len].ptr = ptr;
+    sync->retired[sync->retired_len++].size = size;
+}
+
+
+static size_t
+sb_trie_sync_find_fresh(sb_trie_sync_t *sync, sb_trie_node_t *node)
+{
+    // returns the position of node in the fresh list + 1, or 0 if the node is
+    // not fresh. recently created nodes are the most likely to be looked for.
+    for (size_t i = sync->fresh_len; i > 0; i--)
+        if (sync->fresh[i - 1] == node)
+            return i;
+    return 0;
+}
+
+
+static void
+sb_trie_node_release(sb_trie_t *trie, sb_trie_node_t *node)
+{
+    size_t size = sb_trie_node_size(node->type) + node->key_len;
+
+    // nodes that may be visible to readers are only released after the
+    // update is published, and the readers are done with them.
+    sb_trie_sync_t *sync = trie->sync;
+    if (sync != NULL) {
+        size_t i = sb_trie_sync_find_fresh(sync, node);
+        if (i == 0) {
+            sb_trie_sync_retire(sync, node, size);
+            return;
+        }
+        sync->fresh[i - 1] = sync->fresh[--sync->fresh_len];
+    }
+
+    trie->num_nodes--;
+    sb_trie_arena_release(&trie->arena, node, size);
+}
+
+
+static sb_trie_node_t*
+sb_trie_node_cow(sb_trie_t *trie, sb_trie_node_t **ref)
+{
+    // make a node of a concurrent trie writable, by replacing it with a
+    // fresh copy. ref must be writable already.
+    sb_trie_node_t *node = *ref;
+    if (trie->sync == NULL || sb_trie_sync_find_fresh(trie->sync, node) != 0)
+        return node;
+
+    sb_trie_node_t *rv = sb_trie_node_new(trie, node->type, NULL,
+        node->key_len);
+    memcpy(rv, node, sb_trie_node_size(node->type) + node->key_len);
+    sb_trie_node_release(trie, node);
+    *ref = rv;
+    return rv;
+}
+
+
+static void
+sb_trie_data_free(sb_trie_t *trie, void *data)
+{
+    if (trie->free_func == NULL)
         return;
-    sb_trie_free_node(trie, trie->root);
-    free(trie);
+    if (trie->sync != NULL)
+        sb_trie_sync_retire(trie->sync, data, 0);
+    else
+        trie->free_func(data);
+}
+
+
+static void
+sb_trie_sync_pause(void)
+{
+#ifdef HAVE_SCHED_H
+    sched_yield();
+#endif
+}
+
+
+static void sb_trie_sync_reclaim(sb_trie_t *trie);
+
+
+static void
+sb_trie_commit(sb_trie_t *trie, sb_trie_node_t *root, size_t size)
+{
+    sb_trie_sync_t *sync = trie->sync;
+    if (sync == NULL) {
+        trie->root = root;
+        trie->size = size;
+        return;
+    }
+
+    // fresh nodes are published with the root, and must not be changed
+    // anymore.
+    sync->fresh_len = 0;
+    sb_trie_atomic_store(&trie->root, root);
+    sb_trie_atomic_store(&trie->size, size);
+
+    // retired nodes and elements are reclaimed in batches, to amortize the
+    // cost of waiting for the readers.
+    if (sync->retired_len < SB_TRIE_SYNC_MAX_RETIRED)
+        return;
+    sb_trie_sync_reclaim(trie);
+}
+
+
+static void
+sb_trie_sync_reclaim(sb_trie_t *trie)
+{
+    sb_trie_sync_t *sync = trie->sync;
+
+    // readers that start after the epoch is flipped can only see the new
+    // root. wait for the others.
+    size_t parity = sb_trie_atomic_add(&sync->epoch, 1) & 1;
+    for (size_t i = 0; i < SB_TRIE_SYNC_STRIPES; i++)
+        while (sb_trie_atomic_load(&sync->readers[parity][i].count) != 0)
+            sb_trie_sync_pause();
+
+    for (size_t i = 0; i < sync->retired_len; i++) {
+        sb_trie_sync_retired_t *r = &sync->retired[i];
+        if (r->size == 0) {
+            trie->free_func(r->ptr);
+            continue;
+        }
+        trie->num_nodes--;
+        sb_trie_arena_release(&trie->arena, r->ptr, r->size);
+    }
+    sync->retired_len = 0;
+}
+
+
+unsigned int
+sb_trie_read_lock(sb_trie_t *trie)
+{
+    if (trie == NULL || trie->sync == NULL)
+        return 0;
+
+    // threads are told apart by the address of their stacks.
+    uintptr_t addr = (uintptr_t) &addr;
+    unsigned int stripe = (((uint32_t) ((addr >> 12) * 2654435761u)) >> 16) %
+        SB_TRIE_SYNC_STRIPES;
+
+    // if the epoch was flipped before the reader was registered, the writer
+    // may not have seen it. register again with the new epoch.
+    while (true) {
+        size_t epoch = sb_trie_atomic_load(&trie->sync->epoch);
+        size_t *count = &trie->sync->readers[epoch & 1][stripe].count;
+        sb_trie_atomic_add(count, 1);
+        if (sb_trie_atomic_load(&trie->sync->epoch) == epoch)
+            return (stripe << 1) | (epoch & 1);
+        sb_trie_atomic_sub(count, 1);
+    }
 }
 
 
 void
-sb_trie_insert(sb_trie_t *trie, const char *key, void *data)
+sb_trie_read_unlock(sb_trie_t *trie, unsigned int token)
 {
-    if (trie == NULL || key == NULL || data == NULL)
+    if (trie == NULL || trie->sync == NULL)
         return;
+    sb_trie_atomic_sub(&trie->sync->readers[token & 1][token >> 1].count, 1);
+}
 
-    sb_trie_node_t *parent = NULL;
-    sb_trie_node_t *previous;
-    sb_trie_node_t *current;
-    sb_trie_node_t *tmp;
 
-    while (1) {
+static inline sb_trie_node_t*
+sb_trie_get_root(sb_trie_t *trie)
+{
+    if (trie->sync != NULL)
+        return sb_trie_atomic_load(&trie->root);
+    return trie->root;
+}
 
-        if (trie->root == NULL || (parent != NULL && parent->child == NULL)) {
-            current = sb_malloc(sizeof(sb_trie_node_t));
-            current->key = *key;
-            current->data = NULL;
-            current->next = NULL;
-            current->child = NULL;
-            if (trie->root == NULL)
-                trie->root = current;
-            else
-                parent->child = current;
-            parent = current;
-            goto clean;
+
+static sb_trie_node_t**
+sb_trie_node_find_child(sb_trie_node_t *node, uint8_t c)
+{
+    size_t i;
+
+    switch (node->type) {
+
+        case SB_TRIE_NODE_4: {
+            sb_trie_node4_t *n = (sb_trie_node4_t*) node;
+            for (i = 0; i < node->num_children; i++)
+                if (n->keys[i] == c)
+                    return &n->children[i];
+            break;
+        }
+
+        case SB_TRIE_NODE_16: {
+            sb_trie_node16_t *n = (sb_trie_node16_t*) node;
+#ifdef SB_TRIE_USE_SSE2
+            __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char) c),
+                _mm_loadu_si128((const __m128i*) n->keys));
+            unsigned int mask = _mm_movemask_epi8(cmp) &
+                ((1U << node->num_children) - 1);
+            if (mask != 0)
+                return &n->children[__builtin_ctz(mask)];
+#else
+            for (i = 0; i < node->num_children && n->keys[i] <= c; i++)
+                if (n->keys[i] == c)
+                    return &n->children[i];
+#endif
+            break;
         }
 
-        tmp = parent == NULL ? trie->root : parent->child;
-        previous = NULL;
+        case SB_TRIE_NODE_48: {
+            sb_trie_node48_t *n = (sb_trie_node48_t*) node;
+            if (n->index[c] != 0)
+                return &n->children[n->index[c] - 1];
+            break;
+        }
 
-        while (tmp != NULL && tmp->key != *key) {
-            previous = tmp;
-            tmp = tmp->next;
+        case SB_TRIE_NODE_256: {
+            sb_trie_node256_t *n = (sb_trie_node256_t*) node;
+            if (n->children[c] != NULL)
+                return &n->children[c];
+            break;
         }
+    }
 
-        parent = tmp;
+    return NULL;
+}
 
-        if (previous == NULL || parent != NULL)
-            goto clean;
 
-        current = sb_malloc(sizeof(sb_trie_node_t));
-        current->key = *key;
-        current->data = NULL;
-        current->next = NULL;
-        current->child = NULL;
-        previous->next = current;
-        parent = current;
+static sb_trie_node_t*
+sb_trie_node_next_child(sb_trie_node_t *node, size_t *pos)
+{
+    // for nodes with sorted keys, pos is the position in the children
+    // array, otherwise it is the next byte to be looked for.
+    switch (node->type) {
 
-clean:
-        if (*key == '\0') {
-            if (parent->data != NULL && trie->free_func != NULL)
-                trie->free_func(parent->data);
-            parent->data = data;
+        case SB_TRIE_NODE_4:
+            if (*pos < node->num_children)
+                return ((sb_trie_node4_t*) node)->children[(*pos)++];
+            break;
+
+        case SB_TRIE_NODE_16:
+            if (*pos < node->num_children)
+                return ((sb_trie_node16_t*) node)->children[(*pos)++];
+            break;
+
+        case SB_TRIE_NODE_48: {
+            sb_trie_node48_t *n = (sb_trie_node48_t*) node;
+            while (*pos < 256) {
+                uint8_t idx = n->index[(*pos)++];
+                if (idx != 0)
+                    return n->children[idx - 1];
+            }
+            break;
+        }
+
+        case SB_TRIE_NODE_256: {
+            sb_trie_node256_t *n = (sb_trie_node256_t*) node;
+            while (*pos < 256) {
+                sb_trie_node_t *child = n->children[(*pos)++];
+                if (child != NULL)
+                    return child;
+            }
             break;
         }
-        key++;
     }
+
+    return NULL;
+}
+
+
+static size_t
+sb_trie_node_child_pos(sb_trie_node_t *node, uint8_t c)
+{
+    // returns the position where sb_trie_node_next_child() should start to
+    // return the children whose keys start with c or greater bytes.
+    const uint8_t *keys;
+    switch (node->type) {
+        case SB_TRIE_NODE_4:
+            keys = ((sb_trie_node4_t*) node)->keys;
+            break;
+        case SB_TRIE_NODE_16:
+            keys = ((sb_trie_node16_t*) node)->keys;
+            break;
+        case SB_TRIE_NODE_48:
+        case SB_TRIE_NODE_256:
+            return c;
+        default:
+            return 0;
+    }
+
+    size_t i = 0;
+    while (i < node->num_children && keys[i] < c)
+        i++;
+    return i;
 }
 
 
-void*
-sb_trie_lookup(sb_trie_t *trie, const char *key)
+static sb_trie_node_t*
+sb_trie_node_grow(sb_trie_t *trie, sb_trie_node_t *node)
 {
-    if (trie == NULL || trie->root == NULL || key == NULL)
-        return NULL;
+    sb_trie_node_t *rv = NULL;
+    size_t i;
 
-    sb_trie_node_t *parent = trie->root;
-    sb_trie_node_t *tmp;
-    while (1) {
-        for (tmp = parent; tmp != NULL; tmp = tmp->next) {
+    switch (node->type) {
 
-            if (tmp->key == *key) {
-                if (tmp->key == '\0')
-                    return tmp->data;
-                parent = tmp->child;
-                break;
+        case SB_TRIE_NODE_LEAF:
+            rv = sb_trie_node_new(trie, SB_TRIE_NODE_4,
+                sb_trie_node_key(node), node->key_len);
+            break;
+
+        case SB_TRIE_NODE_4: {
+            sb_trie_node4_t *n = (sb_trie_node4_t*) node;
+            rv = sb_trie_node_new(trie, SB_TRIE_NODE_16,
+                sb_trie_node_key(node), node->key_len);
+            sb_trie_node16_t *r = (sb_trie_node16_t*) rv;
+            memcpy(r->keys, n->keys, node->num_children);
+            memcpy(r->children, n->children,
+                node->num_children * sizeof(sb_trie_node_t*));
+            break;
+        }
+
+        case SB_TRIE_NODE_16: {
+            sb_trie_node16_t *n = (sb_trie_node16_t*) node;
+            rv = sb_trie_node_new(trie, SB_TRIE_NODE_48,
+                sb_trie_node_key(node), node->key_len);
+            sb_trie_node48_t *r = (sb_trie_node48_t*) rv;
+            for (i = 0; i < node->num_children; i++) {
+                r->index[n->keys[i]] = i + 1;
+                r->children[i] = n->children[i];
             }
+            break;
         }
-        if (tmp == NULL)
-            return NULL;
 
-        if (*key == '\0')
+        case SB_TRIE_NODE_48: {
+            sb_trie_node48_t *n = (sb_trie_node48_t*) node;
+            rv = sb_trie_node_new(trie, SB_TRIE_NODE_256,
+                sb_trie_node_key(node), node->key_len);
+            sb_trie_node256_t *r = (sb_trie_node256_t*) rv;
+            for (i = 0; i < 256; i++)
+                if (n->index[i] != 0)
+                    r->children[i] = n->children[n->index[i] - 1];
             break;
-        key++;
+        }
+    }
+
+    rv->num_children = node->num_children;
+    rv->data = node->data;
+    rv->flags |= node->flags & SB_TRIE_NODE_TERMINAL;
+    sb_trie_node_release(trie, node);
+    return rv;
+}
+
+
+static sb_trie_node_t**
+sb_trie_node_add_child(sb_trie_t *trie, sb_trie_node_t **ref, uint8_t c,
+    sb_trie_node_t *child)
+{
+    sb_trie_node_t *node = *ref;
+    size_t i;
+
+    if ((node->type == SB_TRIE_NODE_LEAF) ||
+        (node->type == SB_TRIE_NODE_4 && node->num_children == 4) ||
+        (node->type == SB_TRIE_NODE_16 && node->num_children == 16) ||
+        (node->type == SB_TRIE_NODE_48 && node->num_children == 48))
+    {
+        node = sb_trie_node_grow(trie, node);
+        *ref = node;
+    }
+
+    node->num_children++;
+
+    switch (node->type) {
+
+        case SB_TRIE_NODE_4: {
+            sb_trie_node4_t *n = (sb_trie_node4_t*) node;
+            for (i = 0; i + 1 < node->num_children && n->keys[i] < c; i++);
+            memmove(n->keys + i + 1, n->keys + i, node->num_children - 1 - i);
+            memmove(n->children + i + 1, n->children + i,
+                (node->num_children - 1 - i) * sizeof(sb_trie_node_t*));
+            n->keys[i] = c;
+            n->children[i] = child;
+            return &n->children[i];
+        }
+
+        case SB_TRIE_NODE_16: {
+            sb_trie_node16_t *n = (sb_trie_node16_t*) node;
+            for (i = 0; i + 1 < node->num_children && n->keys[i] < c; i++);
+            memmove(n->keys + i + 1, n->keys + i, node->num_children - 1 - i);
+            memmove(n->children + i + 1, n->children + i,
+                (node->num_children - 1 - i) * sizeof(sb_trie_node_t*));
+            n->keys[i] = c;
+            n->children[i] = child;
+            return &n->children[i];
+        }
+
+        case SB_TRIE_NODE_48: {
+            sb_trie_node48_t *n = (sb_trie_node48_t*) node;
+            for (i = 0; n->children[i] != NULL; i++);
+            n->index[c] = i + 1;
+            n->children[i] = child;
+            return &n->children[i];
+        }
+
+        case SB_TRIE_NODE_256: {
+            sb_trie_node256_t *n = (sb_trie_node256_t*) node;
+            n->children[c] = child;
+            return &n->children[c];
+        }
     }
+
     return NULL;
 }
 
 
+static sb_trie_node_t*
+sb_trie_node_shrink(sb_trie_t *trie, sb_trie_node_t *node)
+{
+    sb_trie_node_t *rv = NULL;
+    size_t i;
+    size_t j;
+
+    switch (node->type) {
+
+        case SB_TRIE_NODE_4:
+            rv = sb_trie_node_new(trie, SB_TRIE_NODE_LEAF,
+                sb_trie_node_key(node), node->key_len);
+            break;
+
+        case SB_TRIE_NODE_16: {
+            sb_trie_node16_t *n = (sb_trie_node16_t*) node;
+            rv = sb_trie_node_new(trie, SB_TRIE_NODE_4,
+                sb_trie_node_key(node), node->key_len);
+            sb_trie_node4_t *r = (sb_trie_node4_t*) rv;
+            memcpy(r->keys, n->keys, node->num_children);
+            memcpy(r->children, n->children,
+                node->num_children * sizeof(sb_trie_node_t*));
+            break;
+        }
+
+        case SB_TRIE_NODE_48: {
+            sb_trie_node48_t *n = (sb_trie_node48_t*) node;
+            rv = sb_trie_node_new(trie, SB_TRIE_NODE_16,
+                sb_trie_node_key(node), node->key_len);
+            sb_trie_node16_t *r = (sb_trie_node16_t*) rv;
+            for (i = 0, j = 0; i < 256; i++) {
+                if (n->index[i] != 0) {
+                    r->keys[j] = i;
+                    r->children[j++] = n->children[n->index[i] - 1];
+                }
+            }
+            break;
+        }
+
+        case SB_TRIE_NODE_256: {
+            sb_trie_node256_t *n = (sb_trie_node256_t*) node;
+            rv = sb_trie_node_new(trie, SB_TRIE_NODE_48,
+                sb_trie_node_key(node), node->key_len);
+            sb_trie_node48_t *r = (sb_trie_node48_t*) rv;
+            for (i = 0, j = 0; i < 256; i++) {
+                if (n->children[i] != NULL) {
+                    r->index[i] = j + 1;
+                    r->children[j++] = n->children[i];
+                }
+            }
+            break;
+        }
+    }
+
+    rv->num_children = node->num_children;
+    rv->data = node->data;
+    rv->flags |= node->flags & SB_TRIE_NODE_TERMINAL;
+    sb_trie_node_release(trie, node);
+    return rv;
+}
+
+
 static void
-sb_trie_size_node(sb_trie_node_t *node, size_t *count)
+sb_trie_node_remove_child(sb_trie_t *trie, sb_trie_node_t **ref, uint8_t c)
 {
-    if (node == NULL || count == NULL)
-        return;
+    sb_trie_node_t *node = *ref;
+    size_t i;
+
+    switch (node->type) {
+
+        case SB_TRIE_NODE_4: {
+            sb_trie_node4_t *n = (sb_trie_node4_t*) node;
+            for (i = 0; n->keys[i] != c; i++);
+            memmove(n->keys + i, n->keys + i + 1, node->num_children - 1 - i);
+            memmove(n->children + i, n->children + i + 1,
+                (node->num_children - 1 - i) * sizeof(sb_trie_node_t*));
+            break;
+        }
+
+        case SB_TRIE_NODE_16: {
+            sb_trie_node16_t *n = (sb_trie_node16_t*) node;
+            for (i = 0; n->keys[i] != c; i++);
+            memmove(n->keys + i, n->keys + i + 1, node->num_children - 1 - i);
+            memmove(n->children + i, n->children + i + 1,
+                (node->num_children - 1 - i) * sizeof(sb_trie_node_t*));
+            break;
+        }
+
+        case SB_TRIE_NODE_48: {
+            sb_trie_node48_t *n = (sb_trie_node48_t*) node;
+            n->children[n->index[c] - 1] = NULL;
+            n->index[c] = 0;
+            break;
+        }
 
-    if (node->key == '\0')
-        (*count)++;
+        case SB_TRIE_NODE_256:
+            ((sb_trie_node256_t*) node)->children[c] = NULL;
+            break;
+    }
 
-    sb_trie_size_node(node->next, count);
-    sb_trie_size_node(node->child, count);
+    node->num_children--;
+
+    // shrink with some slack, to avoid growing and shrinking the same node
+    // repeatedly when adding and removing children around the boundaries.
+    if ((node->type == SB_TRIE_NODE_4 && node->num_children == 0) ||
+        (node->type == SB_TRIE_NODE_16 && node->num_children <= 3) ||
+        (node->type == SB_TRIE_NODE_48 && node->num_children <= 12) ||
+        (node->type == SB_TRIE_NODE_256 && node->num_children <= 40))
+    {
+        *ref = sb_trie_node_shrink(trie, node);
+    }
 }
 
 
-size_t
-sb_trie_size(sb_trie_t *trie)
+static void
+sb_trie_node_merge(sb_trie_t *trie, sb_trie_node_t **ref)
 {
-    if (trie == NULL)
-        return 0;
+    // the node is not terminal and has a single child: collapse both into a
+    // single node, with the concatenation of both edges.
+    sb_trie_node_t *node = *ref;
+    size_t pos = 0;
+    sb_trie_node_t *child = sb_trie_node_next_child(node, &pos);
+
+    size_t key_len = node->key_len + child->key_len;
+    if (key_len > SB_TRIE_NODE_MAX_KEY_LEN)
+        return;
+
+    size_t size = sb_trie_node_size(child->type);
+    sb_trie_node_t *rv = sb_trie_node_new(trie, child->type, NULL, key_len);
+    uint8_t flags = rv->flags;
+    memcpy(rv, child, size);
+    rv->flags = flags | (child->flags & SB_TRIE_NODE_TERMINAL);
+    rv->key_len = key_len;
+    memcpy((uint8_t*) rv + size, sb_trie_node_key(node), node->key_len);
+    memcpy((uint8_t*) rv + size + node->key_len, sb_trie_node_key(child),
+        child->key_len);
+
+    sb_trie_node_release(trie, node);
+    sb_trie_node_release(trie, child);
+    *ref = rv;
+}
+
+
+/*
+ * Tree walks use an explicit, heap-allocated stack of frames, one for each
+ * level of the path being visited, instead of recursion, so they run in
+ * bounded native stack regardless of the shape of the trie.
+ */
+
+typedef struct {
+    sb_trie_node_t *node;
+    size_t pos;
+    size_t key_len;
+    size_t offset;
+} sb_trie_frame_t;
+
+typedef struct {
+    sb_trie_frame_t *frames;
+    size_t len;
+    size_t allocated_len;
+} sb_trie_stack_t;
 
-    size_t count = 0;
-    sb_trie_size_node(trie->root, &count);
-    return count;
+
+static sb_trie_frame_t*
+sb_trie_stack_push(sb_trie_stack_t *stack, sb_trie_node_t *node)
+{
+    if (stack->len == stack->allocated_len) {
+        stack->allocated_len = stack->allocated_len == 0 ? 16 :
+            2 * stack->allocated_len;
+        stack->frames = sb_realloc(stack->frames,
+            stack->allocated_len * sizeof(sb_trie_frame_t));
+    }
+    sb_trie_frame_t *frame = &stack->frames[stack->len++];
+    frame->node = node;
+    frame->pos = 0;
+    frame->key_len = 0;
+    frame->offset = 0;
+    return frame;
 }
 
 
 static void
-sb_trie_foreach_node(sb_trie_node_t *node, sb_string_t *str,
-    sb_trie_foreach_func_t func, void *user_data)
+sb_trie_free_node_data(sb_trie_t *trie, sb_trie_node_t *node)
 {
-    if (node == NULL || str == NULL || func == NULL)
+    if (trie == NULL || node == NULL)
         return;
 
-    if (node->key == '\0')
-        func(str->str, node->data, user_data);
+    if (node->data != NULL)
+        trie->free_func(node->data);
+
+    sb_trie_stack_t stack = {NULL, 0, 0};
+    sb_trie_stack_push(&stack, node);
 
-    if (node->child != NULL) {
-        sb_string_t *child = sb_string_dup(str);
-        child = sb_string_append_c(child, node->key);
-        sb_trie_foreach_node(node->child, child, func, user_data);
-        sb_string_free(child, true);
+    while (stack.len > 0) {
+        sb_trie_frame_t *frame = &stack.frames[stack.len - 1];
+        sb_trie_node_t *child = sb_trie_node_next_child(frame->node,
+            &frame->pos);
+        if (child == NULL) {
+            stack.len--;
+            continue;
+        }
+        if (child->data != NULL)
+            trie->free_func(child->data);
+        if (child->type != SB_TRIE_NODE_LEAF)
+            sb_trie_stack_push(&stack, child);
     }
 
-    if (node->next != NULL)
-        sb_trie_foreach_node(node->next, str, func, user_data);
+    free(stack.frames);
 }
 
 
 void
-sb_trie_foreach(sb_trie_t *trie, sb_trie_foreach_func_t func,
-    void *user_data)
+sb_trie_free(sb_trie_t *trie)
 {
-    if (trie == NULL || trie->root == NULL || func == NULL)
+    if (trie == NULL)
         return;
+    // nodes themselves are released all at once with the arena, the tree
+    // is only walked if the elements must be free'd.
+    if (trie->sync != NULL)
+        sb_trie_sync_reclaim(trie);
+    if (trie->free_func != NULL)
+        sb_trie_free_node_data(trie, trie->root);
+    sb_trie_arena_free(&trie->arena);
+    if (trie->sync != NULL) {
+        free(trie->sync->fresh);
+        free(trie->sync->retired);
+        free(trie->sync);
+    }
+    if (trie->filter != NULL) {
+        free(trie->filter->bits);
+        free(trie->filter);
+    }
+    free(trie);
+}
+
+
+static uint64_t*
+sb_trie_filter_block(sb_trie_filter_t *filter, uint64_t hash)
+{
+    size_t num_blocks = filter->num_bits / SB_TRIE_FILTER_BLOCK_BITS;
+    return filter->bits + ((hash >> 32) & (num_blocks - 1)) *
+        (SB_TRIE_FILTER_BLOCK_BITS / 64);
+}
+
+
+static void
+sb_trie_filter_add(sb_trie_filter_t *filter, const char *key, size_t key_len)
+{
+    uint64_t hash = sb_hash(key, key_len);
+    uint64_t *block = sb_trie_filter_block(filter, hash);
+    uint32_t h = hash;
+    uint32_t delta = (hash >> 9) | 1;
+    for (unsigned int i = 0; i < filter->num_hashes; i++, h += delta) {
+        uint32_t bit = h % SB_TRIE_FILTER_BLOCK_BITS;
+        block[bit / 64] |= ((uint64_t) 1) << (bit % 64);
+    }
+    filter->num_keys++;
+}
+
+
+static bool
+sb_trie_filter_contains(sb_trie_filter_t *filter, const char *key,
+    size_t key_len)
+{
+    uint64_t hash = sb_hash(key, key_len);
+    uint64_t *block = sb_trie_filter_block(filter, hash);
+    uint32_t h = hash;
+    uint32_t delta = (hash >> 9) | 1;
+    for (unsigned int i = 0; i < filter->num_hashes; i++, h += delta) {
+        uint32_t bit = h % SB_TRIE_FILTER_BLOCK_BITS;
+        if ((block[bit / 64] & (((uint64_t) 1) << (bit % 64))) == 0)
+            return false;
+    }
+    return true;
+}
+
+
+static void
+sb_trie_filter_rebuild_add(const char *key, size_t key_len, void *data,
+    void *user_data)
+{
+    (void) data;
+    sb_trie_filter_add(user_data, key, key_len);
+}
+
+
+static void
+sb_trie_filter_rebuild(sb_trie_t *trie)
+{
+    sb_trie_filter_t *filter = trie->filter;
+
+    // the optimal number of bits per key is the number of hashes divided
+    // by ln(2).
+    filter->capacity = 2 * trie->size;
+    if (filter->capacity < SB_TRIE_FILTER_MIN_CAPACITY)
+        filter->capacity = SB_TRIE_FILTER_MIN_CAPACITY;
+    size_t bits = filter->capacity * filter->num_hashes * 1.4427;
+    size_t num_bits = SB_TRIE_FILTER_BLOCK_BITS;
+    while (num_bits < bits)
+        num_bits <<= 1;
+
+    if (num_bits != filter->num_bits) {
+        free(filter->bits);
+        filter->bits = sb_malloc(num_bits / 8);
+        filter->num_bits = num_bits;
+    }
+    memset(filter->bits, 0, num_bits / 8);
+    filter->num_keys = 0;
+    filter->stale = 0;
+    sb_trie_foreach_len(trie, sb_trie_filter_rebuild_add, filter);
+}
+
+
+static void
+sb_trie_filter_insert(sb_trie_t *trie, const char *key, size_t key_len)
+{
+    // called after the key was added to the trie, so a rebuild includes it.
+    if (trie->filter == NULL)
+        return;
+    if (trie->filter->num_keys >= trie->filter->capacity)
+        sb_trie_filter_rebuild(trie);
+    else
+        sb_trie_filter_add(trie->filter, key, key_len);
+}
+
+
+bool
+sb_trie_enable_filter(sb_trie_t *trie, double fp_rate)
+{
+    // filters are not updated atomically, and couldn't be shared by the
+    // readers of concurrent tries.
+    if (trie == NULL || trie->sync != NULL || !(fp_rate > 0 && fp_rate < 1))
+        return false;
+
+    if (trie->filter == NULL) {
+        trie->filter = sb_malloc(sizeof(sb_trie_filter_t));
+        memset(trie->filter, 0, sizeof(sb_trie_filter_t));
+    }
+
+    // the optimal number of hashes is log2(1 / fp_rate).
+    unsigned int num_hashes = 0;
+    for (double p = 1; p > fp_rate && num_hashes < SB_TRIE_FILTER_MAX_HASHES;
+            p /= 2)
+        num_hashes++;
+    trie->filter->num_hashes = num_hashes;
+
+    sb_trie_filter_rebuild(trie);
+    return true;
+}
+
+
+void
+sb_trie_disable_filter(sb_trie_t *trie)
+{
+    if (trie == NULL || trie->filter == NULL)
+        return;
+    free(trie->filter->bits);
+    free(trie->filter);
+    trie->filter = NULL;
+}
+
+
+void
+sb_trie_filter_stats(sb_trie_t *trie, size_t *filtered, size_t *walked)
+{
+    bool enabled = trie != NULL && trie->filter != NULL;
+    if (filtered != NULL)
+        *filtered = enabled ?
+            sb_trie_atomic_load_relaxed(&trie->filter->filtered) : 0;
+    if (walked != NULL)
+        *walked = enabled ?
+            sb_trie_atomic_load_relaxed(&trie->filter->walked) : 0;
+}
+
+
+static sb_trie_node_t*
+sb_trie_insert_path(sb_trie_t *trie, sb_trie_node_t **root, const uint8_t *k,
+    size_t len)
+{
+    // creates the nodes needed to store the key, if any, and returns the node
+    // where the key ends, without marking it as terminal. nodes are made
+    // writable (see sb_trie_node_cow()) before being changed.
+    if (*root == NULL)
+        *root = sb_trie_node_new(trie, SB_TRIE_NODE_LEAF, NULL, 0);
+
+    sb_trie_node_t **ref = root;
+    sb_trie_node_cow(trie, ref);
+
+    while (len > 0) {
+        sb_trie_node_t **child = sb_trie_node_find_child(*ref, *k);
+
+        if (child == NULL) {
+            // no edge starting with this byte, the remaining of the key
+            // becomes a single leaf.
+            size_t l = len > SB_TRIE_NODE_MAX_KEY_LEN ?
+                SB_TRIE_NODE_MAX_KEY_LEN : len;
+            ref = sb_trie_node_add_child(trie, ref, *k,
+                sb_trie_node_new(trie, SB_TRIE_NODE_LEAF, k, l));
+            k += l;
+            len -= l;
+            continue;
+        }
+
+        sb_trie_node_t *current = *child;
+        uint8_t *current_key = sb_trie_node_key(current);
+
+        size_t i = 1;
+        while (i < current->key_len && i < len && current_key[i] == k[i])
+            i++;
+
+        if (i < current->key_len) {
+            // key diverges (or ends) in the middle of the edge. split it,
+            // keeping the common prefix in a new intermediate node, that
+            // takes the place of the current node in the parent. the node
+            // is replaced by a copy with the remaining of the edge, as its
+            // size can't change in place, and it may be visible to readers.
+            size_t size = sb_trie_node_size(current->type);
+            size_t key_len = current->key_len - i;
+            sb_trie_node_t *rest = sb_trie_node_new(trie, current->type,
+                current_key + i, key_len);
+            memcpy(rest, current, size);
+            rest->key_len = key_len;
+            sb_trie_node_t *tmp = sb_trie_node_new(trie, SB_TRIE_NODE_4,
+                current_key, i);
+            sb_trie_node_add_child(trie, &tmp, current_key[i], rest);
+            sb_trie_node_release(trie, current);
+            *child = tmp;
+        }
+        else {
+            sb_trie_node_cow(trie, child);
+        }
+
+        ref = child;
+        k += i;
+        len -= i;
+    }
+
+    return *ref;
+}
+
+
+void
+sb_trie_insert(sb_trie_t *trie, const char *key, void *data)
+{
+    if (key == NULL)
+        return;
+    sb_trie_insert_len(trie, key, strlen(key), data);
+}
+
+
+void
+sb_trie_insert_len(sb_trie_t *trie, const char *key, size_t key_len,
+    void *data)
+{
+    if (trie == NULL || key == NULL || data == NULL)
+        return;
+
+    // the trie is changed through a local root, that is published when done.
+    sb_trie_node_t *root = trie->root;
+    sb_trie_node_t *node = sb_trie_insert_path(trie, &root,
+        (const uint8_t*) key, key_len);
+
+    size_t size = trie->size;
+    if ((node->flags & SB_TRIE_NODE_TERMINAL) == 0)
+        size++;
+    else if (node->data != NULL)
+        sb_trie_data_free(trie, node->data);
+    bool created = (node->flags & SB_TRIE_NODE_TERMINAL) == 0;
+    node->flags |= SB_TRIE_NODE_TERMINAL;
+    node->data = data;
+
+    sb_trie_commit(trie, root, size);
+
+    if (created)
+        sb_trie_filter_insert(trie, key, key_len);
+}
+
+
+void**
+sb_trie_get_slot(sb_trie_t *trie, const char *key, bool *created)
+{
+    if (key == NULL) {
+        if (created != NULL)
+            *created = false;
+        return NULL;
+    }
+    return sb_trie_get_slot_len(trie, key, strlen(key), created);
+}
+
+
+void**
+sb_trie_get_slot_len(sb_trie_t *trie, const char *key, size_t key_len,
+    bool *created)
+{
+    if (created != NULL)
+        *created = false;
+
+    // slots of concurrent tries can't be changed in place, because readers
+    // could see them at any time.
+    if (trie == NULL || key == NULL || trie->sync != NULL)
+        return NULL;
+
+    sb_trie_node_t *node = sb_trie_insert_path(trie, &trie->root,
+        (const uint8_t*) key, key_len);
+
+    if ((node->flags & SB_TRIE_NODE_TERMINAL) == 0) {
+        node->flags |= SB_TRIE_NODE_TERMINAL;
+        node->data = NULL;
+        trie->size++;
+        sb_trie_filter_insert(trie, key, key_len);
+        if (created != NULL)
+            *created = true;
+    }
+    return &node->data;
+}
+
+
+/*
+ * Tries are built from sorted keys with a single pass, keeping a stack of
+ * frames for the nodes along the path of the last key. When the next key
+ * diverges from it, the frames deeper than the divergence point are popped,
+ * and their nodes are created, with all their children known. Nodes are
+ * created with their final layout, in post-order.
+ */
+
+typedef struct {
+    size_t end;
+    size_t lo;
+    void *data;
+    size_t children;
+} sb_trie_build_frame_t;
+
+typedef struct {
+    sb_trie_node_t *node;
+    uint8_t c;
+} sb_trie_build_child_t;
+
+
+static sb_trie_node_t*
+sb_trie_build_node(sb_trie_t *trie, const uint8_t *key, size_t start,
+    size_t end, void *data, sb_trie_build_child_t *children,
+    size_t num_children)
+{
+    uint8_t type = SB_TRIE_NODE_LEAF;
+    if (num_children > 48)
+        type = SB_TRIE_NODE_256;
+    else if (num_children > 16)
+        type = SB_TRIE_NODE_48;
+    else if (num_children > 4)
+        type = SB_TRIE_NODE_16;
+    else if (num_children > 0)
+        type = SB_TRIE_NODE_4;
+
+    size_t key_len = end - start;
+    if (key_len > SB_TRIE_NODE_MAX_KEY_LEN)
+        key_len = SB_TRIE_NODE_MAX_KEY_LEN;
+
+    sb_trie_node_t *node = sb_trie_node_new(trie, type, key + end - key_len,
+        key_len);
+    node->num_children = num_children;
+    node->data = data;
+    if (data != NULL)
+        node->flags |= SB_TRIE_NODE_TERMINAL;
+
+    for (size_t i = 0; i < num_children; i++) {
+        uint8_t c = children[i].c;
+        switch (type) {
+            case SB_TRIE_NODE_4:
+                ((sb_trie_node4_t*) node)->keys[i] = c;
+                ((sb_trie_node4_t*) node)->children[i] = children[i].node;
+                break;
+            case SB_TRIE_NODE_16:
+                ((sb_trie_node16_t*) node)->keys[i] = c;
+                ((sb_trie_node16_t*) node)->children[i] = children[i].node;
+                break;
+            case SB_TRIE_NODE_48:
+                ((sb_trie_node48_t*) node)->index[c] = i + 1;
+                ((sb_trie_node48_t*) node)->children[i] = children[i].node;
+                break;
+            case SB_TRIE_NODE_256:
+                ((sb_trie_node256_t*) node)->children[c] = children[i].node;
+                break;
+        }
+    }
+
+    // edges longer than a node can store are split into a chain of nodes.
+    for (end -= key_len; end > start; end -= key_len) {
+        key_len = end - start;
+        if (key_len > SB_TRIE_NODE_MAX_KEY_LEN)
+            key_len = SB_TRIE_NODE_MAX_KEY_LEN;
+        sb_trie_node4_t *parent = (sb_trie_node4_t*) sb_trie_node_new(trie,
+            SB_TRIE_NODE_4, key + end - key_len, key_len);
+        parent->base.num_children = 1;
+        parent->keys[0] = key[end];
+        parent->children[0] = node;
+        node = (sb_trie_node_t*) parent;
+    }
+
+    return node;
+}
+
+
+static sb_trie_t*
+sb_trie_build(const char *const *keys, const size_t *key_lens, void **values,
+    size_t n, sb_free_func_t free_func)
+{
+    // key_lens is NULL for nul-terminated keys.
+    if (n == 0)
+        return sb_trie_new(free_func);
+
+    if (keys == NULL || values == NULL)
+        return NULL;
+
+    // a first pass over the keys validates them, and computes their lengths,
+    // and the length of the common prefix of each key and the previous one.
+    size_t *lens = sb_malloc(2 * n * sizeof(size_t));
+    size_t *lcps = lens + n;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *key = (const uint8_t*) keys[i];
+        if (key == NULL || values[i] == NULL) {
+            free(lens);
+            return NULL;
+        }
+        size_t l = 0;
+        if (i > 0) {
+            const uint8_t *prev = (const uint8_t*) keys[i - 1];
+            size_t max = lens[i - 1];
+            if (key_lens != NULL && key_lens[i] < max)
+                max = key_lens[i];
+            while (l < max && prev[l] == key[l])
+                l++;
+
+            // keys are out of order if they differ by a smaller byte, or
+            // if the key is a prefix of the previous one. nul-terminated
+            // keys end with a smaller byte.
+            if (l < lens[i - 1] && (l == max || prev[l] > key[l])) {
+                free(lens);
+                return NULL;
+            }
+        }
+        lcps[i] = l;
+        lens[i] = key_lens != NULL ? key_lens[i] :
+            l + strlen((const char*) key + l);
+    }
+
+    sb_trie_t *trie = sb_trie_new(free_func);
+
+    size_t frames_allocated_len = 16;
+    sb_trie_build_frame_t *frames = sb_malloc(frames_allocated_len *
+        sizeof(sb_trie_build_frame_t));
+    size_t frames_len = 1;
+    frames[0].end = 0;
+    frames[0].lo = 0;
+    frames[0].data = NULL;
+    frames[0].children = 0;
+
+    size_t children_allocated_len = 16;
+    sb_trie_build_child_t *children = sb_malloc(children_allocated_len *
+        sizeof(sb_trie_build_child_t));
+    size_t children_len = 0;
+
+    // a last iteration, with an empty common prefix, creates all the nodes
+    // left in the stack, but the root.
+    for (size_t i = 0; i <= n; i++) {
+        size_t l = i < n ? lcps[i] : 0;
+
+        while (frames[frames_len - 1].end > l) {
+            sb_trie_build_frame_t f = frames[--frames_len];
+
+            // the previous key diverges from the current one in the middle
+            // of the edge of the node. a new node, that will be the parent
+            // of both, takes the common prefix.
+            if (frames[frames_len - 1].end < l) {
+                sb_trie_build_frame_t *p = &frames[frames_len++];
+                p->end = l;
+                p->lo = f.lo;
+                p->data = NULL;
+                p->children = f.children;
+            }
+
+            const uint8_t *key = (const uint8_t*) keys[f.lo];
+            size_t start = frames[frames_len - 1].end;
+            sb_trie_node_t *node = sb_trie_build_node(trie, key, start, f.end,
+                f.data, children + f.children, children_len - f.children);
+
+            // the node takes the place of its first child, or the room that
+            // was reserved for it when its frame was pushed.
+            children_len = f.children;
+            children[children_len].node = node;
+            children[children_len++].c = key[start];
+        }
+
+        if (i == n)
+            break;
+
+        // if a key is repeated, the last element wins.
+        if (lens[i] == l) {
+            sb_trie_build_frame_t *f = &frames[frames_len - 1];
+            if (f->data == NULL)
+                trie->size++;
+            else if (free_func != NULL)
+                free_func(f->data);
+            f->data = values[i];
+            continue;
+        }
+
+        if (frames_len == frames_allocated_len) {
+            frames_allocated_len *= 2;
+            frames = sb_realloc(frames, frames_allocated_len *
+                sizeof(sb_trie_build_frame_t));
+        }
+        if (children_len == children_allocated_len) {
+            children_allocated_len *= 2;
+            children = sb_realloc(children, children_allocated_len *
+                sizeof(sb_trie_build_child_t));
+        }
+
+        sb_trie_build_frame_t *f = &frames[frames_len++];
+        f->end = lens[i];
+        f->lo = i;
+        f->data = values[i];
+        f->children = children_len;
+        trie->size++;
+    }
+
+    trie->root = sb_trie_build_node(trie, (const uint8_t*) keys[0], 0, 0,
+        frames[0].data, children, children_len);
+
+    free(children);
+    free(frames);
+    free(lens);
+    return trie;
+}
+
+
+sb_trie_t*
+sb_trie_build_sorted(const char *const *keys, void **values, size_t n,
+    sb_free_func_t free_func)
+{
+    return sb_trie_build(keys, NULL, values, n, free_func);
+}
+
+
+sb_trie_t*
+sb_trie_build_sorted_len(const char *const *keys, const size_t *key_lens,
+    void **values, size_t n, sb_free_func_t free_func)
+{
+    if (n > 0 && key_lens == NULL)
+        return NULL;
+    return sb_trie_build(keys, key_lens, values, n, free_func);
+}
+
+
+static sb_trie_node_t*
+sb_trie_node_lookup(sb_trie_node_t *node, const uint8_t *k, size_t len)
+{
+    if (node == NULL)
+        return NULL;
+
+    while (len > 0) {
+        sb_trie_node_t **child = sb_trie_node_find_child(node, *k);
+        if (child == NULL)
+            return NULL;
+
+        node = *child;
+        if (node->key_len > len ||
+            0 != memcmp(sb_trie_node_key(node), k, node->key_len))
+            return NULL;
+
+        k += node->key_len;
+        len -= node->key_len;
+    }
+
+    return (node->flags & SB_TRIE_NODE_TERMINAL) != 0 ? node : NULL;
+}
+
+
+void*
+sb_trie_lookup(sb_trie_t *trie, const char *key)
+{
+    if (key == NULL)
+        return NULL;
+    return sb_trie_lookup_len(trie, key, strlen(key));
+}
+
+
+void*
+sb_trie_lookup_len(sb_trie_t *trie, const char *key, size_t key_len)
+{
+    if (trie == NULL || key == NULL)
+        return NULL;
+
+    // lookups may run concurrently on tries shared by readers under a lock,
+    // so the counters are updated atomically.
+    if (trie->filter != NULL) {
+        if (!sb_trie_filter_contains(trie->filter, key, key_len)) {
+            sb_trie_atomic_inc_relaxed(&trie->filter->filtered);
+            return NULL;
+        }
+        sb_trie_atomic_inc_relaxed(&trie->filter->walked);
+    }
+
+    unsigned int token = sb_trie_read_lock(trie);
+    sb_trie_node_t *node = sb_trie_node_lookup(sb_trie_get_root(trie),
+        (const uint8_t*) key, key_len);
+    void *rv = node == NULL ? NULL : node->data;
+    sb_trie_read_unlock(trie, token);
+    return rv;
+}
+
+
+bool
+sb_trie_remove(sb_trie_t *trie, const char *key)
+{
+    if (key == NULL)
+        return false;
+    return sb_trie_remove_len(trie, key, strlen(key));
+}
+
+
+bool
+sb_trie_remove_len(sb_trie_t *trie, const char *key, size_t key_len)
+{
+    if (trie == NULL || trie->root == NULL || key == NULL)
+        return false;
+
+    if (trie->filter != NULL &&
+        !sb_trie_filter_contains(trie->filter, key, key_len))
+        return false;
+
+    const uint8_t *k = (const uint8_t*) key;
+    size_t len = key_len;
+
+    // concurrent tries are only copied if the key exists.
+    if (trie->sync != NULL && sb_trie_node_lookup(trie->root, k, len) == NULL)
+        return false;
+    sb_trie_node_t *root = trie->root;
+    sb_trie_node_t **parent = NULL;
+    sb_trie_node_t **ref = &root;
+    sb_trie_node_cow(trie, ref);
+
+    while (len > 0) {
+        sb_trie_node_t **child = sb_trie_node_find_child(*ref, *k);
+        if (child == NULL)
+            return false;
+
+        sb_trie_node_t *node = *child;
+        if (node->key_len > len ||
+            0 != memcmp(sb_trie_node_key(node), k, node->key_len))
+            return false;
+
+        sb_trie_node_cow(trie, child);
+        parent = ref;
+        ref = child;
+        k += node->key_len;
+        len -= node->key_len;
+    }
+
+    sb_trie_node_t *node = *ref;
+    if ((node->flags & SB_TRIE_NODE_TERMINAL) == 0)
+        return false;
+
+    if (node->data != NULL)
+        sb_trie_data_free(trie, node->data);
+    node->data = NULL;
+    node->flags &= ~SB_TRIE_NODE_TERMINAL;
+
+    // prune the node if it is now empty, and collapse whatever node was left
+    // not terminal and with a single child, to keep the trie path-compressed.
+    if (node->num_children == 0 && parent != NULL) {
+        sb_trie_node_remove_child(trie, parent, sb_trie_node_key(node)[0]);
+        sb_trie_node_release(trie, node);
+        ref = parent;
+        node = *ref;
+    }
+
+    if (ref == &root) {
+        if ((node->flags & SB_TRIE_NODE_TERMINAL) == 0 &&
+            node->num_children == 0)
+        {
+            sb_trie_node_release(trie, node);
+            root = NULL;
+        }
+    }
+    else if ((node->flags & SB_TRIE_NODE_TERMINAL) == 0 &&
+        node->num_children == 1)
+    {
+        sb_trie_node_merge(trie, ref);
+    }
+
+    sb_trie_commit(trie, root, trie->size - 1);
+
+    if (trie->filter != NULL && ++trie->filter->stale >
+            trie->filter->num_keys / 2)
+        sb_trie_filter_rebuild(trie);
+    return true;
+}
+
+
+void*
+sb_trie_longest_prefix(sb_trie_t *trie, const char *key, size_t *matched_len)
+{
+    if (key == NULL) {
+        if (matched_len != NULL)
+            *matched_len = 0;
+        return NULL;
+    }
+    return sb_trie_longest_prefix_len(trie, key, strlen(key), matched_len);
+}
+
+
+void*
+sb_trie_longest_prefix_len(sb_trie_t *trie, const char *key, size_t key_len,
+    size_t *matched_len)
+{
+    if (matched_len != NULL)
+        *matched_len = 0;
+
+    if (trie == NULL || key == NULL)
+        return NULL;
+
+    unsigned int token = sb_trie_read_lock(trie);
+    sb_trie_node_t *node = sb_trie_get_root(trie);
+    if (node == NULL) {
+        sb_trie_read_unlock(trie, token);
+        return NULL;
+    }
+
+    const uint8_t *k = (const uint8_t*) key;
+    size_t len = key_len;
+    void *rv = node->data;
+    size_t consumed = 0;
+
+    while (len > 0) {
+        sb_trie_node_t **child = sb_trie_node_find_child(node, *k);
+        if (child == NULL)
+            break;
+
+        node = *child;
+        if (node->key_len > len ||
+            0 != memcmp(sb_trie_node_key(node), k, node->key_len))
+            break;
+
+        k += node->key_len;
+        len -= node->key_len;
+        consumed += node->key_len;
+
+        if ((node->flags & SB_TRIE_NODE_TERMINAL) != 0) {
+            rv = node->data;
+            if (matched_len != NULL)
+                *matched_len = consumed;
+        }
+    }
+
+    sb_trie_read_unlock(trie, token);
+    return rv;
+}
+
+
+size_t
+sb_trie_size(sb_trie_t *trie)
+{
+    if (trie == NULL)
+        return 0;
+    if (trie->sync != NULL)
+        return sb_trie_atomic_load(&trie->size);
+    return trie->size;
+}
+
+
+void
+sb_trie_memory_usage(sb_trie_t *trie, size_t *nodes, size_t *bytes)
+{
+    if (nodes != NULL)
+        *nodes = trie == NULL ? 0 : trie->num_nodes;
+    if (bytes != NULL)
+        *bytes = trie == NULL ? 0 : sizeof(sb_trie_t) +
+            trie->arena.allocated_len + (trie->filter == NULL ? 0 :
+            sizeof(sb_trie_filter_t) + trie->filter->num_bits / 8);
+}
+
+
+static void
+sb_trie_foreach_node(sb_trie_node_t *node, sb_string_t *key,
+    sb_trie_foreach_len_func_t func, void *user_data)
+{
+    // key must contain the full key of the node when called.
+    //
+    // a single buffer is used for all the keys. each frame remembers the
+    // length of the key of its node, and the buffer is truncated back to it
+    // before appending the edge of the next child.
+    if ((node->flags & SB_TRIE_NODE_TERMINAL) != 0)
+        func(key->str, key->len, node->data, user_data);
+
+    sb_trie_stack_t stack = {NULL, 0, 0};
+    sb_trie_stack_push(&stack, node)->key_len = key->len;
+
+    while (stack.len > 0) {
+        sb_trie_frame_t *frame = &stack.frames[stack.len - 1];
+        sb_trie_node_t *child = sb_trie_node_next_child(frame->node,
+            &frame->pos);
+        if (child == NULL) {
+            stack.len--;
+            continue;
+        }
+
+        key->len = frame->key_len;
+        key = sb_string_append_len(key, (char*) sb_trie_node_key(child),
+            child->key_len);
+
+        if ((child->flags & SB_TRIE_NODE_TERMINAL) != 0)
+            func(key->str, key->len, child->data, user_data);
+
+        if (child->type != SB_TRIE_NODE_LEAF)
+            sb_trie_stack_push(&stack, child)->key_len = key->len;
+    }
+
+    free(stack.frames);
+}
+
+
+typedef struct {
+    sb_trie_foreach_func_t func;
+    void *user_data;
+} sb_trie_foreach_ctx_t;
+
+
+static void
+sb_trie_foreach_wrapper(const char *key, size_t key_len, void *data,
+    void *user_data)
+{
+    (void) key_len;
+    sb_trie_foreach_ctx_t *ctx = user_data;
+    ctx->func(key, data, ctx->user_data);
+}
+
+
+void
+sb_trie_foreach(sb_trie_t *trie, sb_trie_foreach_func_t func,
+    void *user_data)
+{
+    if (func == NULL)
+        return;
+    sb_trie_foreach_ctx_t ctx = {func, user_data};
+    sb_trie_foreach_len(trie, sb_trie_foreach_wrapper, &ctx);
+}
+
+
+void
+sb_trie_foreach_len(sb_trie_t *trie, sb_trie_foreach_len_func_t func,
+    void *user_data)
+{
+    if (trie == NULL || func == NULL)
+        return;
+
+    unsigned int token = sb_trie_read_lock(trie);
+    sb_trie_node_t *root = sb_trie_get_root(trie);
+    if (root != NULL) {
+        sb_string_t *key = sb_string_new();
+        sb_trie_foreach_node(root, key, func, user_data);
+        sb_string_free(key, true);
+    }
+    sb_trie_read_unlock(trie, token);
+}
+
+
+void
+sb_trie_foreach_prefix(sb_trie_t *trie, const char *prefix,
+    sb_trie_foreach_func_t func, void *user_data)
+{
+    if (prefix == NULL || func == NULL)
+        return;
+    sb_trie_foreach_ctx_t ctx = {func, user_data};
+    sb_trie_foreach_prefix_len(trie, prefix, strlen(prefix),
+        sb_trie_foreach_wrapper, &ctx);
+}
+
+
+void
+sb_trie_foreach_prefix_len(sb_trie_t *trie, const char *prefix,
+    size_t prefix_len, sb_trie_foreach_len_func_t func, void *user_data)
+{
+    if (trie == NULL || prefix == NULL || func == NULL)
+        return;
+
+    unsigned int token = sb_trie_read_lock(trie);
+    sb_trie_node_t *node = sb_trie_get_root(trie);
+    if (node == NULL) {
+        sb_trie_read_unlock(trie, token);
+        return;
+    }
+
+    const uint8_t *k = (const uint8_t*) prefix;
+    size_t len = prefix_len;
+    sb_string_t *key = sb_string_new();
+
+    // the prefix may end in the middle of an edge. in this case, the whole
+    // subtree of the node that owns the edge matches the prefix.
+    while (len > 0) {
+        sb_trie_node_t **child = sb_trie_node_find_child(node, *k);
+        if (child == NULL)
+            goto clean;
+
+        node = *child;
+        size_t l = node->key_len < len ? node->key_len : len;
+        if (0 != memcmp(sb_trie_node_key(node), k, l))
+            goto clean;
+
+        key = sb_string_append_len(key, (char*) sb_trie_node_key(node),
+            node->key_len);
+        k += l;
+        len -= l;
+    }
+
+    sb_trie_foreach_node(node, key, func, user_data);
+
+clean:
+    sb_string_free(key, true);
+    sb_trie_read_unlock(trie, token);
+}
+
+
+void
+sb_trie_iter_init(sb_trie_iter_t *iter, sb_trie_t *trie)
+{
+    if (iter == NULL)
+        return;
+    iter->trie = trie;
+    iter->key = sb_string_new();
+    iter->node = NULL;
+    iter->frames = NULL;
+    iter->len = 0;
+    iter->allocated_len = 0;
+    sb_trie_iter_seek_len(iter, "", 0);
+}
+
+
+void
+sb_trie_iter_seek(sb_trie_iter_t *iter, const char *key)
+{
+    if (key == NULL)
+        return;
+    sb_trie_iter_seek_len(iter, key, strlen(key));
+}
+
+
+void
+sb_trie_iter_seek_len(sb_trie_iter_t *iter, const char *key, size_t key_len)
+{
+    if (iter == NULL || iter->key == NULL || key == NULL)
+        return;
+
+    // the iterator keeps the stack of a walk like the one of
+    // sb_trie_foreach_node(), paused right after the last element returned.
+    // seeking builds the stack of the path of the key, with the position of
+    // each frame set to the first child that is not lower than the key.
+    sb_trie_stack_t stack = {iter->frames, 0, iter->allocated_len};
+    sb_string_t *str = iter->key;
+    str->len = 0;
+    str->str[0] = '\0';
+    iter->node = NULL;
+
+    sb_trie_node_t *node = iter->trie == NULL ? NULL :
+        sb_trie_get_root(iter->trie);
+    if (node == NULL)
+        goto clean;
+
+    sb_trie_stack_push(&stack, node);
+
+    const uint8_t *k = (const uint8_t*) key;
+    size_t len = key_len;
+
+    while (len > 0) {
+        sb_trie_frame_t *frame = &stack.frames[stack.len - 1];
+        frame->pos = sb_trie_node_child_pos(frame->node, *k);
+
+        sb_trie_node_t **child = sb_trie_node_find_child(frame->node, *k);
+        if (child == NULL)
+            goto clean;
+
+        node = *child;
+        size_t l = node->key_len < len ? node->key_len : len;
+        int cmp = memcmp(sb_trie_node_key(node), k, l);
+
+        // the subtree of the child is greater than the key if the key ends
+        // in the middle of its edge, and it is lower if the edge is lower.
+        if (cmp > 0 || (cmp == 0 && node->key_len > len))
+            goto clean;
+        sb_trie_node_next_child(frame->node, &frame->pos);
+        if (cmp < 0)
+            goto clean;
+
+        str = sb_string_append_len(str, (char*) sb_trie_node_key(node),
+            node->key_len);
+        sb_trie_stack_push(&stack, node)->key_len = str->len;
+        k += node->key_len;
+        len -= node->key_len;
+    }
+
+    // the key itself exists.
+    if ((node->flags & SB_TRIE_NODE_TERMINAL) != 0)
+        iter->node = node;
+
+clean:
+    iter->key = str;
+    iter->frames = stack.frames;
+    iter->len = stack.len;
+    iter->allocated_len = stack.allocated_len;
+}
+
+
+bool
+sb_trie_iter_next(sb_trie_iter_t *iter, const char **key, size_t *key_len,
+    void **data)
+{
+    if (iter == NULL || iter->key == NULL)
+        return false;
+
+    sb_trie_node_t *node = iter->node;
+    iter->node = NULL;
+
+    sb_trie_stack_t stack = {iter->frames, iter->len, iter->allocated_len};
+    while (node == NULL && stack.len > 0) {
+        sb_trie_frame_t *frame = &stack.frames[stack.len - 1];
+        sb_trie_node_t *child = sb_trie_node_next_child(frame->node,
+            &frame->pos);
+        if (child == NULL) {
+            stack.len--;
+            continue;
+        }
+
+        iter->key->len = frame->key_len;
+        iter->key = sb_string_append_len(iter->key,
+            (char*) sb_trie_node_key(child), child->key_len);
+
+        if (child->type != SB_TRIE_NODE_LEAF)
+            sb_trie_stack_push(&stack, child)->key_len = iter->key->len;
+
+        if ((child->flags & SB_TRIE_NODE_TERMINAL) != 0)
+            node = child;
+    }
+    iter->frames = stack.frames;
+    iter->len = stack.len;
+    iter->allocated_len = stack.allocated_len;
+
+    if (node == NULL)
+        return false;
+
+    if (key != NULL)
+        *key = iter->key->str;
+    if (key_len != NULL)
+        *key_len = iter->key->len;
+    if (data != NULL)
+        *data = node->data;
+    return true;
+}
+
+
+void
+sb_trie_iter_clear(sb_trie_iter_t *iter)
+{
+    if (iter == NULL)
+        return;
+    sb_string_free(iter->key, true);
+    free(iter->frames);
+    iter->key = NULL;
+    iter->node = NULL;
+    iter->frames = NULL;
+    iter->len = 0;
+    iter->allocated_len = 0;
+}
+
+
+static const void*
+sb_trie_serialize(void *data, size_t *len, sb_trie_serialize_func_t func,
+    void *user_data)
+{
+    *len = 0;
+    if (data == NULL)
+        return NULL;
+    if (func == NULL) {
+        *len = strlen(data);
+        return data;
+    }
+    const void *rv = func(data, len, user_data);
+    if (rv == NULL)
+        *len = 0;
+    return rv;
+}
+
+
+static size_t
+sb_trie_freeze_value(uint8_t *buf, size_t offset, const void *value,
+    size_t len)
+{
+    uint64_t l = len;
+    memcpy(buf + offset, &l, sizeof(uint64_t));
+    if (len > 0)
+        memcpy(buf + offset + sizeof(uint64_t), value, len);
+    // the NUL byte and the padding are zeroed already.
+    return SB_TRIE_IMAGE_ALIGN(sizeof(uint64_t) + len + 1);
+}
+
+
+static size_t
+sb_trie_freeze_node(uint8_t *buf, size_t offset, sb_trie_node_t *node,
+    uint64_t value)
+{
+    sb_trie_image_node_t *n = (sb_trie_image_node_t*) (buf + offset);
+    n->key_len = node->key_len;
+    n->num_children = node->num_children;
+    n->value = value;
+
+    // children offsets are filled when the children are written.
+    uint8_t *child_keys = (uint8_t*) sb_trie_image_node_child_keys(n);
+    size_t pos = 0;
+    sb_trie_node_t *child;
+    while (NULL != (child = sb_trie_node_next_child(node, &pos)))
+        *child_keys++ = sb_trie_node_key(child)[0];
+
+    memcpy(child_keys, sb_trie_node_key(node), node->key_len);
+    return sb_trie_image_node_size(node->key_len, node->num_children);
+}
+
+
+char*
+sb_trie_freeze(sb_trie_t *trie, sb_trie_serialize_func_t func,
+    void *user_data, size_t *len)
+{
+    if (trie == NULL || len == NULL)
+        return NULL;
+
+    // first pass: compute the size of the image, so it is allocated at once.
+    // nodes are visited in pre-order in both passes.
+    unsigned int token = sb_trie_read_lock(trie);
+    sb_trie_node_t *root = sb_trie_get_root(trie);
+    size_t nodes_len = 0;
+    size_t values_len = 0;
+    size_t value_len;
+    sb_trie_stack_t stack = {NULL, 0, 0};
+    if (root != NULL)
+        sb_trie_stack_push(&stack, root);
+
+    for (sb_trie_node_t *node = root; node != NULL;) {
+        nodes_len += sb_trie_image_node_size(node->key_len,
+            node->num_children);
+        if ((node->flags & SB_TRIE_NODE_TERMINAL) != 0) {
+            sb_trie_serialize(node->data, &value_len, func, user_data);
+            values_len += SB_TRIE_IMAGE_ALIGN(sizeof(uint64_t) + value_len + 1);
+        }
+
+        node = NULL;
+        while (node == NULL && stack.len > 0) {
+            sb_trie_frame_t *frame = &stack.frames[stack.len - 1];
+            node = sb_trie_node_next_child(frame->node, &frame->pos);
+            if (node == NULL)
+                stack.len--;
+            else if (node->type != SB_TRIE_NODE_LEAF)
+                sb_trie_stack_push(&stack, node);
+        }
+    }
+
+    *len = sizeof(sb_trie_image_header_t) + nodes_len + values_len;
+    uint8_t *buf = sb_malloc(*len);
+    memset(buf, 0, *len);
+
+    sb_trie_image_header_t *header = (sb_trie_image_header_t*) buf;
+    memcpy(header->magic, SB_TRIE_IMAGE_MAGIC, sizeof(header->magic));
+    header->version = SB_TRIE_IMAGE_VERSION;
+    header->byte_order = SB_TRIE_IMAGE_BYTE_ORDER;
+    header->size = *len;
+    header->num_keys = sb_trie_size(trie);
+    header->root = root == NULL ? 0 : sizeof(sb_trie_image_header_t);
+
+    // second pass: write the nodes, and the offset of each node to the
+    // children offsets of its parent. the parent is always the top of the
+    // stack, and the children are visited in the order of their keys.
+    size_t node_offset = sizeof(sb_trie_image_header_t);
+    size_t value_offset = node_offset + nodes_len;
+    stack.len = 0;
+    if (root != NULL)
+        sb_trie_stack_push(&stack, root)->offset = node_offset;
+
+    for (sb_trie_node_t *node = root; node != NULL;) {
+        uint64_t value = 0;
+        if ((node->flags & SB_TRIE_NODE_TERMINAL) != 0) {
+            const void *v = sb_trie_serialize(node->data, &value_len, func,
+                user_data);
+            value = value_offset;
+            value_offset += sb_trie_freeze_value(buf, value_offset, v,
+                value_len);
+        }
+        size_t offset = node_offset;
+        node_offset += sb_trie_freeze_node(buf, offset, node, value);
+
+        node = NULL;
+        while (node == NULL && stack.len > 0) {
+            sb_trie_frame_t *frame = &stack.frames[stack.len - 1];
+            size_t idx = frame->pos;
+            node = sb_trie_node_next_child(frame->node, &frame->pos);
+            if (node == NULL) {
+                stack.len--;
+                continue;
+            }
+
+            // for node48 and node256, pos is a byte, not a position.
+            if (frame->node->type == SB_TRIE_NODE_48 ||
+                frame->node->type == SB_TRIE_NODE_256)
+            {
+                const sb_trie_image_node_t *parent =
+                    (sb_trie_image_node_t*) (buf + frame->offset);
+                const uint8_t *child_keys =
+                    sb_trie_image_node_child_keys(parent);
+                uint8_t c = sb_trie_node_key(node)[0];
+                for (idx = 0; child_keys[idx] != c; idx++);
+            }
+            uint64_t child_offset = node_offset;
+            memcpy(buf + frame->offset + sizeof(sb_trie_image_node_t) +
+                idx * sizeof(uint64_t), &child_offset, sizeof(uint64_t));
+
+            if (node->type != SB_TRIE_NODE_LEAF)
+                sb_trie_stack_push(&stack, node)->offset = node_offset;
+        }
+    }
+
+    free(stack.frames);
+    sb_trie_read_unlock(trie, token);
+    return (char*) buf;
+}
+
+
+static sb_error_t*
+sb_trie_image_validate(const uint8_t *buf, size_t len)
+{
+    if (len < sizeof(sb_trie_image_header_t))
+        return sb_strerror_new("trie: Invalid image: Truncated header");
+
+    const sb_trie_image_header_t *header = (sb_trie_image_header_t*) buf;
+    if (0 != memcmp(header->magic, SB_TRIE_IMAGE_MAGIC, sizeof(header->magic)))
+        return sb_strerror_new("trie: Invalid image: Bad magic");
+    if (header->version != SB_TRIE_IMAGE_VERSION)
+        return sb_strerror_new_printf(
+            "trie: Invalid image: Unsupported version (%u)", header->version);
+    if (header->byte_order != SB_TRIE_IMAGE_BYTE_ORDER)
+        return sb_strerror_new("trie: Invalid image: Wrong byte order");
+    if (header->size != len)
+        return sb_strerror_new("trie: Invalid image: Wrong size");
+
+    // nodes and values are validated when visited, because images can be
+    // big, and should be usable without being read in full.
+    return NULL;
+}
+
+
+static const sb_trie_image_node_t*
+sb_trie_image_get_node(sb_trie_image_t *image, uint64_t offset)
+{
+    if (offset < sizeof(sb_trie_image_header_t) || offset % 8 != 0 ||
+        offset > image->len - sizeof(sb_trie_image_node_t))
+        return NULL;
+    const sb_trie_image_node_t *node =
+        (sb_trie_image_node_t*) (image->buf + offset);
+    if (sb_trie_image_node_size(node->key_len, node->num_children) >
+        image->len - offset)
+        return NULL;
+    return node;
+}
+
+
+static const sb_trie_image_node_t*
+sb_trie_image_get_child(sb_trie_image_t *image,
+    const sb_trie_image_node_t *node, size_t idx)
+{
+    // children are always written after their parents, and have non-empty
+    // edges. this guarantees that walks on corrupted images terminate.
+    uint64_t offset = sb_trie_image_node_children(node)[idx];
+    if (offset <= (uint64_t) ((const uint8_t*) node - image->buf))
+        return NULL;
+    const sb_trie_image_node_t *child = sb_trie_image_get_node(image, offset);
+    if (child == NULL || child->key_len == 0)
+        return NULL;
+    return child;
+}
+
+
+static const void*
+sb_trie_image_get_value(sb_trie_image_t *image, uint64_t offset, size_t *len)
+{
+    if (offset < sizeof(sb_trie_image_header_t) || offset % 8 != 0 ||
+        offset > image->len - sizeof(uint64_t))
+        return NULL;
+    uint64_t l = *(uint64_t*) (image->buf + offset);
+    if (l >= image->len - offset - sizeof(uint64_t))
+        return NULL;
+    if (len != NULL)
+        *len = l;
+    return image->buf + offset + sizeof(uint64_t);
+}
+
+
+sb_trie_image_t*
+sb_trie_image_new(const void *buf, size_t len, sb_error_t **err)
+{
+    if (buf == NULL)
+        return NULL;
+
+    if (err != NULL && *err != NULL)
+        return NULL;
+
+    sb_error_t *tmp_err = sb_trie_image_validate(buf, len);
+    if (tmp_err != NULL) {
+        if (err != NULL)
+            *err = tmp_err;
+        else
+            sb_error_free(tmp_err);
+        return NULL;
+    }
+
+    sb_trie_image_t *image = sb_malloc(sizeof(sb_trie_image_t));
+    image->buf = buf;
+    image->len = len;
+    image->mapped = NULL;
+    image->owned = NULL;
+    return image;
+}
+
+
+sb_trie_image_t*
+sb_trie_image_open(const char *path, sb_error_t **err)
+{
+    if (path == NULL)
+        return NULL;
+
+    if (err != NULL && *err != NULL)
+        return NULL;
+
+#ifdef SB_TRIE_USE_MMAP
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (err != NULL)
+            *err = sb_strerror_new_printf(
+                "trie: Failed to open image (%s): %s", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if (0 != fstat(fd, &st)) {
+        if (err != NULL)
+            *err = sb_strerror_new_printf(
+                "trie: Failed to stat image (%s): %s", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    size_t len = st.st_size;
+    if (len < sizeof(sb_trie_image_header_t)) {
+        if (err != NULL)
+            *err = sb_strerror_new(
+                "trie: Invalid image: Truncated header");
+        close(fd);
+        return NULL;
+    }
+
+    void *buf = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    int tmp_errno = errno;
+    close(fd);
+    if (buf == MAP_FAILED) {
+        if (err != NULL)
+            *err = sb_strerror_new_printf(
+                "trie: Failed to map image (%s): %s", path,
+                strerror(tmp_errno));
+        return NULL;
+    }
+
+    sb_trie_image_t *image = sb_trie_image_new(buf, len, err);
+    if (image == NULL) {
+        munmap(buf, len);
+        return NULL;
+    }
+    image->mapped = buf;
+
+#else
+
+    size_t len;
+    char *buf = sb_file_get_contents(path, &len, err);
+    if (buf == NULL)
+        return NULL;
+
+    sb_trie_image_t *image = sb_trie_image_new(buf, len, err);
+    if (image == NULL) {
+        free(buf);
+        return NULL;
+    }
+    image->owned = buf;
+
+#endif
+
+    return image;
+}
+
+
+void
+sb_trie_image_free(sb_trie_image_t *image)
+{
+    if (image == NULL)
+        return;
+#ifdef SB_TRIE_USE_MMAP
+    if (image->mapped != NULL)
+        munmap(image->mapped, image->len);
+#endif
+    free(image->owned);
+    free(image);
+}
+
+
+const void*
+sb_trie_image_lookup(sb_trie_image_t *image, const char *key, size_t *len)
+{
+    if (key == NULL) {
+        if (len != NULL)
+            *len = 0;
+        return NULL;
+    }
+    return sb_trie_image_lookup_len(image, key, strlen(key), len);
+}
+
+
+const void*
+sb_trie_image_lookup_len(sb_trie_image_t *image, const char *key,
+    size_t key_len, size_t *len)
+{
+    if (len != NULL)
+        *len = 0;
+
+    if (image == NULL || key == NULL)
+        return NULL;
+
+    const sb_trie_image_header_t *header =
+        (sb_trie_image_header_t*) image->buf;
+    const sb_trie_image_node_t *node = sb_trie_image_get_node(image,
+        header->root);
+    if (node == NULL)
+        return NULL;
+
+    const uint8_t *k = (const uint8_t*) key;
+    size_t klen = key_len;
+
+    while (klen > 0) {
+        const uint8_t *child_keys = sb_trie_image_node_child_keys(node);
+        size_t lo = 0;
+        size_t hi = node->num_children;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (child_keys[mid] < *k)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo == node->num_children || child_keys[lo] != *k)
+            return NULL;
+
+        node = sb_trie_image_get_child(image, node, lo);
+        if (node == NULL || node->key_len > klen ||
+            0 != memcmp(sb_trie_image_node_key(node), k, node->key_len))
+            return NULL;
+
+        k += node->key_len;
+        klen -= node->key_len;
+    }
+
+    if (node->value == 0)
+        return NULL;
+
+    return sb_trie_image_get_value(image, node->value, len);
+}
+
+
+size_t
+sb_trie_image_size(sb_trie_image_t *image)
+{
+    if (image == NULL)
+        return 0;
+    return ((sb_trie_image_header_t*) image->buf)->num_keys;
+}
+
+
+typedef struct {
+    const sb_trie_image_node_t *node;
+    size_t pos;
+    size_t key_len;
+} sb_trie_image_frame_t;
+
+
+void
+sb_trie_image_foreach(sb_trie_image_t *image, sb_trie_foreach_func_t func,
+    void *user_data)
+{
+    if (func == NULL)
+        return;
+    sb_trie_foreach_ctx_t ctx = {func, user_data};
+    sb_trie_image_foreach_len(image, sb_trie_foreach_wrapper, &ctx);
+}
+
+
+void
+sb_trie_image_foreach_len(sb_trie_image_t *image,
+    sb_trie_foreach_len_func_t func, void *user_data)
+{
+    if (image == NULL || func == NULL)
+        return;
+
+    const sb_trie_image_header_t *header =
+        (sb_trie_image_header_t*) image->buf;
+    const sb_trie_image_node_t *node = sb_trie_image_get_node(image,
+        header->root);
+    if (node == NULL)
+        return;
+
+    // same approach of sb_trie_foreach_node(), but children are always
+    // sorted by position.
+    sb_trie_image_frame_t *frames = NULL;
+    size_t len = 0;
+    size_t allocated_len = 0;
+    sb_string_t *key = sb_string_new();
+
+    while (node != NULL) {
+        if (node->value != 0) {
+            const void *value = sb_trie_image_get_value(image, node->value,
+                NULL);
+            if (value != NULL)
+                func(key->str, key->len, (void*) value, user_data);
+        }
+
+        if (node->num_children > 0) {
+            if (len == allocated_len) {
+                allocated_len = allocated_len == 0 ? 16 : 2 * allocated_len;
+                frames = sb_realloc(frames,
+                    allocated_len * sizeof(sb_trie_image_frame_t));
+            }
+            frames[len].node = node;
+            frames[len].pos = 0;
+            frames[len++].key_len = key->len;
+        }
+
+        node = NULL;
+        while (node == NULL && len > 0) {
+            sb_trie_image_frame_t *frame = &frames[len - 1];
+            if (frame->pos == frame->node->num_children) {
+                len--;
+                continue;
+            }
+            node = sb_trie_image_get_child(image, frame->node, frame->pos++);
+            if (node == NULL)
+                continue;
+            key->len = frame->key_len;
+            key = sb_string_append_len(key,
+                (const char*) sb_trie_image_node_key(node), node->key_len);
+        }
+    }
 
-    sb_string_t *str = sb_string_new();
-    sb_trie_foreach_node(trie->root, str, func, user_data);
-    sb_string_free(str, true);
+    free(frames);
+    sb_string_free(key, true);
 }
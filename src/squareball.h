@@ -19,9 +19,11 @@
  */
 
 #include <squareball/sb-compat.h>
+#include <squareball/sb-concmap.h>
 #include <squareball/sb-configparser.h>
 #include <squareball/sb-error.h>
 #include <squareball/sb-file.h>
+#include <squareball/sb-hashmap.h>
 #include <squareball/sb-mem.h>
 #include <squareball/sb-parsererror.h>
 #include <squareball/sb-shell.h>
@@ -30,6 +32,7 @@
 #include <squareball/sb-strerror.h>
 #include <squareball/sb-strfuncs.h>
 #include <squareball/sb-string.h>
+#include <squareball/sb-strview.h>
 #include <squareball/sb-trie.h>
 #include <squareball/sb-utf8.h>
 
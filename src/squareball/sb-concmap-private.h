@@ -0,0 +1,52 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifndef _SQUAREBALL_CONCMAP_PRIVATE_H
+#define _SQUAREBALL_CONCMAP_PRIVATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sb-concmap.h"
+#include "sb-hashmap.h"
+
+/*
+ * Concurrent hash maps are split into shards, selected by the highest bits of
+ * the hash of the key (the lowest ones are used by the hash map of the shard).
+ * Each shard is a regular hash map, protected by a readers-writer spinlock,
+ * so operations on different shards never contend. Shards are padded to a
+ * cache line each, and the map is allocated aligned to a cache line.
+ *
+ * The lock word holds the number of readers, and two flags: one for the
+ * writer that holds the lock, and other for writers waiting for the readers
+ * to leave, that keeps new readers out, so writers are not starved.
+ */
+
+#define SB_CONCMAP_SHARDS_BITS 6
+#define SB_CONCMAP_SHARDS (1 << SB_CONCMAP_SHARDS_BITS)
+#define SB_CONCMAP_CACHE_LINE 64
+
+#define SB_CONCMAP_LOCK_WRITER 0x80000000U
+#define SB_CONCMAP_LOCK_PENDING 0x40000000U
+
+#define SB_CONCMAP_SHARD(hash) \
+    ((size_t) ((hash) >> (64 - SB_CONCMAP_SHARDS_BITS)))
+
+typedef struct {
+    size_t lock;
+    size_t acquisitions;
+    size_t contended;
+    sb_hashmap_t *map;
+    uint8_t padding[SB_CONCMAP_CACHE_LINE - 3 * sizeof(size_t) -
+        sizeof(sb_hashmap_t*)];
+} sb_concmap_shard_t;
+
+struct _sb_concmap_t {
+    sb_concmap_shard_t shards[SB_CONCMAP_SHARDS];
+};
+
+#endif /* _SQUAREBALL_CONCMAP_PRIVATE_H */
@@ -0,0 +1,221 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifndef _SQUAREBALL_CONCMAP_H
+#define _SQUAREBALL_CONCMAP_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "sb-hashmap.h"
+#include "sb-mem.h"
+
+/**
+ * @file squareball/sb-concmap.h
+ * @brief Implementation of a concurrent hash map data structure.
+ *
+ * This is a thread-safe variant of @ref sb_hashmap_t, that can be shared by
+ * any number of threads, all of them inserting, looking up and removing
+ * elements concurrently. Its functions follow the same conventions of the
+ * hash map and trie functions, including the ownership of the elements.
+ *
+ * The map is split into shards, selected by the hash of the keys, each one
+ * protected by its own readers-writer lock, so threads only contend when
+ * they use keys of the same shard, and lookups never block each other. The
+ * number of times each shard was contended can be inspected with
+ * @ref sb_concmap_shard_stats.
+ *
+ * Elements are free'd as soon as they are removed or replaced, so data
+ * returned by @ref sb_concmap_lookup is only valid while no other thread
+ * removes or replaces it. Use @ref sb_concmap_lookup_func to access data
+ * that may be removed concurrently.
+ *
+ * Concurrent hash maps are only supported if the compiler provides atomic
+ * builtins.
+ * @{
+ */
+
+/**
+ * Concurrent hash map opaque structure.
+ */
+typedef struct _sb_concmap_t sb_concmap_t;
+
+/**
+ * Concurrent hash map lookup callback function type.
+ *
+ * @param data       The data stored for the key.
+ * @param user_data  Pointer to arbitrary user data that was passed to
+ *                   @ref sb_concmap_lookup_func.
+ */
+typedef void (*sb_concmap_lookup_func_t)(void *data, void *user_data);
+
+/**
+ * Function that creates a new concurrent hash map.
+ *
+ * @param free_func  The \ref sb_free_func_t to be used to free the memory
+ *                   allocated for the elements automatically when needed. If
+ *                   NULL, the map won't touch the elements when free'ing
+ *                   itself.
+ * @return           A new concurrent hash map, or NULL if not supported.
+ */
+sb_concmap_t* sb_concmap_new(sb_free_func_t free_func);
+
+/**
+ * Function that frees the memory allocated for a concurrent hash map, and
+ * for its elements. It must not be used by other threads anymore.
+ *
+ * @param map  The concurrent hash map.
+ */
+void sb_concmap_free(sb_concmap_t *map);
+
+/**
+ * Function that inserts an element on the concurrent hash map. See
+ * @ref sb_hashmap_insert.
+ *
+ * @param map   The concurrent hash map.
+ * @param key   The key string.
+ * @param data  The data to be stored for the key.
+ */
+void sb_concmap_insert(sb_concmap_t *map, const char *key, void *data);
+
+/**
+ * Function that inserts an element on the concurrent hash map, with a key
+ * that may contain NUL bytes. See @ref sb_hashmap_insert.
+ *
+ * @param map      The concurrent hash map.
+ * @param key      The key.
+ * @param key_len  The length of the key.
+ * @param data     The data to be stored for the key.
+ */
+void sb_concmap_insert_len(sb_concmap_t *map, const char *key,
+    size_t key_len, void *data);
+
+/**
+ * Function that searches the concurrent hash map for a given key, and return
+ * its data.
+ *
+ * @param map  The concurrent hash map.
+ * @param key  The key string to be looked for.
+ * @return     The data stored for the given key, if found, otherwise NULL.
+ */
+void* sb_concmap_lookup(sb_concmap_t *map, const char *key);
+
+/**
+ * Function that searches the concurrent hash map for a given key, that may
+ * contain NUL bytes, and return its data.
+ *
+ * @param map      The concurrent hash map.
+ * @param key      The key to be looked for.
+ * @param key_len  The length of the key.
+ * @return         The data stored for the given key, if found, otherwise
+ *                 NULL.
+ */
+void* sb_concmap_lookup_len(sb_concmap_t *map, const char *key,
+    size_t key_len);
+
+/**
+ * Function that searches the concurrent hash map for a given key, and calls
+ * a given function with its data, while holding the lock of its shard, so
+ * the data can't be free'd by other threads. The function must not use the
+ * map.
+ *
+ * @param map        The concurrent hash map.
+ * @param key        The key string to be looked for.
+ * @param func       The function that should be called with the data.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ * @return           \c true if the key was found, otherwise \c false.
+ */
+bool sb_concmap_lookup_func(sb_concmap_t *map, const char *key,
+    sb_concmap_lookup_func_t func, void *user_data);
+
+/**
+ * Function that searches the concurrent hash map for a given key, that may
+ * contain NUL bytes, and calls a given function with its data, while holding
+ * the lock of its shard, so the data can't be free'd by other threads. The
+ * function must not use the map.
+ *
+ * @param map        The concurrent hash map.
+ * @param key        The key to be looked for.
+ * @param key_len    The length of the key.
+ * @param func       The function that should be called with the data.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ * @return           \c true if the key was found, otherwise \c false.
+ */
+bool sb_concmap_lookup_func_len(sb_concmap_t *map, const char *key,
+    size_t key_len, sb_concmap_lookup_func_t func, void *user_data);
+
+/**
+ * Function that removes an element from the concurrent hash map. See
+ * @ref sb_hashmap_remove.
+ *
+ * @param map  The concurrent hash map.
+ * @param key  The key string to be removed.
+ * @return     \c true if the key was found and removed, otherwise \c false.
+ */
+bool sb_concmap_remove(sb_concmap_t *map, const char *key);
+
+/**
+ * Function that removes an element from the concurrent hash map, with a key
+ * that may contain NUL bytes. See @ref sb_hashmap_remove.
+ *
+ * @param map      The concurrent hash map.
+ * @param key      The key to be removed.
+ * @param key_len  The length of the key.
+ * @return         \c true if the key was found and removed, otherwise
+ *                 \c false.
+ */
+bool sb_concmap_remove_len(sb_concmap_t *map, const char *key,
+    size_t key_len);
+
+/**
+ * Function that returns the size of a given concurrent hash map. The shards
+ * are counted one at a time, so the result may be outdated if other threads
+ * are changing the map.
+ *
+ * @param map  The concurrent hash map.
+ * @return     The size of the given concurrent hash map.
+ */
+size_t sb_concmap_size(sb_concmap_t *map);
+
+/**
+ * Function that calls a given function for each element of a concurrent hash
+ * map, while holding the lock of the shard of the element. Elements are
+ * visited in no particular order. The function must not use the map.
+ *
+ * @param map        The concurrent hash map.
+ * @param func       The function that should be called for each element.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ */
+void sb_concmap_foreach(sb_concmap_t *map, sb_hashmap_foreach_func_t func,
+    void *user_data);
+
+/**
+ * Function that returns the number of shards of a concurrent hash map.
+ *
+ * @param map  The concurrent hash map.
+ * @return     The number of shards.
+ */
+size_t sb_concmap_num_shards(sb_concmap_t *map);
+
+/**
+ * Function that returns the lock statistics of a shard of a concurrent hash
+ * map, to find hot spots. Counters are not reset.
+ *
+ * @param map           The concurrent hash map.
+ * @param shard         The shard index, lower than the value returned by
+ *                      @ref sb_concmap_num_shards.
+ * @param acquisitions  Return location for the number of times the lock of
+ *                      the shard was acquired, or NULL.
+ * @param contended     Return location for the number of times a thread had
+ *                      to wait for the lock of the shard, or NULL.
+ */
+void sb_concmap_shard_stats(sb_concmap_t *map, size_t shard,
+    size_t *acquisitions, size_t *contended);
+
+/** @} */
+
+#endif /* _SQUAREBALL_CONCMAP_H */
@@ -40,22 +40,33 @@ sb_config_t* sb_config_parse(const char *src, size_t src_len,
     const char *list_sections[], sb_error_t **err);
 
 /**
- * Function that returns an array with configuration sections.
+ * Function that returns an array with configuration sections, in the order
+ * they were first found in the source. Sections found again keep their
+ * positions. Previous versions grouped sections with common prefixes
+ * together, this is no longer the case.
+ *
+ * The array is packed (see \ref sb_strv_new_packed), so the strings must not
+ * be free'd or replaced individually.
  *
  * @param config  A \ref sb_config_t object.
  * @return        An array of strings, or \c NULL. Must be free'd with
- *                \ref sb_strv_free.
+ *                \ref sb_strv_free_packed.
  */
 char** sb_config_list_sections(sb_config_t *config);
 
 /**
  * Function that returns an array with configuration keys found in a given
- * configuration section.
+ * configuration section, in the order they were first found in the source.
+ * Keys found again keep their positions. Previous versions grouped keys with
+ * common prefixes together, this is no longer the case.
+ *
+ * The array is packed (see \ref sb_strv_new_packed), so the strings must not
+ * be free'd or replaced individually.
  *
  * @param config   A \ref sb_config_t object.
  * @param section  A configuration section.
  * @return         An array of strings, or \c NULL. Must be free'd with
- *                 \ref sb_strv_free.
+ *                 \ref sb_strv_free_packed.
  */
 char** sb_config_list_keys(sb_config_t *config, const char *section);
 
@@ -92,13 +103,28 @@ const char* sb_config_get_with_default(sb_config_t *config, const char *section,
  * The section must be included in the \c list_sections when calling
  * \ref sb_config_parse.
  *
+ * The array is packed (see \ref sb_strv_new_packed), so the strings must not
+ * be free'd or replaced individually.
+ *
  * @param config   A \ref sb_config_t object.
  * @param section  A configuration section.
  * @return         An NULL-terminated array of strings, that should be free'd
- *                 with \ref sb_strv_free.
+ *                 with \ref sb_strv_free_packed.
  */
 char** sb_config_get_list(sb_config_t *config, const char *section);
 
+/**
+ * Function that enables approximate membership filters on the sections and
+ * keys of a configuration object, so lookups of missing sections and keys,
+ * e.g. optional keys, are faster. See \ref sb_trie_enable_filter.
+ *
+ * @param config   A \ref sb_config_t object.
+ * @param fp_rate  The approximate rate of lookups of missing sections and
+ *                 keys that are not rejected by the filters, e.g. 0.01.
+ * @return         \c true if the filters were enabled, otherwise \c false.
+ */
+bool sb_config_enable_filter(sb_config_t *config, double fp_rate);
+
 /**
  * Function that frees the memory allocated for a configuration object.
  *
@@ -0,0 +1,20 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifndef _SQUAREBALL_HASH_PRIVATE_H
+#define _SQUAREBALL_HASH_PRIVATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64 bits hash of a key, that may contain NUL bytes, shared by the hash
+// maps and the filters of the tries. hashes are not stable across versions,
+// and must not be stored outside of memory.
+uint64_t sb_hash(const char *key, size_t len);
+
+#endif /* _SQUAREBALL_HASH_PRIVATE_H */
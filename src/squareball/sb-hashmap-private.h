@@ -0,0 +1,69 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifndef _SQUAREBALL_HASHMAP_PRIVATE_H
+#define _SQUAREBALL_HASHMAP_PRIVATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sb-mem.h"
+#include "sb-hashmap.h"
+
+/*
+ * Open-addressing hash table, with the layout of the "Swiss tables" from
+ * Abseil. Each slot has a control byte, stored in a separate array, that
+ * tells if the slot is empty, deleted (tombstone) or full. Full slots store
+ * the 7 lowest bits of the hash of their key (H2), and the remaining bits
+ * (H1) select where the probing starts. Probing checks groups of control
+ * bytes at once, and only compares the keys of the slots whose H2 match.
+ *
+ * The control bytes of the first group are mirrored after the last slot, so
+ * a group can be loaded at any position without wrapping around.
+ */
+
+// number of control bytes checked at once. capacity is a power of two, not
+// lower than this.
+#define SB_HASHMAP_GROUP_WIDTH 16
+
+#define SB_HASHMAP_CTRL_EMPTY 0x80
+#define SB_HASHMAP_CTRL_DELETED 0xfe
+
+#define SB_HASHMAP_H1(hash) ((size_t) ((hash) >> 7))
+#define SB_HASHMAP_H2(hash) ((uint8_t) ((hash) & 0x7f))
+
+// keys are copied, and NUL-terminated, to be returned as strings. the hash
+// is stored to avoid rehashing the keys when the table grows, and to skip
+// most of the comparisons of keys with the same H2.
+typedef struct {
+    uint64_t hash;
+    char *key;
+    size_t key_len;
+    void *data;
+} sb_hashmap_slot_t;
+
+struct _sb_hashmap_t {
+    uint8_t *ctrl;
+    sb_hashmap_slot_t *slots;
+    size_t capacity;
+    size_t size;
+    size_t growth_left;
+    sb_free_func_t free_func;
+};
+
+// variants of the hash map functions that receive the hash of the key, as
+// returned by sb_hash(), for users that already computed it (e.g. to select
+// a shard of a sb_concmap_t). arguments are not validated.
+void sb_hashmap_insert_hashed(sb_hashmap_t *map, const char *key,
+    size_t key_len, uint64_t hash, void *data);
+void* sb_hashmap_lookup_hashed(sb_hashmap_t *map, const char *key,
+    size_t key_len, uint64_t hash);
+bool sb_hashmap_remove_hashed(sb_hashmap_t *map, const char *key,
+    size_t key_len, uint64_t hash);
+
+#endif /* _SQUAREBALL_HASHMAP_PRIVATE_H */
@@ -0,0 +1,192 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifndef _SQUAREBALL_HASHMAP_H
+#define _SQUAREBALL_HASHMAP_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "sb-mem.h"
+
+/**
+ * @file squareball/sb-hashmap.h
+ * @brief Implementation of a hash map data structure.
+ *
+ * This hash map is an alternative to @ref sb_trie_t for exact-match lookups,
+ * that are much faster, at the cost of not supporting ordered traversal or
+ * prefix lookups. Its functions follow the same conventions of the trie
+ * functions, including the ownership of the elements, so code written for
+ * one can be switched to the other easily.
+ *
+ * The hash map uses open addressing, with a separate array of control bytes
+ * that is probed in groups (using SIMD instructions, when available), so
+ * most lookups touch a single cache line of control bytes, and compare a
+ * single key.
+ *
+ * Keys are NUL-terminated strings, but every function that receives a key has
+ * a \c _len variant, that receives an arbitrary span of bytes instead, that
+ * may contain NUL bytes.
+ *
+ * Hash maps are not thread-safe.
+ * @{
+ */
+
+/**
+ * Hash map opaque structure.
+ */
+typedef struct _sb_hashmap_t sb_hashmap_t;
+
+/**
+ * Hash map foreach callback function type.
+ *
+ * @param key        The key string for current hash map element.
+ * @param data       The data stored for the key.
+ * @param user_data  Pointer to arbitrary user data that was passed to
+ *                   @ref sb_hashmap_foreach.
+ */
+typedef void (*sb_hashmap_foreach_func_t)(const char *key, void *data,
+    void *user_data);
+
+/**
+ * Hash map foreach callback function type, for keys that may contain NUL
+ * bytes.
+ *
+ * @param key        The key for current hash map element. It is followed by a
+ *                   NUL byte, that is not part of the key.
+ * @param key_len    The length of the key.
+ * @param data       The data stored for the key.
+ * @param user_data  Pointer to arbitrary user data that was passed to
+ *                   @ref sb_hashmap_foreach_len.
+ */
+typedef void (*sb_hashmap_foreach_len_func_t)(const char *key, size_t key_len,
+    void *data, void *user_data);
+
+/**
+ * Function that creates a new hash map.
+ *
+ * @param free_func  The \ref sb_free_func_t to be used to free the memory
+ *                   allocated for the elements automatically when needed. If
+ *                   NULL, the hash map won't touch the elements when free'ing
+ *                   itself.
+ * @return           A new hash map.
+ */
+sb_hashmap_t* sb_hashmap_new(sb_free_func_t free_func);
+
+/**
+ * Function that frees the memory allocated for a hash map, and for its
+ * elements (using the free function provided when creating the hash map).
+ *
+ * @param map  The hash map.
+ */
+void sb_hashmap_free(sb_hashmap_t *map);
+
+/**
+ * Function that inserts an element on the hash map. If the key already
+ * exists, its current element is free'd (using the free function provided
+ * when creating the hash map) and replaced with new one. The key is copied.
+ *
+ * @param map   The hash map.
+ * @param key   The key string.
+ * @param data  The data to be stored for the key. Users should not free it
+ *              explicitly if the hash map was initialized with a valid free
+ *              function. If NULL, nothing is inserted.
+ */
+void sb_hashmap_insert(sb_hashmap_t *map, const char *key, void *data);
+
+/**
+ * Function that inserts an element on the hash map, with a key that may
+ * contain NUL bytes. See @ref sb_hashmap_insert.
+ *
+ * @param map      The hash map.
+ * @param key      The key.
+ * @param key_len  The length of the key.
+ * @param data     The data to be stored for the key.
+ */
+void sb_hashmap_insert_len(sb_hashmap_t *map, const char *key, size_t key_len,
+    void *data);
+
+/**
+ * Function that searches the hash map for a given key, and return its data.
+ *
+ * @param map  The hash map.
+ * @param key  The key string to be looked for.
+ * @return     The data stored for the given key, if found, otherwise NULL.
+ */
+void* sb_hashmap_lookup(sb_hashmap_t *map, const char *key);
+
+/**
+ * Function that searches the hash map for a given key, that may contain NUL
+ * bytes, and return its data.
+ *
+ * @param map      The hash map.
+ * @param key      The key to be looked for.
+ * @param key_len  The length of the key.
+ * @return         The data stored for the given key, if found, otherwise
+ *                 NULL.
+ */
+void* sb_hashmap_lookup_len(sb_hashmap_t *map, const char *key,
+    size_t key_len);
+
+/**
+ * Function that removes an element from the hash map. Its element is free'd
+ * (using the free function provided when creating the hash map).
+ *
+ * @param map  The hash map.
+ * @param key  The key string to be removed.
+ * @return     \c true if the key was found and removed, otherwise \c false.
+ */
+bool sb_hashmap_remove(sb_hashmap_t *map, const char *key);
+
+/**
+ * Function that removes an element from the hash map, with a key that may
+ * contain NUL bytes. See @ref sb_hashmap_remove.
+ *
+ * @param map      The hash map.
+ * @param key      The key to be removed.
+ * @param key_len  The length of the key.
+ * @return         \c true if the key was found and removed, otherwise
+ *                 \c false.
+ */
+bool sb_hashmap_remove_len(sb_hashmap_t *map, const char *key,
+    size_t key_len);
+
+/**
+ * Function that returns the size of a given hash map. This is a constant
+ * time operation.
+ *
+ * @param map  The hash map.
+ * @return     The size of the given hash map.
+ */
+size_t sb_hashmap_size(sb_hashmap_t *map);
+
+/**
+ * Function that calls a given function for each element of a hash map.
+ * Elements are visited in no particular order.
+ *
+ * @param map        The hash map.
+ * @param func       The function that should be called for each element.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ */
+void sb_hashmap_foreach(sb_hashmap_t *map, sb_hashmap_foreach_func_t func,
+    void *user_data);
+
+/**
+ * Function that calls a given function for each element of a hash map, with
+ * the length of its key, that may contain NUL bytes. See
+ * @ref sb_hashmap_foreach.
+ *
+ * @param map        The hash map.
+ * @param func       The function that should be called for each element.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ */
+void sb_hashmap_foreach_len(sb_hashmap_t *map,
+    sb_hashmap_foreach_len_func_t func, void *user_data);
+
+/** @} */
+
+#endif /* _SQUAREBALL_HASHMAP_H */
@@ -49,6 +49,20 @@ void* sb_malloc(size_t size);
  */
 void* sb_realloc(void *ptr, size_t size);
 
+/**
+ * Safe aligned allocation function. This function allocates memory aligned
+ * to a given boundary, validates the output of the libc's allocation call
+ * and aborts if needed. See posix_memalign(3) for details. The memory must
+ * be free'd with free(3). If the libc can't align allocations, the memory is
+ * aligned as returned by malloc(3).
+ *
+ * @param alignment  The alignment, a power of two multiple of
+ *                   <tt>sizeof(void*)</tt>.
+ * @param size       Number of bytes to be allocated.
+ * @return           A pointer to the allocated memory.
+ */
+void* sb_malloc_aligned(size_t alignment, size_t size);
+
 /** @} */
 
 #endif /* _SQUAREBALL_MEM_H */
@@ -0,0 +1,30 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifndef _SQUAREBALL_STRFUNCS_PRIVATE_H
+#define _SQUAREBALL_STRFUNCS_PRIVATE_H
+
+#include <stddef.h>
+
+/*
+ * Packed string arrays store the array and the strings in a single memory
+ * allocation, and are free'd with sb_strv_free_packed:
+ *
+ *     [strv[0] ... strv[count - 1], NULL][str 0\0str 1\0 ...]
+ */
+
+// pointer to where the strings of a packed array are stored.
+#define SB_STRV_PACKED_DATA(strv, count) ((char*) ((strv) + (count) + 1))
+
+// allocates a packed array for count strings, with len bytes for the
+// strings, including their nul bytes. the array is NULL-terminated, and the
+// strings must be stored in order, starting at
+// SB_STRV_PACKED_DATA(strv, count).
+char** sb_strv_alloc_packed(size_t count, size_t len);
+
+#endif /* _SQUAREBALL_STRFUNCS_PRIVATE_H */
@@ -12,6 +12,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <squareball/sb-strview.h>
 
 /**
  * @file squareball/sb-strfuncs.h
@@ -20,6 +21,19 @@
  * @{
  */
 
+/**
+ * String split iterator structure. It is allocated by users, usually in the
+ * stack, and initialized with \ref sb_str_split_iter_init. Its members are
+ * private, and should not be accessed directly.
+ */
+typedef struct {
+    sb_strview_t rest;
+    size_t pieces;
+    size_t max_pieces;
+    char c;
+    bool done;
+} sb_str_split_iter_t;
+
 /**
  * Replacement for glibc's strdup(3).
  *
@@ -57,6 +71,26 @@ char* sb_strdup_vprintf(const char *format, va_list ap);
  */
 char* sb_strdup_printf(const char *format, ...);
 
+/**
+ * Function that concatenates \c n strings in a single dynamically allocated
+ * string, with a single memory allocation. \c NULL strings are skipped.
+ *
+ * @param n   The number of strings.
+ * @param ap  A va_list variable, with \c n strings.
+ * @return    A newly-allocated string.
+ */
+char* sb_str_concatv(size_t n, va_list ap);
+
+/**
+ * Function that concatenates \c n strings in a single dynamically allocated
+ * string, with a single memory allocation. \c NULL strings are skipped.
+ *
+ * @param n    The number of strings.
+ * @param ...  \c n strings.
+ * @return     A newly-allocated string.
+ */
+char* sb_str_concat(size_t n, ...);
+
 /**
  * Function that checks if a string starts with a given prefix.
  *
@@ -110,16 +144,59 @@ char* sb_str_strip(char *str);
  * Function that splits a string in all occurences of a given character,
  * excluding this character from the resulting elements.
  *
+ * The array is packed (see \ref sb_strv_new_packed), so the strings must not
+ * be free'd or replaced individually.
+ *
  * @param str         The string.
  * @param c           The character that should be looked for.
  * @param max_pieces  The max number of pieces that should be splitted. After
  *                    this, the character will be kept untouched. If \c 0,
  *                    split until the end of the string.
  * @return            An NULL-terminated array of strings, that should be
- *                    free'd with \ref sb_strv_free.
+ *                    free'd with \ref sb_strv_free_packed.
  */
 char** sb_str_split(const char *str, char c, size_t max_pieces);
 
+/**
+ * Function that initializes an iterator, that returns the same pieces as
+ * \ref sb_str_split, as views of the string, without allocating memory. The
+ * string must not be modified while the iterator is used.
+ *
+ * @param iter        The iterator.
+ * @param str         The string.
+ * @param c           The character that should be looked for.
+ * @param max_pieces  The max number of pieces that should be splitted. After
+ *                    this, the character will be kept untouched. If \c 0,
+ *                    split until the end of the string.
+ */
+void sb_str_split_iter_init(sb_str_split_iter_t *iter, const char *str,
+    char c, size_t max_pieces);
+
+/**
+ * Function that initializes an iterator, for a string that may contain NUL
+ * bytes, or is not nul-terminated. See \ref sb_str_split_iter_init.
+ *
+ * @param iter        The iterator.
+ * @param str         The string.
+ * @param len         The length of the string.
+ * @param c           The character that should be looked for.
+ * @param max_pieces  The max number of pieces that should be splitted. If
+ *                    \c 0, split until the end of the string.
+ */
+void sb_str_split_iter_init_len(sb_str_split_iter_t *iter, const char *str,
+    size_t len, char c, size_t max_pieces);
+
+/**
+ * Function that returns the next piece of a string split iterator.
+ *
+ * @param iter   The iterator.
+ * @param piece  Return location for the view of the piece, or NULL. It is not
+ *               nul-terminated.
+ * @return       \c true if a piece was returned, or \c false if the
+ *               iteration is over.
+ */
+bool sb_str_split_iter_next(sb_str_split_iter_t *iter, sb_strview_t *piece);
+
 /**
  * Function that replaces all the occurences of a given character in a string
  * with another given string.
@@ -154,14 +231,48 @@ char* sb_str_find(const char *str, char c);
  */
 bool sb_str_to_bool(const char *str);
 
+/**
+ * Function that creates a NULL-terminated array of strings, with copies of
+ * the given views. The array and the strings are stored in a single memory
+ * allocation (a packed array), so the strings must not be free'd or replaced
+ * individually.
+ *
+ * @param pieces  The array of string views.
+ * @param n       The number of views in \c pieces.
+ * @return        A NULL-terminated array of strings, that should be free'd
+ *                with \ref sb_strv_free_packed.
+ */
+char** sb_strv_new_packed(const sb_strview_t *pieces, size_t n);
+
+/**
+ * Function that copies a NULL-terminated array of strings into a packed
+ * array (see \ref sb_strv_new_packed), e.g. to store it for a long time. The
+ * given array is not changed.
+ *
+ * @param strv  The NULL-terminated array of strings.
+ * @return      A NULL-terminated array of strings, that should be free'd with
+ *              \ref sb_strv_free_packed.
+ */
+char** sb_strv_pack(char **strv);
+
 /**
  * Function that frees the memory allocated for a NULL-terminated array of
- * strings.
+ * strings, and for each of its strings. Must not be used with packed arrays
+ * (see \ref sb_strv_new_packed), that are free'd with
+ * \ref sb_strv_free_packed.
  *
  * @param strv  The NULL-terminated array of strings.
  */
 void sb_strv_free(char **strv);
 
+/**
+ * Function that frees the memory allocated for a packed NULL-terminated array
+ * of strings (see \ref sb_strv_new_packed), with a single call to free(3).
+ *
+ * @param strv  The packed NULL-terminated array of strings.
+ */
+void sb_strv_free_packed(char **strv);
+
 /**
  * Function that joins a NULL-terminated array of strings in a single string,
  * using a given string as separator.
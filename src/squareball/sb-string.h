@@ -22,7 +22,14 @@
  */
 
 /**
- * Automatically growing string structure.
+ * Size of the buffer used to store small strings inside the string object,
+ * including the nul byte.
+ */
+#define SB_STRING_SMALL_SIZE 40
+
+/**
+ * Automatically growing string structure. Small strings are stored in the
+ * structure itself, so string objects must not be copied by value.
  */
 typedef struct {
 
@@ -43,6 +50,12 @@ typedef struct {
      */
     size_t allocated_len;
 
+    /**
+     * The buffer used by \ref str for small strings, avoiding a second
+     * memory allocation. Should not be touched by user.
+     */
+    char small_str[SB_STRING_SMALL_SIZE];
+
 } sb_string_t;
 
 /**
@@ -52,6 +65,17 @@ typedef struct {
  */
 sb_string_t* sb_string_new(void);
 
+/**
+ * Function that creates an empty string object, with room for a string of a
+ * given length, so appending up to \c len bytes won't reallocate memory.
+ * Useful when the final length of the string is known, or can be estimated.
+ *
+ * @param len  The length of the string that the object can store without
+ *             reallocating memory, not including the nul byte.
+ * @return     New string object.
+ */
+sb_string_t* sb_string_new_sized(size_t len);
+
 /**
  * Function that frees memory allocated for a string object. If \c free_str
  * is \c false, it will only free the memory allocated for the object, and
@@ -102,6 +126,18 @@ sb_string_t* sb_string_append(sb_string_t *str, const char *suffix);
  */
 sb_string_t* sb_string_append_c(sb_string_t *str, char c);
 
+/**
+ * Function that appends to an string object with a vprintf(3)-like interface.
+ * The output is formatted directly into the string object.
+ *
+ * @param str     The string object.
+ * @param format  A printf(3) format.
+ * @param ap      A va_list variable, as used in vprintf(3).
+ * @return        The modified string object.
+ */
+sb_string_t* sb_string_append_vprintf(sb_string_t *str, const char *format,
+    va_list ap);
+
 /**
  * Function that appends to an string object with a printf(3)-like interface.
  *
@@ -122,6 +158,27 @@ sb_string_t* sb_string_append_printf(sb_string_t *str, const char *format, ...);
  */
 sb_string_t* sb_string_append_escaped(sb_string_t *str, const char *suffix);
 
+/**
+ * Function that makes sure that the string object has room to append \c len
+ * more bytes without reallocating memory. Memory is allocated exactly, so
+ * this should be called once, with the total length to be appended, and not
+ * for each small append.
+ *
+ * @param str  The string object.
+ * @param len  The number of bytes to be appended to the string object.
+ * @return     The modified string object.
+ */
+sb_string_t* sb_string_reserve(sb_string_t *str, size_t len);
+
+/**
+ * Function that releases the memory allocated for the string object that is
+ * not used by the string, e.g. before storing it for a long time.
+ *
+ * @param str  The string object.
+ * @return     The modified string object.
+ */
+sb_string_t* sb_string_shrink_to_fit(sb_string_t *str);
+
 /** @} */
 
 #endif /* _SQUAREBALL_STRING_H */
@@ -0,0 +1,180 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#ifndef _SQUAREBALL_STRVIEW_H
+#define _SQUAREBALL_STRVIEW_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/**
+ * @file squareball/sb-strview.h
+ * @brief Non-owning string views, and helper functions to handle them.
+ *
+ * A string view points to a slice of a string that is owned by someone else,
+ * and is not required to be nul-terminated, making it possible to handle
+ * pieces of big buffers without copying them. The viewed string must outlive
+ * the view.
+ *
+ * @{
+ */
+
+/**
+ * String view structure. Passed and returned by value.
+ */
+typedef struct {
+
+    /**
+     * The first byte of the view. Not nul-terminated.
+     */
+    const char *str;
+
+    /**
+     * The number of bytes in the view.
+     */
+    size_t len;
+
+} sb_strview_t;
+
+/**
+ * Function that creates a view of a nul-terminated string.
+ *
+ * @param str  The nul-terminated string, or NULL.
+ * @return     A view of the whole \c str, or an empty view.
+ */
+sb_strview_t sb_strview(const char *str);
+
+/**
+ * Function that creates a view of \c len bytes from a string.
+ *
+ * @param str  The string, that does not need to be nul-terminated.
+ * @param len  The number of bytes from \c str.
+ * @return     A view of \c len bytes from \c str.
+ */
+sb_strview_t sb_strview_len(const char *str, size_t len);
+
+/**
+ * Function that creates a view of a part of a view. \c start and \c len are
+ * clamped to the size of the view.
+ *
+ * @param view   The string view.
+ * @param start  The offset of the first byte of the new view.
+ * @param len    The maximum number of bytes in the new view.
+ * @return       A view of up to \c len bytes from \c view, starting at
+ *               \c start.
+ */
+sb_strview_t sb_strview_slice(sb_strview_t view, size_t start, size_t len);
+
+/**
+ * Function that creates a dynamically allocated nul-terminated copy of a
+ * view.
+ *
+ * @param view  The string view.
+ * @return      A newly-allocated string, or NULL if the view is empty and
+ *              points to NULL.
+ */
+char* sb_strview_dup(sb_strview_t view);
+
+/**
+ * Function that checks if two views have the same content.
+ *
+ * @param a  The first string view.
+ * @param b  The second string view.
+ * @return   A boolean that indicates if the views are equal.
+ */
+bool sb_strview_equal(sb_strview_t a, sb_strview_t b);
+
+/**
+ * Function that compares two views, byte by byte, like strcmp(3). A view
+ * that is a prefix of the other view is smaller.
+ *
+ * @param a  The first string view.
+ * @param b  The second string view.
+ * @return   An integer less than, equal to, or greater than zero if \c a is
+ *           smaller than, equal to, or greater than \c b.
+ */
+int sb_strview_compare(sb_strview_t a, sb_strview_t b);
+
+/**
+ * Function that checks if a view starts with a given prefix.
+ *
+ * @param view    The string view.
+ * @param prefix  The prefix that should be looked for in the view.
+ * @return        A boolean that indicates if the view starts with the given
+ *                prefix.
+ */
+bool sb_strview_starts_with(sb_strview_t view, sb_strview_t prefix);
+
+/**
+ * Function that checks if a view ends with a given suffix.
+ *
+ * @param view    The string view.
+ * @param suffix  The suffix that should be looked for in the view.
+ * @return        A boolean that indicates if the view ends with the given
+ *                suffix.
+ */
+bool sb_strview_ends_with(sb_strview_t view, sb_strview_t suffix);
+
+/**
+ * Function that strips whitespace from the beginning of a view.
+ *
+ * @param view  The string view.
+ * @return      A view without the leading whitespace of \c view.
+ */
+sb_strview_t sb_strview_lstrip(sb_strview_t view);
+
+/**
+ * Function that strips whitespace from the end of a view.
+ *
+ * @param view  The string view.
+ * @return      A view without the trailing whitespace of \c view.
+ */
+sb_strview_t sb_strview_rstrip(sb_strview_t view);
+
+/**
+ * Function that strips whitespace from the beginning and from the end of a
+ * view.
+ *
+ * @param view  The string view.
+ * @return      A view without the leading and trailing whitespace of
+ *              \c view.
+ */
+sb_strview_t sb_strview_strip(sb_strview_t view);
+
+/**
+ * Function that returns a pointer to the first occurrence of a character in
+ * a view.
+ *
+ * Like \ref sb_str_find, this respects '\' escaping.
+ *
+ * @param view  The string view.
+ * @param c     The character that should be searched in the view.
+ * @return      The pointer to the first occurrence of \c c in \c view, or
+ *              NULL.
+ */
+const char* sb_strview_find(sb_strview_t view, char c);
+
+/**
+ * Function that splits a view in the first occurrence of a given character,
+ * excluding this character from the resulting views. Calling it repeatedly
+ * with \c tail as \c view walks all the pieces of a string.
+ *
+ * @param view  The string view.
+ * @param c     The character that should be looked for.
+ * @param head  Pointer to store the view of the piece before \c c, or the
+ *              whole \c view if \c c is not found.
+ * @param tail  Pointer to store the view of the piece after \c c, or an empty
+ *              view if \c c is not found.
+ * @return      A boolean that indicates if \c c was found.
+ */
+bool sb_strview_split(sb_strview_t view, char c, sb_strview_t *head,
+    sb_strview_t *tail);
+
+/** @} */
+
+#endif /* _SQUAREBALL_STRVIEW_H */
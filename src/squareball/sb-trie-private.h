@@ -9,18 +9,272 @@
 #ifndef _SQUAREBALL_TRIE_PRIVATE_H
 #define _SQUAREBALL_TRIE_PRIVATE_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include "sb-mem.h"
 #include "sb-trie.h"
 
-typedef struct _sb_trie_node_t {
-    char key;
+/*
+ * Radix (path-compressed) trie with adaptive nodes, as described in "The
+ * Adaptive Radix Tree: ARTful Indexing for Main-Memory Databases" (Leis et
+ * al). Each node owns the span of bytes of the edge that leads to it, stored
+ * right after the node structure (see sb_trie_node_key()), so chains of
+ * single-child nodes are collapsed into a single node. Children are indexed
+ * by the first byte of their edge, and the layout used to store them depends
+ * on the number of children. A node holds a value if it is terminal, since
+ * keys can end at any byte, including NUL.
+ */
+
+typedef enum {
+    SB_TRIE_NODE_LEAF = 1,
+    SB_TRIE_NODE_4,
+    SB_TRIE_NODE_16,
+    SB_TRIE_NODE_48,
+    SB_TRIE_NODE_256,
+} sb_trie_node_type_t;
+
+// longest span of bytes that a single node can store.
+#define SB_TRIE_NODE_MAX_KEY_LEN UINT32_MAX
+
+// a key ends at the node, and data holds its value.
+#define SB_TRIE_NODE_TERMINAL 0x01
+
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t num_children;
+    uint32_t key_len;
     void *data;
-    struct _sb_trie_node_t *next, *child;
 } sb_trie_node_t;
 
+// keys are sorted, to allow ordered traversal.
+typedef struct {
+    sb_trie_node_t base;
+    uint8_t keys[4];
+    sb_trie_node_t *children[4];
+} sb_trie_node4_t;
+
+// keys are sorted, and searched with a single SIMD compare, when available.
+typedef struct {
+    sb_trie_node_t base;
+    uint8_t keys[16];
+    sb_trie_node_t *children[16];
+} sb_trie_node16_t;
+
+// index stores the position in children + 1, or 0 if there's no child.
+typedef struct {
+    sb_trie_node_t base;
+    uint8_t index[256];
+    sb_trie_node_t *children[48];
+} sb_trie_node48_t;
+
+typedef struct {
+    sb_trie_node_t base;
+    sb_trie_node_t *children[256];
+} sb_trie_node256_t;
+
+/*
+ * Nodes are carved from an arena owned by the trie: small blocks are bumped
+ * from big chunks of memory, and released blocks are kept in free lists, by
+ * size class, for reuse. Blocks bigger than the biggest size class are
+ * allocated individually, and linked to the arena. Freeing the arena
+ * releases everything in a few calls to free(3).
+ */
+
+#define SB_TRIE_ARENA_NUM_CLASSES 40
+#define SB_TRIE_ARENA_MAX_CLASS_SIZE 4096
+#define SB_TRIE_ARENA_MIN_CHUNK_SIZE 1024
+#define SB_TRIE_ARENA_MAX_CHUNK_SIZE 65536
+
+typedef struct _sb_trie_arena_chunk_t {
+    struct _sb_trie_arena_chunk_t *next;
+    size_t size;
+} sb_trie_arena_chunk_t;
+
+typedef struct _sb_trie_arena_large_t {
+    struct _sb_trie_arena_large_t *prev, *next;
+} sb_trie_arena_large_t;
+
+typedef struct {
+    size_t allocated_len;
+    sb_trie_arena_chunk_t *chunks;
+    uint8_t *ptr;
+    uint8_t *end;
+    sb_trie_arena_large_t *large;
+    void *free_list[SB_TRIE_ARENA_NUM_CLASSES];
+} sb_trie_arena_t;
+
+/*
+ * Concurrent tries are never modified in place: updates copy the nodes of the
+ * path being changed (copy-on-write), and publish the new root with an atomic
+ * store, so readers always see a consistent trie. Replaced nodes and elements
+ * are retired, and only released after all the readers that could still be
+ * using them are done (epoch-based reclamation): readers register themselves
+ * in one of two sets of counters, selected by the parity of the current
+ * epoch, and the writer flips the epoch and waits for the counters of the
+ * previous parity to drop to zero, once for each batch of retired nodes and
+ * elements. Counters are striped by thread, and padded to a cache line each,
+ * so readers running in different threads don't contend for them. The
+ * struct is allocated aligned to a cache line.
+ *
+ * Nodes created by the running update, that are not visible to readers yet,
+ * are listed in fresh. Only these nodes are changed in place. Freshness is
+ * not stored in the nodes themselves, as published nodes must never be
+ * written, and the list is short, as an update only creates the nodes of a
+ * path.
+ */
+
+#define SB_TRIE_SYNC_STRIPES 32
+#define SB_TRIE_SYNC_MAX_RETIRED 256
+#define SB_TRIE_SYNC_CACHE_LINE 64
+
+typedef struct {
+    size_t count;
+    uint8_t padding[SB_TRIE_SYNC_CACHE_LINE - sizeof(size_t)];
+} sb_trie_sync_counter_t;
+
+// size is 0 for retired elements.
+typedef struct {
+    void *ptr;
+    size_t size;
+} sb_trie_sync_retired_t;
+
+typedef struct {
+    sb_trie_sync_counter_t readers[2][SB_TRIE_SYNC_STRIPES];
+    size_t epoch;
+    sb_trie_node_t **fresh;
+    size_t fresh_len;
+    size_t fresh_allocated_len;
+    sb_trie_sync_retired_t *retired;
+    size_t retired_len;
+    size_t retired_allocated_len;
+} sb_trie_sync_t;
+
+/*
+ * Tries can keep a blocked Bloom filter of their keys, to answer most lookups
+ * of missing keys without walking the nodes. All the bits of a key are set in
+ * the same block, a cache line, selected by the highest bits of its hash, and
+ * the positions inside the block are derived from the lowest bits with double
+ * hashing. Bits can't be cleared, so removed keys are kept in the filter as
+ * stale keys. The filter is rebuilt, with twice the capacity needed by the
+ * keys of the trie, when the filter is full, or when most of its keys are
+ * stale.
+ */
+
+#define SB_TRIE_FILTER_BLOCK_BITS 512
+#define SB_TRIE_FILTER_MIN_CAPACITY 64
+#define SB_TRIE_FILTER_MAX_HASHES 16
+
+typedef struct {
+    uint64_t *bits;
+    size_t num_bits;
+    unsigned int num_hashes;
+    size_t capacity;
+    size_t num_keys;
+    size_t stale;
+    size_t filtered;
+    size_t walked;
+} sb_trie_filter_t;
+
 struct _sb_trie_t {
     sb_trie_node_t *root;
     sb_free_func_t free_func;
+    size_t size;
+    size_t num_nodes;
+    sb_trie_arena_t arena;
+    sb_trie_sync_t *sync;
+    sb_trie_filter_t *filter;
+};
+
+/*
+ * Frozen images are pointer-free: nodes are laid out in pre-order after the
+ * header, and reference their children by offset from the start of the
+ * image. Each node record is followed by the offsets of its children, the
+ * first bytes of their edges (sorted, searched with a binary search), and the
+ * edge of the node itself. Value records (a length, the serialized bytes and
+ * a NUL byte) are stored after the nodes. Every record is 8-byte aligned, and
+ * offset 0 (the header) means "none". Images are stored in host byte order.
+ */
+
+#define SB_TRIE_IMAGE_MAGIC "SBTRIE\0\0"
+#define SB_TRIE_IMAGE_VERSION 1
+#define SB_TRIE_IMAGE_BYTE_ORDER 0x01020304
+#define SB_TRIE_IMAGE_ALIGN(x) (((x) + 7) & ~((size_t) 7))
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t size;
+    uint64_t num_keys;
+    uint64_t root;
+} sb_trie_image_header_t;
+
+typedef struct {
+    uint32_t key_len;
+    uint32_t num_children;
+    uint64_t value;
+} sb_trie_image_node_t;
+
+struct _sb_trie_image_t {
+    const uint8_t *buf;
+    size_t len;
+    void *mapped;
+    void *owned;
 };
 
+
+static inline size_t
+sb_trie_node_size(uint8_t type)
+{
+    switch (type) {
+        case SB_TRIE_NODE_4:
+            return sizeof(sb_trie_node4_t);
+        case SB_TRIE_NODE_16:
+            return sizeof(sb_trie_node16_t);
+        case SB_TRIE_NODE_48:
+            return sizeof(sb_trie_node48_t);
+        case SB_TRIE_NODE_256:
+            return sizeof(sb_trie_node256_t);
+    }
+    return sizeof(sb_trie_node_t);
+}
+
+
+static inline uint8_t*
+sb_trie_node_key(sb_trie_node_t *node)
+{
+    return (uint8_t*) node + sb_trie_node_size(node->type);
+}
+
+
+static inline size_t
+sb_trie_image_node_size(size_t key_len, size_t num_children)
+{
+    return SB_TRIE_IMAGE_ALIGN(sizeof(sb_trie_image_node_t) +
+        num_children * (sizeof(uint64_t) + 1) + key_len);
+}
+
+
+static inline const uint64_t*
+sb_trie_image_node_children(const sb_trie_image_node_t *node)
+{
+    return (const uint64_t*) (node + 1);
+}
+
+
+static inline const uint8_t*
+sb_trie_image_node_child_keys(const sb_trie_image_node_t *node)
+{
+    return (const uint8_t*) (sb_trie_image_node_children(node) +
+        node->num_children);
+}
+
+
+static inline const uint8_t*
+sb_trie_image_node_key(const sb_trie_image_node_t *node)
+{
+    return sb_trie_image_node_child_keys(node) + node->num_children;
+}
+
 #endif /* _SQUAREBALL_TRIE_PRIVATE_H */
@@ -12,7 +12,9 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include "sb-error.h"
 #include "sb-mem.h"
+#include "sb-string.h"
 
 /**
  * @file squareball/sb-trie.h
@@ -20,6 +22,25 @@
  *
  * This trie implementation is mostly designed to be used as a replacement for
  * a hash table, where the keys are always strings (arrays of \c char elements).
+ * Keys are NUL-terminated strings, but every function that receives a key has
+ * a \c _len variant, that receives an arbitrary span of bytes instead, that
+ * may contain NUL bytes (e.g. binary keys, like hashes or encoded integers).
+ *
+ * The trie is path-compressed (also known as radix or Patricia trie): chains
+ * of nodes with a single child are collapsed into a single node, that stores
+ * the whole span of bytes of the edge, making lookups of keys with long
+ * shared prefixes cheaper, both in memory and in pointer chasing. Children
+ * are stored using adaptive node layouts (sorted arrays, a SIMD-searchable
+ * array, and byte-indexed arrays), selected by the number of children, so
+ * each level of a lookup is a constant-time step.
+ *
+ * A trie can also be frozen into a read-only, pointer-free image (see
+ * @ref sb_trie_freeze), that can be written to a file and opened later
+ * without parsing or rebuilding the trie (see @ref sb_trie_image_open).
+ *
+ * Tries are not thread-safe, unless created with @ref sb_trie_new_concurrent.
+ * Concurrent tries allow lookups from any number of threads, without locks,
+ * concurrently with a single writer.
  * @example hello_trie.c
  * @{
  */
@@ -40,6 +61,53 @@ typedef struct _sb_trie_t sb_trie_t;
 typedef void (*sb_trie_foreach_func_t)(const char *key, void *data,
     void *user_data);
 
+/**
+ * Trie foreach callback function type, for keys that may contain NUL bytes.
+ *
+ * @param key        The key for current trie element. It is followed by a
+ *                   NUL byte, that is not part of the key.
+ * @param key_len    The length of the key.
+ * @param data       The data stored for the key.
+ * @param user_data  Pointer to arbitrary user data that was passed to
+ *                   @ref sb_trie_foreach_len.
+ */
+typedef void (*sb_trie_foreach_len_func_t)(const char *key, size_t key_len,
+    void *data, void *user_data);
+
+/**
+ * Trie iterator structure. It is allocated by users, usually in the stack,
+ * and initialized with @ref sb_trie_iter_init. Its members are private, and
+ * should not be accessed directly.
+ */
+typedef struct {
+    sb_trie_t *trie;
+    sb_string_t *key;
+    void *node;
+    void *frames;
+    size_t len;
+    size_t allocated_len;
+} sb_trie_iter_t;
+
+/**
+ * Frozen trie image opaque structure.
+ */
+typedef struct _sb_trie_image_t sb_trie_image_t;
+
+/**
+ * Trie serializer callback function type. Used to convert the elements of a
+ * trie into bytes, when freezing it.
+ *
+ * @param data       The data stored for the key.
+ * @param len        Return location for the length of the serialized data.
+ * @param user_data  Pointer to arbitrary user data that was passed to
+ *                   @ref sb_trie_freeze.
+ * @return           A pointer to the serialized data. It is copied to the
+ *                   image and not free'd, so it may point to the element
+ *                   itself.
+ */
+typedef const void* (*sb_trie_serialize_func_t)(void *data, size_t *len,
+    void *user_data);
+
 /**
  * Function that creates a new trie.
  *
@@ -51,6 +119,96 @@ typedef void (*sb_trie_foreach_func_t)(const char *key, void *data,
  */
 sb_trie_t* sb_trie_new(sb_free_func_t free_func);
 
+/**
+ * Function that creates a new trie from arrays of keys and elements, in a
+ * single pass. Nodes are created once, with their final layouts, instead of
+ * growing as with inserting the elements one by one, and are laid out in
+ * memory in the order of the keys.
+ * If a key is repeated, the last element wins, and the others are free'd.
+ *
+ * @param keys       The array of key strings, sorted in byte-wise order (as
+ *                   with strcmp(3)).
+ * @param values     The array of elements, in the same order of the keys.
+ *                   Elements can't be NULL.
+ * @param n          The number of keys.
+ * @param free_func  The \ref sb_free_func_t to be used to free the memory
+ *                   allocated for the elements automatically when needed. If
+ *                   NULL, the trie won't touch the elements when free'ing
+ *                   itself.
+ * @return           A new trie, or NULL if the keys are not sorted or if any
+ *                   key or element is NULL. In this case, the elements are
+ *                   not touched.
+ */
+sb_trie_t* sb_trie_build_sorted(const char *const *keys, void **values,
+    size_t n, sb_free_func_t free_func);
+
+/**
+ * Function that creates a new trie from arrays of keys, that may contain NUL
+ * bytes, and elements, in a single pass. See @ref sb_trie_build_sorted.
+ *
+ * @param keys       The array of keys, sorted in byte-wise order (as with
+ *                   memcmp(3), with shorter keys first when a key is a
+ *                   prefix of another).
+ * @param key_lens   The array of the lengths of the keys.
+ * @param values     The array of elements, in the same order of the keys.
+ *                   Elements can't be NULL.
+ * @param n          The number of keys.
+ * @param free_func  The \ref sb_free_func_t to be used to free the memory
+ *                   allocated for the elements automatically when needed. If
+ *                   NULL, the trie won't touch the elements when free'ing
+ *                   itself.
+ * @return           A new trie, or NULL if the keys are not sorted or if any
+ *                   key or element is NULL. In this case, the elements are
+ *                   not touched.
+ */
+sb_trie_t* sb_trie_build_sorted_len(const char *const *keys,
+    const size_t *key_lens, void **values, size_t n, sb_free_func_t free_func);
+
+/**
+ * Function that creates a new concurrent trie. Concurrent tries are never
+ * modified in place: the nodes changed by an update are copied, and the
+ * update is published atomically when done. The old nodes (and the old
+ * elements) are released in batches, after all the readers that could be
+ * using them are done. This makes updates more expensive, and the updates
+ * that release a batch wait for the readers that started before them.
+ *
+ * @ref sb_trie_lookup, @ref sb_trie_longest_prefix, @ref sb_trie_foreach,
+ * @ref sb_trie_foreach_prefix, @ref sb_trie_size and @ref sb_trie_freeze can
+ * be called from any thread, at any time. Other functions change the trie,
+ * and must not be called by more than one thread at a time (e.g. they can be
+ * guarded by a mutex, that readers don't need to use). Elements returned by
+ * lookups can be free'd by concurrent updates, unless they are used in a
+ * read-side critical section (see @ref sb_trie_read_lock).
+ *
+ * @param free_func  The \ref sb_free_func_t to be used to free the memory
+ *                   allocated for the elements automatically when needed. If
+ *                   NULL, the trie won't touch the elements when free'ing
+ *                   itself.
+ * @return           A new concurrent trie, or NULL if concurrent tries are
+ *                   not supported by the platform.
+ */
+sb_trie_t* sb_trie_new_concurrent(sb_free_func_t free_func);
+
+/**
+ * Function that starts a read-side critical section on a concurrent trie.
+ * Nodes and elements seen inside the critical section are not released until
+ * it ends. Critical sections can be nested, and should be short, because
+ * updates wait for them. The trie must not be changed by the thread while in
+ * a critical section. This is a no-op for tries that are not concurrent.
+ *
+ * @param trie  The trie.
+ * @return      A token, to be passed to @ref sb_trie_read_unlock.
+ */
+unsigned int sb_trie_read_lock(sb_trie_t *trie);
+
+/**
+ * Function that ends a read-side critical section on a concurrent trie.
+ *
+ * @param trie   The trie.
+ * @param token  The token returned by @ref sb_trie_read_lock.
+ */
+void sb_trie_read_unlock(sb_trie_t *trie, unsigned int token);
+
 /**
  * Function that frees the memory allocated for a trie, and for its elements
  * (using the free function provided when creating the trie).
@@ -68,10 +226,57 @@ void sb_trie_free(sb_trie_t *trie);
  * @param key   The key string.
  * @param data  The data to be stored for the key. Users should not free it
  *              explicitly if the tree was initialized with a valid free
- *              function.
+ *              function. If NULL, nothing is inserted (see
+ *              @ref sb_trie_get_slot).
  */
 void sb_trie_insert(sb_trie_t *trie, const char *key, void *data);
 
+/**
+ * Function that inserts an element on the trie, with a key that may contain
+ * NUL bytes. See @ref sb_trie_insert.
+ *
+ * @param trie     The trie.
+ * @param key      The key.
+ * @param key_len  The length of the key.
+ * @param data     The data to be stored for the key.
+ */
+void sb_trie_insert_len(sb_trie_t *trie, const char *key, size_t key_len,
+    void *data);
+
+/**
+ * Function that returns a pointer to the location where the data of a given
+ * key is stored, inserting the key if needed, with NULL data. This allows
+ * read-modify-write operations (e.g. counters, memoization) with a single
+ * lookup, and storing NULL data.
+ *
+ * The data stored in the location is handled like the data given to
+ * @ref sb_trie_insert: it is free'd when replaced by @ref sb_trie_insert or
+ * removed, but not when changed directly through the location.
+ *
+ * @param trie     The trie. Concurrent tries are not supported.
+ * @param key      The key string.
+ * @param created  Return location for \c true if the key was inserted, or
+ *                 \c false if it already existed, or NULL.
+ * @return         The location of the data of the key, valid until the trie
+ *                 is modified, or NULL on error.
+ */
+void** sb_trie_get_slot(sb_trie_t *trie, const char *key, bool *created);
+
+/**
+ * Function that returns a pointer to the location where the data of a given
+ * key, that may contain NUL bytes, is stored. See @ref sb_trie_get_slot.
+ *
+ * @param trie     The trie. Concurrent tries are not supported.
+ * @param key      The key.
+ * @param key_len  The length of the key.
+ * @param created  Return location for \c true if the key was inserted, or
+ *                 \c false if it already existed, or NULL.
+ * @return         The location of the data of the key, valid until the trie
+ *                 is modified, or NULL on error.
+ */
+void** sb_trie_get_slot_len(sb_trie_t *trie, const char *key, size_t key_len,
+    bool *created);
+
 /**
  * Function that searches the trie for a given key, and return its data.
  *
@@ -82,7 +287,73 @@ void sb_trie_insert(sb_trie_t *trie, const char *key, void *data);
 void* sb_trie_lookup(sb_trie_t *trie, const char *key);
 
 /**
- * Function that returns the size of a given trie.
+ * Function that searches the trie for a given key, that may contain NUL
+ * bytes, and return its data.
+ *
+ * @param trie     The trie.
+ * @param key      The key to be looked for.
+ * @param key_len  The length of the key.
+ * @return         The data stored for the given key, if found, otherwise NULL.
+ */
+void* sb_trie_lookup_len(sb_trie_t *trie, const char *key, size_t key_len);
+
+/**
+ * Function that removes an element from the trie. Its element is free'd
+ * (using the free function provided when creating the trie), and the nodes
+ * that are not needed anymore are released.
+ *
+ * @param trie  The trie.
+ * @param key   The key string to be removed.
+ * @return      \c true if the key was found and removed, otherwise \c false.
+ */
+bool sb_trie_remove(sb_trie_t *trie, const char *key);
+
+/**
+ * Function that removes an element from the trie, with a key that may contain
+ * NUL bytes. See @ref sb_trie_remove.
+ *
+ * @param trie     The trie.
+ * @param key      The key to be removed.
+ * @param key_len  The length of the key.
+ * @return         \c true if the key was found and removed, otherwise
+ *                 \c false.
+ */
+bool sb_trie_remove_len(sb_trie_t *trie, const char *key, size_t key_len);
+
+/**
+ * Function that searches the trie for the longest key that is a prefix of a
+ * given string, and return its data. This is useful for routing-table style
+ * lookups.
+ *
+ * @param trie         The trie.
+ * @param key          The string to be looked for.
+ * @param matched_len  Return location for the length of the matched key, or
+ *                     NULL. Set to 0 if no key matched.
+ * @return             The data stored for the longest matched key, if found,
+ *                     otherwise NULL.
+ */
+void* sb_trie_longest_prefix(sb_trie_t *trie, const char *key,
+    size_t *matched_len);
+
+/**
+ * Function that searches the trie for the longest key that is a prefix of a
+ * given span of bytes, that may contain NUL bytes, and return its data. See
+ * @ref sb_trie_longest_prefix.
+ *
+ * @param trie         The trie.
+ * @param key          The span of bytes to be looked for.
+ * @param key_len      The length of the span of bytes.
+ * @param matched_len  Return location for the length of the matched key, or
+ *                     NULL. Set to 0 if no key matched.
+ * @return             The data stored for the longest matched key, if found,
+ *                     otherwise NULL.
+ */
+void* sb_trie_longest_prefix_len(sb_trie_t *trie, const char *key,
+    size_t key_len, size_t *matched_len);
+
+/**
+ * Function that returns the size of a given trie. This is a constant time
+ * operation.
  *
  * @param trie  The trie.
  * @return      The size of the given trie.
@@ -90,7 +361,61 @@ void* sb_trie_lookup(sb_trie_t *trie, const char *key);
 size_t sb_trie_size(sb_trie_t *trie);
 
 /**
- * Function that calls a given function for each element of a trie.
+ * Function that returns the memory used by a given trie, for capacity
+ * planning purposes. Memory allocated by users for the elements is not
+ * included.
+ *
+ * @param trie   The trie.
+ * @param nodes  Return location for the number of nodes of the trie, or NULL.
+ * @param bytes  Return location for the number of bytes allocated for the
+ *               trie, including memory reserved for nodes to be created, or
+ *               NULL.
+ */
+void sb_trie_memory_usage(sb_trie_t *trie, size_t *nodes, size_t *bytes);
+
+/**
+ * Function that enables an approximate membership filter (a Bloom filter) on
+ * a given trie, so most lookups and removals of keys that are not in the
+ * trie return without walking it, at the cost of some memory (2.5 to 5
+ * bytes per key for a 1% false positive rate, as the filter is sized for
+ * twice the keys of the trie). The filter is kept up to date by the
+ * functions that change the trie, and resized as needed. If the
+ * filter is already enabled, it is rebuilt with the new false positive rate.
+ * Concurrent tries don't support filters.
+ *
+ * @param trie     The trie.
+ * @param fp_rate  The approximate maximum rate of lookups of missing keys
+ *                 that are not rejected by the filter, e.g. 0.01. Must be
+ *                 greater than 0 and lower than 1.
+ * @return         \c true if the filter was enabled, otherwise \c false.
+ */
+bool sb_trie_enable_filter(sb_trie_t *trie, double fp_rate);
+
+/**
+ * Function that disables the approximate membership filter of a given trie,
+ * releasing its memory, if enabled.
+ *
+ * @param trie  The trie.
+ */
+void sb_trie_disable_filter(sb_trie_t *trie);
+
+/**
+ * Function that returns statistics of the approximate membership filter of a
+ * given trie, to evaluate if it is worth its memory. Counters are reset when
+ * the filter is disabled.
+ *
+ * @param trie      The trie.
+ * @param filtered  Return location for the number of lookups answered by the
+ *                  filter, without walking the trie, or NULL.
+ * @param walked    Return location for the number of lookups that had to walk
+ *                  the trie, because the key is in the trie, or is a false
+ *                  positive, or NULL.
+ */
+void sb_trie_filter_stats(sb_trie_t *trie, size_t *filtered, size_t *walked);
+
+/**
+ * Function that calls a given function for each element of a trie. Elements
+ * are visited in lexicographic (byte-wise) order of their keys.
  *
  * @param trie       The trie.
  * @param func       The function that should be called for each element.
@@ -99,6 +424,223 @@ size_t sb_trie_size(sb_trie_t *trie);
 void sb_trie_foreach(sb_trie_t *trie, sb_trie_foreach_func_t func,
     void *user_data);
 
+/**
+ * Function that calls a given function for each element of a trie, with the
+ * length of its key, that may contain NUL bytes. See @ref sb_trie_foreach.
+ *
+ * @param trie       The trie.
+ * @param func       The function that should be called for each element.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ */
+void sb_trie_foreach_len(sb_trie_t *trie, sb_trie_foreach_len_func_t func,
+    void *user_data);
+
+/**
+ * Function that calls a given function for each element of a trie whose key
+ * starts with a given prefix. Only the subtree that matches the prefix is
+ * visited. Elements are visited in lexicographic (byte-wise) order of their
+ * keys.
+ *
+ * @param trie       The trie.
+ * @param prefix     The prefix string.
+ * @param func       The function that should be called for each element.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ */
+void sb_trie_foreach_prefix(sb_trie_t *trie, const char *prefix,
+    sb_trie_foreach_func_t func, void *user_data);
+
+/**
+ * Function that calls a given function for each element of a trie whose key
+ * starts with a given prefix, that may contain NUL bytes. See
+ * @ref sb_trie_foreach_prefix.
+ *
+ * @param trie        The trie.
+ * @param prefix      The prefix.
+ * @param prefix_len  The length of the prefix.
+ * @param func        The function that should be called for each element.
+ * @param user_data   Pointer to arbitrary user data to be passed to \c func.
+ */
+void sb_trie_foreach_prefix_len(sb_trie_t *trie, const char *prefix,
+    size_t prefix_len, sb_trie_foreach_len_func_t func, void *user_data);
+
+/**
+ * Function that initializes an iterator, that returns the elements of a
+ * trie in lexicographic (byte-wise) order of their keys, starting at the
+ * first element. Unlike @ref sb_trie_foreach, the iteration can be paused
+ * and resumed at any time, or moved to another key (see
+ * @ref sb_trie_iter_seek), without walking the trie again from the start.
+ *
+ * The trie must not be modified while the iterator is used. To resume an
+ * iteration after modifying the trie, seek to the last key returned. For
+ * concurrent tries, the iterator must be used while holding a read lock
+ * (see @ref sb_trie_read_lock).
+ *
+ * @param iter  The iterator.
+ * @param trie  The trie.
+ */
+void sb_trie_iter_init(sb_trie_iter_t *iter, sb_trie_t *trie);
+
+/**
+ * Function that moves an iterator to the first element whose key is equal
+ * to or greater than a given key. This is a single descent of the trie,
+ * making it cheap to start iterating from any point (e.g. to return a page
+ * of elements).
+ *
+ * @param iter  The iterator.
+ * @param key   The key string.
+ */
+void sb_trie_iter_seek(sb_trie_iter_t *iter, const char *key);
+
+/**
+ * Function that moves an iterator to the first element whose key, that may
+ * contain NUL bytes, is equal to or greater than a given key. See
+ * @ref sb_trie_iter_seek.
+ *
+ * @param iter     The iterator.
+ * @param key      The key.
+ * @param key_len  The length of the key.
+ */
+void sb_trie_iter_seek_len(sb_trie_iter_t *iter, const char *key,
+    size_t key_len);
+
+/**
+ * Function that returns the next element of an iterator.
+ *
+ * @param iter     The iterator.
+ * @param key      Return location for the key of the element, or NULL. It is
+ *                 followed by a NUL byte, and is valid until the iterator is
+ *                 used again.
+ * @param key_len  Return location for the length of the key, or NULL.
+ * @param data     Return location for the data stored for the key, or NULL.
+ * @return         \c true if an element was returned, or \c false if the
+ *                 iteration is over.
+ */
+bool sb_trie_iter_next(sb_trie_iter_t *iter, const char **key,
+    size_t *key_len, void **data);
+
+/**
+ * Function that frees the memory allocated by an iterator. The iterator
+ * itself is not free'd, and may be initialized again.
+ *
+ * @param iter  The iterator.
+ */
+void sb_trie_iter_clear(sb_trie_iter_t *iter);
+
+/**
+ * Function that freezes a trie into a compact, read-only image, that does not
+ * contain any pointers, and can be written to a file (e.g. with
+ * @ref sb_file_put_contents) to be opened later with
+ * @ref sb_trie_image_open. The trie is not modified.
+ *
+ * @param trie       The trie.
+ * @param func       The function that should be called to serialize each
+ *                   element. It may be called more than once for each
+ *                   element. If NULL, elements are handled as
+ *                   NUL-terminated strings.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ * @param len        Return location for the length of the image.
+ * @return           A newly allocated image, that should be free'd with
+ *                   free(3).
+ */
+char* sb_trie_freeze(sb_trie_t *trie, sb_trie_serialize_func_t func,
+    void *user_data, size_t *len);
+
+/**
+ * Function that creates a frozen trie image object from a buffer, as returned
+ * by @ref sb_trie_freeze. The buffer is not copied, and must outlive the
+ * image object.
+ *
+ * @param buf  The buffer.
+ * @param len  The length of the buffer.
+ * @param err  Return location for a @ref sb_error_t, or NULL.
+ * @return     A new frozen trie image object, or NULL if the buffer does not
+ *             contain a valid image.
+ */
+sb_trie_image_t* sb_trie_image_new(const void *buf, size_t len,
+    sb_error_t **err);
+
+/**
+ * Function that opens a file that contains a frozen trie image. The file is
+ * mapped into memory, if supported by the platform, so it is loaded on
+ * demand, as the image is used. Otherwise, it is read into memory.
+ *
+ * @param path  The file path.
+ * @param err   Return location for a @ref sb_error_t, or NULL.
+ * @return      A new frozen trie image object, or NULL on error.
+ */
+sb_trie_image_t* sb_trie_image_open(const char *path, sb_error_t **err);
+
+/**
+ * Function that frees the memory allocated for a frozen trie image object,
+ * and unmaps its file, if needed.
+ *
+ * @param image  The frozen trie image object.
+ */
+void sb_trie_image_free(sb_trie_image_t *image);
+
+/**
+ * Function that searches a frozen trie image for a given key, and return its
+ * serialized data.
+ *
+ * @param image  The frozen trie image object.
+ * @param key    The key string to be looked for.
+ * @param len    Return location for the length of the serialized data, or
+ *               NULL.
+ * @return       A pointer to the serialized data stored for the given key
+ *               (followed by a NUL byte), if found, otherwise NULL. It is
+ *               read-only, and valid while the image object is not free'd.
+ */
+const void* sb_trie_image_lookup(sb_trie_image_t *image, const char *key,
+    size_t *len);
+
+/**
+ * Function that searches a frozen trie image for a given key, that may
+ * contain NUL bytes, and return its serialized data. See
+ * @ref sb_trie_image_lookup.
+ *
+ * @param image    The frozen trie image object.
+ * @param key      The key to be looked for.
+ * @param key_len  The length of the key.
+ * @param len      Return location for the length of the serialized data, or
+ *                 NULL.
+ * @return         A pointer to the serialized data stored for the given key,
+ *                 if found, otherwise NULL.
+ */
+const void* sb_trie_image_lookup_len(sb_trie_image_t *image, const char *key,
+    size_t key_len, size_t *len);
+
+/**
+ * Function that returns the number of elements of a frozen trie image.
+ *
+ * @param image  The frozen trie image object.
+ * @return       The number of elements.
+ */
+size_t sb_trie_image_size(sb_trie_image_t *image);
+
+/**
+ * Function that calls a given function for each element of a frozen trie
+ * image, with its serialized data, that must not be modified. Elements are
+ * visited in lexicographic (byte-wise) order of their keys.
+ *
+ * @param image      The frozen trie image object.
+ * @param func       The function that should be called for each element.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ */
+void sb_trie_image_foreach(sb_trie_image_t *image, sb_trie_foreach_func_t func,
+    void *user_data);
+
+/**
+ * Function that calls a given function for each element of a frozen trie
+ * image, with the length of its key, that may contain NUL bytes. See
+ * @ref sb_trie_image_foreach.
+ *
+ * @param image      The frozen trie image object.
+ * @param func       The function that should be called for each element.
+ * @param user_data  Pointer to arbitrary user data to be passed to \c func.
+ */
+void sb_trie_image_foreach_len(sb_trie_image_t *image,
+    sb_trie_foreach_len_func_t func, void *user_data);
+
 /** @} */
 
 #endif /* _SQUAREBALL_TRIE_H */
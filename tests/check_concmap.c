@@ -0,0 +1,224 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <squareball/sb-concmap.h>
+#include <squareball/sb-concmap-private.h>
+#include <squareball/sb-hashmap-private.h>
+#include <squareball/sb-strfuncs.h>
+#include <squareball/sb-string.h>
+
+
+static void
+test_concmap_new(void **state)
+{
+    sb_concmap_t *map = sb_concmap_new(free);
+
+    // atomic builtins are not available.
+    if (map == NULL)
+        return;
+
+    assert_int_equal(sb_concmap_num_shards(map), SB_CONCMAP_SHARDS);
+    assert_int_equal((uintptr_t) map % SB_CONCMAP_CACHE_LINE, 0);
+    for (size_t i = 0; i < SB_CONCMAP_SHARDS; i++) {
+        assert_int_equal(map->shards[i].lock, 0);
+        assert_non_null(map->shards[i].map);
+        assert_true(map->shards[i].map->free_func == free);
+    }
+    assert_int_equal(sb_concmap_size(map), 0);
+    sb_concmap_free(map);
+
+    assert_int_equal(sb_concmap_num_shards(NULL), 0);
+    assert_int_equal(sb_concmap_size(NULL), 0);
+}
+
+
+static void
+mock_lookup(void *data, void *user_data)
+{
+    sb_string_append(user_data, data);
+}
+
+
+static void
+test_concmap_insert_lookup(void **state)
+{
+    sb_concmap_t *map = sb_concmap_new(free);
+    if (map == NULL)
+        return;
+
+    sb_concmap_insert(map, "bola", sb_strdup("guda"));
+    sb_concmap_insert(map, "chu", sb_strdup("nda"));
+    sb_concmap_insert(map, "bote", sb_strdup("aba"));
+    sb_concmap_insert(map, "bola", sb_strdup("asdf"));
+    sb_concmap_insert_len(map, "a\0b", 3, sb_strdup("anb"));
+    sb_concmap_insert(map, "bo", NULL);
+    sb_concmap_insert(map, NULL, "bo");
+    assert_int_equal(sb_concmap_size(map), 4);
+
+    assert_string_equal(sb_concmap_lookup(map, "bola"), "asdf");
+    assert_string_equal(sb_concmap_lookup(map, "chu"), "nda");
+    assert_string_equal(sb_concmap_lookup(map, "bote"), "aba");
+    assert_string_equal(sb_concmap_lookup_len(map, "a\0b", 3), "anb");
+    assert_null(sb_concmap_lookup(map, "a"));
+    assert_null(sb_concmap_lookup(map, "bo"));
+    assert_null(sb_concmap_lookup(map, NULL));
+    assert_null(sb_concmap_lookup(NULL, "bola"));
+
+    sb_string_t *str = sb_string_new();
+    assert_true(sb_concmap_lookup_func(map, "bola", mock_lookup, str));
+    assert_true(sb_concmap_lookup_func(map, "chu", mock_lookup, str));
+    assert_false(sb_concmap_lookup_func(map, "bo", mock_lookup, str));
+    assert_false(sb_concmap_lookup_func(map, "bola", NULL, str));
+    assert_true(sb_concmap_lookup_func_len(map, "a\0b", 3, mock_lookup, str));
+    assert_false(sb_concmap_lookup_func_len(map, "a\0b", 2, mock_lookup, str));
+    assert_false(sb_concmap_lookup_func_len(map, NULL, 3, mock_lookup, str));
+    assert_false(sb_concmap_lookup_func(NULL, "bola", mock_lookup, str));
+    assert_string_equal(str->str, "asdfndaanb");
+    sb_string_free(str, true);
+
+    // elements are spread over the shards.
+    size_t used = 0;
+    for (size_t i = 0; i < SB_CONCMAP_SHARDS; i++)
+        used += sb_hashmap_size(map->shards[i].map) > 0;
+    assert_true(used > 1);
+
+    sb_concmap_free(map);
+}
+
+
+static void
+test_concmap_remove(void **state)
+{
+    sb_concmap_t *map = sb_concmap_new(free);
+    if (map == NULL)
+        return;
+
+    char key[16];
+    for (size_t i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        sb_concmap_insert(map, key, sb_strdup(key));
+    }
+    assert_int_equal(sb_concmap_size(map), 1000);
+
+    for (size_t i = 0; i < 1000; i += 2) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        assert_true(sb_concmap_remove(map, key));
+        assert_false(sb_concmap_remove(map, key));
+    }
+    assert_int_equal(sb_concmap_size(map), 500);
+
+    for (size_t i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        if (i % 2 == 0)
+            assert_null(sb_concmap_lookup(map, key));
+        else
+            assert_string_equal(sb_concmap_lookup(map, key), key);
+    }
+
+    assert_false(sb_concmap_remove_len(map, "key1", 3));
+    assert_true(sb_concmap_remove_len(map, "key1", 4));
+    assert_false(sb_concmap_remove(map, NULL));
+    assert_false(sb_concmap_remove(NULL, "key3"));
+    assert_int_equal(sb_concmap_size(map), 499);
+
+    sb_concmap_free(map);
+}
+
+
+static void
+mock_foreach(const char *key, void *data, void *user_data)
+{
+    assert_string_equal(key, data);
+    (*((size_t*) user_data))++;
+}
+
+
+static void
+test_concmap_foreach(void **state)
+{
+    sb_concmap_t *map = sb_concmap_new(free);
+    if (map == NULL)
+        return;
+
+    sb_concmap_insert(map, "bola", sb_strdup("bola"));
+    sb_concmap_insert(map, "chu", sb_strdup("chu"));
+    sb_concmap_insert(map, "bote", sb_strdup("bote"));
+
+    size_t counter = 0;
+    sb_concmap_foreach(map, mock_foreach, &counter);
+    assert_int_equal(counter, 3);
+    sb_concmap_foreach(map, NULL, &counter);
+    sb_concmap_foreach(NULL, mock_foreach, &counter);
+    assert_int_equal(counter, 3);
+
+    // all the locks were released.
+    for (size_t i = 0; i < SB_CONCMAP_SHARDS; i++)
+        assert_int_equal(map->shards[i].lock, 0);
+
+    sb_concmap_free(map);
+}
+
+
+static void
+test_concmap_shard_stats(void **state)
+{
+    sb_concmap_t *map = sb_concmap_new(NULL);
+    if (map == NULL)
+        return;
+
+    size_t acquisitions = 1;
+    size_t contended = 1;
+    sb_concmap_shard_stats(map, 0, &acquisitions, &contended);
+    assert_int_equal(acquisitions, 0);
+    assert_int_equal(contended, 0);
+
+    sb_concmap_insert(map, "bola", "guda");
+    assert_string_equal(sb_concmap_lookup(map, "bola"), "guda");
+    assert_true(sb_concmap_remove(map, "bola"));
+
+    size_t total = 0;
+    for (size_t i = 0; i < sb_concmap_num_shards(map); i++) {
+        sb_concmap_shard_stats(map, i, &acquisitions, &contended);
+        assert_int_equal(contended, 0);
+        total += acquisitions;
+    }
+    assert_int_equal(total, 3);
+
+    acquisitions = 1;
+    contended = 1;
+    sb_concmap_shard_stats(map, SB_CONCMAP_SHARDS, &acquisitions, &contended);
+    assert_int_equal(acquisitions, 0);
+    assert_int_equal(contended, 0);
+    sb_concmap_shard_stats(NULL, 0, &acquisitions, NULL);
+    assert_int_equal(acquisitions, 0);
+
+    sb_concmap_free(map);
+}
+
+
+int
+main(void)
+{
+    const UnitTest tests[] = {
+        unit_test(test_concmap_new),
+        unit_test(test_concmap_insert_lookup),
+        unit_test(test_concmap_remove),
+        unit_test(test_concmap_foreach),
+        unit_test(test_concmap_shard_stats),
+    };
+    return run_tests(tests);
+}
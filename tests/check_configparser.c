@@ -50,12 +50,12 @@ test_config_section_empty(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     char **k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 0);
     assert_null(k[0]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 }
 
@@ -77,14 +77,14 @@ test_config_section(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     char **k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "asd");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -101,14 +101,14 @@ test_config_section(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "asd");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -125,14 +125,14 @@ test_config_section(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "asd");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 }
 
@@ -156,7 +156,7 @@ test_config_section_multiple_keys(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -167,7 +167,7 @@ test_config_section_multiple_keys(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -186,7 +186,7 @@ test_config_section_multiple_keys(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -197,7 +197,7 @@ test_config_section_multiple_keys(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -216,7 +216,7 @@ test_config_section_multiple_keys(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -227,7 +227,7 @@ test_config_section_multiple_keys(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 }
 
@@ -255,7 +255,7 @@ test_config_section_multiple_sections(void **state)
     assert_string_equal(s[0], "foo");
     assert_string_equal(s[1], "bar");
     assert_null(s[2]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -267,13 +267,13 @@ test_config_section_multiple_sections(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     k = sb_config_list_keys(c, "bar");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "lol");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -296,7 +296,7 @@ test_config_section_multiple_sections(void **state)
     assert_string_equal(s[0], "foo");
     assert_string_equal(s[1], "bar");
     assert_null(s[2]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -308,13 +308,13 @@ test_config_section_multiple_sections(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     k = sb_config_list_keys(c, "bar");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "lol");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -337,7 +337,7 @@ test_config_section_multiple_sections(void **state)
     assert_string_equal(s[0], "foo");
     assert_string_equal(s[1], "bar");
     assert_null(s[2]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -349,13 +349,13 @@ test_config_section_multiple_sections(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     k = sb_config_list_keys(c, "bar");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "lol");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 }
 
@@ -385,7 +385,7 @@ test_config_section_list(void **state)
     assert_string_equal(s[0], "foo");
     assert_string_equal(s[1], "bar");
     assert_null(s[2]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -394,7 +394,10 @@ test_config_section_list(void **state)
     assert_string_equal(bar[0], "lol = hehe");
     assert_string_equal(bar[1], "asdasdadssad");
     assert_null(bar[2]);
-    sb_strv_free(bar);
+
+    // arrays are packed in a single allocation.
+    assert_true(bar[1] == bar[0] + 11);
+    sb_strv_free_packed(bar);
     char **k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 3);
@@ -402,7 +405,9 @@ test_config_section_list(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    assert_true(k[1] == k[0] + 4);
+    assert_true(k[2] == k[1] + 4);
+    sb_strv_free_packed(k);
     k = sb_config_list_keys(c, "bar");
     assert_null(k);
     sb_config_free(c);
@@ -428,7 +433,7 @@ test_config_section_list(void **state)
     assert_string_equal(s[0], "foo");
     assert_string_equal(s[1], "bar");
     assert_null(s[2]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -437,7 +442,7 @@ test_config_section_list(void **state)
     assert_string_equal(bar[0], "lol = hehe");
     assert_string_equal(bar[1], "asdasdadssad");
     assert_null(bar[2]);
-    sb_strv_free(bar);
+    sb_strv_free_packed(bar);
     k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 3);
@@ -445,7 +450,7 @@ test_config_section_list(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     k = sb_config_list_keys(c, "bar");
     assert_null(k);
     sb_config_free(c);
@@ -471,7 +476,7 @@ test_config_section_list(void **state)
     assert_string_equal(s[0], "foo");
     assert_string_equal(s[1], "bar");
     assert_null(s[2]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
     assert_string_equal(sb_config_get(c, "foo", "zxc"), "vbn");
@@ -480,7 +485,7 @@ test_config_section_list(void **state)
     assert_string_equal(bar[0], "lol = hehe");
     assert_string_equal(bar[1], "asdasdadssad");
     assert_null(bar[2]);
-    sb_strv_free(bar);
+    sb_strv_free_packed(bar);
     k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 3);
@@ -488,7 +493,7 @@ test_config_section_list(void **state)
     assert_string_equal(k[1], "qwe");
     assert_string_equal(k[2], "zxc");
     assert_null(k[3]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     k = sb_config_list_keys(c, "bar");
     assert_null(k);
     sb_config_free(c);
@@ -520,7 +525,7 @@ test_config_quoted_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     char **k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 9);
@@ -534,7 +539,7 @@ test_config_quoted_values(void **state)
     assert_string_equal(k[7], "h");
     assert_string_equal(k[8], "i");
     assert_null(k[9]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     assert_string_equal(sb_config_get(c, "foo", "a"), "lol");
     assert_string_equal(sb_config_get(c, "foo", "b"), "lo\"l");
     assert_string_equal(sb_config_get(c, "foo", "c"), "lo'l");
@@ -574,7 +579,7 @@ test_config_quoted_values(void **state)
     assert_string_equal(s[0], "foo");
     assert_string_equal(s[1], "bar");
     assert_null(s[2]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     char **bar = sb_config_get_list(c, "foo");
     assert_string_equal(bar[0], "lol");
     assert_string_equal(bar[1], "lo\"l");
@@ -586,13 +591,13 @@ test_config_quoted_values(void **state)
     assert_string_equal(bar[7], "\\asd");
     assert_string_equal(bar[8], "'\\asd'");
     assert_null(bar[9]);
-    sb_strv_free(bar);
+    sb_strv_free_packed(bar);
     bar = sb_config_get_list(c, "bar");
     assert_non_null(bar);
     assert_string_equal(bar[0], "'lol = hehe'");
     assert_string_equal(bar[1], "  asdasdadssad  ");
     assert_null(bar[2]);
-    sb_strv_free(bar);
+    sb_strv_free_packed(bar);
     k = sb_config_list_keys(c, "foo");
     assert_null(k);
     k = sb_config_list_keys(c, "bar");
@@ -618,14 +623,14 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "");
     char **k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "asd");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -642,14 +647,14 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "");
     k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "asd");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -667,7 +672,7 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "foo");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "");
     k = sb_config_list_keys(c, "foo");
@@ -676,7 +681,7 @@ test_config_empty_values(void **state)
     assert_string_equal(k[0], "asd");
     assert_string_equal(k[1], "qwe");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -694,7 +699,7 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "foo");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "");
     k = sb_config_list_keys(c, "foo");
@@ -703,7 +708,7 @@ test_config_empty_values(void **state)
     assert_string_equal(k[0], "asd");
     assert_string_equal(k[1], "qwe");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -721,7 +726,7 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "foo");
     k = sb_config_list_keys(c, "foo");
@@ -730,7 +735,7 @@ test_config_empty_values(void **state)
     assert_string_equal(k[0], "asd");
     assert_string_equal(k[1], "qwe");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -748,7 +753,7 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "foo");
     k = sb_config_list_keys(c, "foo");
@@ -757,7 +762,7 @@ test_config_empty_values(void **state)
     assert_string_equal(k[0], "asd");
     assert_string_equal(k[1], "qwe");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -774,14 +779,14 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "");
     k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "asd");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -798,14 +803,14 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "");
     k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 1);
     assert_string_equal(k[0], "asd");
     assert_null(k[1]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -823,7 +828,7 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "foo");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "");
     k = sb_config_list_keys(c, "foo");
@@ -832,7 +837,7 @@ test_config_empty_values(void **state)
     assert_string_equal(k[0], "asd");
     assert_string_equal(k[1], "qwe");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -850,7 +855,7 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "foo");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "");
     k = sb_config_list_keys(c, "foo");
@@ -859,7 +864,7 @@ test_config_empty_values(void **state)
     assert_string_equal(k[0], "asd");
     assert_string_equal(k[1], "qwe");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -877,7 +882,7 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "foo");
     k = sb_config_list_keys(c, "foo");
@@ -886,7 +891,7 @@ test_config_empty_values(void **state)
     assert_string_equal(k[0], "asd");
     assert_string_equal(k[1], "qwe");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     sb_config_free(c);
 
     a =
@@ -904,7 +909,7 @@ test_config_empty_values(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     assert_string_equal(sb_config_get(c, "foo", "asd"), "");
     assert_string_equal(sb_config_get(c, "foo", "qwe"), "foo");
     k = sb_config_list_keys(c, "foo");
@@ -913,7 +918,42 @@ test_config_empty_values(void **state)
     assert_string_equal(k[0], "asd");
     assert_string_equal(k[1], "qwe");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
+    sb_config_free(c);
+}
+
+
+static void
+test_config_filter(void **state)
+{
+    const char *a =
+        "[foo]\n"
+        "asd = zxc\n"
+        "qwe = rty\n"
+        "\n"
+        "[bar]\n"
+        "lol = hehe\n";
+    sb_error_t *err = NULL;
+    const char *sections[] = {"bar", NULL};
+    sb_config_t *c = sb_config_parse(a, strlen(a), sections, &err);
+    assert_null(err);
+    assert_non_null(c);
+    assert_false(sb_config_enable_filter(NULL, 0.01));
+    assert_false(sb_config_enable_filter(c, 0));
+    assert_true(sb_config_enable_filter(c, 0.01));
+    assert_string_equal(sb_config_get(c, "foo", "asd"), "zxc");
+    assert_string_equal(sb_config_get(c, "foo", "qwe"), "rty");
+    assert_null(sb_config_get(c, "foo", "zxc"));
+    assert_null(sb_config_get(c, "baz", "asd"));
+    assert_null(sb_config_get(c, "bar", "lol"));
+    char **bar = sb_config_get_list(c, "bar");
+    assert_non_null(bar);
+    assert_string_equal(bar[0], "lol = hehe");
+    assert_null(bar[1]);
+    sb_strv_free_packed(bar);
+    size_t filtered, walked;
+    sb_trie_filter_stats(c->root, &filtered, &walked);
+    assert_int_equal(filtered + walked, 6);
     sb_config_free(c);
 }
 
@@ -936,20 +976,106 @@ test_config_key_prefix(void **state)
     assert_int_equal(sb_strv_length(s), 1);
     assert_string_equal(s[0], "foo");
     assert_null(s[1]);
-    sb_strv_free(s);
+    sb_strv_free_packed(s);
     char **k = sb_config_list_keys(c, "foo");
     assert_non_null(k);
     assert_int_equal(sb_strv_length(k), 2);
     assert_string_equal(k[0], "LAST_FLIGHT");
     assert_string_equal(k[1], "LAST_FLIGHT_SLUG");
     assert_null(k[2]);
-    sb_strv_free(k);
+    sb_strv_free_packed(k);
     assert_string_equal(sb_config_get(c, "foo", "LAST_FLIGHT"), "lol");
     assert_string_equal(sb_config_get(c, "foo", "LAST_FLIGHT_SLUG"), "hehe");
     sb_config_free(c);
 }
 
 
+static void
+test_config_order(void **state)
+{
+    const char *a =
+        "[zxc]\n"
+        "zxc = vbn\n"
+        "asd = zxc\n"
+        "qwe = rty\n"
+        "asd = qwe\n"
+        "[asd]\n"
+        "b = 1\n"
+        "a = 2\n"
+        "[zxc]\n"
+        "qwe = asd\n"
+        "zx = cv\n";
+    sb_error_t *err = NULL;
+    sb_config_t *c = sb_config_parse(a, strlen(a), NULL, &err);
+    assert_null(err);
+    assert_non_null(c);
+    assert_int_equal(sb_trie_size(c->root), 2);
+    char **s = sb_config_list_sections(c);
+    assert_non_null(s);
+    assert_int_equal(sb_strv_length(s), 2);
+    assert_string_equal(s[0], "zxc");
+    assert_string_equal(s[1], "asd");
+    assert_null(s[2]);
+    sb_strv_free_packed(s);
+    char **k = sb_config_list_keys(c, "asd");
+    assert_non_null(k);
+    assert_int_equal(sb_strv_length(k), 2);
+    assert_string_equal(k[0], "b");
+    assert_string_equal(k[1], "a");
+    assert_null(k[2]);
+    sb_strv_free_packed(k);
+
+    // sections found again replace the previous ones.
+    k = sb_config_list_keys(c, "zxc");
+    assert_non_null(k);
+    assert_int_equal(sb_strv_length(k), 2);
+    assert_string_equal(k[0], "qwe");
+    assert_string_equal(k[1], "zx");
+    assert_null(k[2]);
+    sb_strv_free_packed(k);
+    assert_null(sb_config_get(c, "zxc", "asd"));
+    sb_config_free(c);
+
+    // keys found again keep their positions.
+    a =
+        "[foo]\n"
+        "zxc = vbn\n"
+        "asd = zxc\n"
+        "zxc = rty\n";
+    c = sb_config_parse(a, strlen(a), NULL, &err);
+    assert_null(err);
+    assert_non_null(c);
+    k = sb_config_list_keys(c, "foo");
+    assert_non_null(k);
+    assert_int_equal(sb_strv_length(k), 2);
+    assert_string_equal(k[0], "zxc");
+    assert_string_equal(k[1], "asd");
+    assert_null(k[2]);
+    sb_strv_free_packed(k);
+    assert_string_equal(sb_config_get(c, "foo", "zxc"), "rty");
+    sb_config_free(c);
+
+    // keys that share prefixes are not grouped.
+    a =
+        "[foo]\n"
+        "ab = 1\n"
+        "c = 2\n"
+        "aa = 3\n";
+    c = sb_config_parse(a, strlen(a), NULL, &err);
+    assert_null(err);
+    assert_non_null(c);
+    k = sb_config_list_keys(c, "foo");
+    assert_non_null(k);
+    assert_int_equal(sb_strv_length(k), 3);
+    assert_string_equal(k[0], "ab");
+    assert_string_equal(k[1], "c");
+    assert_string_equal(k[2], "aa");
+    assert_null(k[3]);
+    sb_strv_free_packed(k);
+    sb_config_free(c);
+}
+
+
 static void
 test_config_error_start(void **state)
 {
@@ -1025,7 +1151,9 @@ main(void)
         unit_test(test_config_section_list),
         unit_test(test_config_quoted_values),
         unit_test(test_config_empty_values),
+        unit_test(test_config_filter),
         unit_test(test_config_key_prefix),
+        unit_test(test_config_order),
         unit_test(test_config_error_start),
         unit_test(test_config_error_section_with_newline),
         unit_test(test_config_error_key_without_value),
@@ -0,0 +1,279 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <squareball/sb-hashmap.h>
+#include <squareball/sb-hashmap-private.h>
+#include <squareball/sb-strfuncs.h>
+#include <squareball/sb-string.h>
+
+
+static void
+test_hashmap_new(void **state)
+{
+    sb_hashmap_t *map = sb_hashmap_new(free);
+    assert_non_null(map);
+    assert_null(map->ctrl);
+    assert_null(map->slots);
+    assert_int_equal(map->capacity, 0);
+    assert_int_equal(map->size, 0);
+    assert_true(map->free_func == free);
+    assert_null(sb_hashmap_lookup(map, "bola"));
+    assert_false(sb_hashmap_remove(map, "bola"));
+    sb_hashmap_free(map);
+}
+
+
+static void
+test_hashmap_insert(void **state)
+{
+    sb_hashmap_t *map = sb_hashmap_new(free);
+
+    sb_hashmap_insert(map, "bola", sb_strdup("guda"));
+    assert_int_equal(map->capacity, SB_HASHMAP_GROUP_WIDTH);
+    assert_int_equal(map->size, 1);
+    sb_hashmap_insert(map, "chu", sb_strdup("nda"));
+    sb_hashmap_insert(map, "bote", sb_strdup("aba"));
+    sb_hashmap_insert(map, "bo", sb_strdup("haha"));
+    sb_hashmap_insert(map, "", sb_strdup("empty"));
+    assert_int_equal(sb_hashmap_size(map), 5);
+
+    // replaced elements are free'd.
+    sb_hashmap_insert(map, "bola", sb_strdup("asdf"));
+    assert_int_equal(sb_hashmap_size(map), 5);
+
+    assert_string_equal(sb_hashmap_lookup(map, "bola"), "asdf");
+    assert_string_equal(sb_hashmap_lookup(map, "chu"), "nda");
+    assert_string_equal(sb_hashmap_lookup(map, "bote"), "aba");
+    assert_string_equal(sb_hashmap_lookup(map, "bo"), "haha");
+    assert_string_equal(sb_hashmap_lookup(map, ""), "empty");
+    assert_null(sb_hashmap_lookup(map, "b"));
+    assert_null(sb_hashmap_lookup(map, "bolaa"));
+
+    sb_hashmap_insert(map, "bola", NULL);
+    assert_string_equal(sb_hashmap_lookup(map, "bola"), "asdf");
+    sb_hashmap_insert(map, NULL, "bola");
+    assert_int_equal(sb_hashmap_size(map), 5);
+
+    sb_hashmap_free(map);
+
+    sb_hashmap_insert(NULL, "bola", NULL);
+    assert_null(sb_hashmap_lookup(NULL, "bola"));
+    assert_null(sb_hashmap_lookup(map, NULL));
+    assert_int_equal(sb_hashmap_size(NULL), 0);
+}
+
+
+static void
+test_hashmap_keep_data(void **state)
+{
+    sb_hashmap_t *map = sb_hashmap_new(NULL);
+
+    char *t1 = "guda";
+    char *t2 = "nda";
+
+    sb_hashmap_insert(map, "bola", t1);
+    sb_hashmap_insert(map, "chu", t2);
+    sb_hashmap_insert(map, "chu", t1);
+    assert_true(sb_hashmap_remove(map, "bola"));
+
+    sb_hashmap_free(map);
+
+    assert_string_equal(t1, "guda");
+    assert_string_equal(t2, "nda");
+}
+
+
+static void
+test_hashmap_binary_keys(void **state)
+{
+    sb_hashmap_t *map = sb_hashmap_new(free);
+
+    sb_hashmap_insert_len(map, "a\0b", 3, sb_strdup("anb"));
+    sb_hashmap_insert_len(map, "a\0c", 3, sb_strdup("anc"));
+    sb_hashmap_insert_len(map, "a\0", 2, sb_strdup("an"));
+    sb_hashmap_insert(map, "a", sb_strdup("a"));
+    assert_int_equal(sb_hashmap_size(map), 4);
+
+    assert_string_equal(sb_hashmap_lookup_len(map, "a\0b", 3), "anb");
+    assert_string_equal(sb_hashmap_lookup_len(map, "a\0c", 3), "anc");
+    assert_string_equal(sb_hashmap_lookup_len(map, "a\0", 2), "an");
+    assert_string_equal(sb_hashmap_lookup_len(map, "a", 1), "a");
+    assert_null(sb_hashmap_lookup_len(map, "a\0d", 3));
+    assert_null(sb_hashmap_lookup_len(map, "", 0));
+
+    assert_false(sb_hashmap_remove_len(map, "a\0d", 3));
+    assert_true(sb_hashmap_remove_len(map, "a\0", 2));
+    assert_null(sb_hashmap_lookup_len(map, "a\0", 2));
+    assert_string_equal(sb_hashmap_lookup_len(map, "a\0b", 3), "anb");
+    assert_int_equal(sb_hashmap_size(map), 3);
+
+    sb_hashmap_free(map);
+}
+
+
+static void
+test_hashmap_remove(void **state)
+{
+    sb_hashmap_t *map = sb_hashmap_new(free);
+
+    sb_hashmap_insert(map, "bola", sb_strdup("guda"));
+    sb_hashmap_insert(map, "chu", sb_strdup("nda"));
+    sb_hashmap_insert(map, "bote", sb_strdup("aba"));
+
+    assert_false(sb_hashmap_remove(map, "bolaa"));
+    assert_false(sb_hashmap_remove(map, NULL));
+    assert_false(sb_hashmap_remove(NULL, "bola"));
+    assert_true(sb_hashmap_remove(map, "bola"));
+    assert_false(sb_hashmap_remove(map, "bola"));
+    assert_int_equal(sb_hashmap_size(map), 2);
+    assert_null(sb_hashmap_lookup(map, "bola"));
+    assert_string_equal(sb_hashmap_lookup(map, "chu"), "nda");
+    assert_string_equal(sb_hashmap_lookup(map, "bote"), "aba");
+
+    // slots of small tables are never in the middle of a full group, so they
+    // don't need tombstones.
+    for (size_t i = 0; i < map->capacity; i++)
+        assert_int_not_equal(map->ctrl[i], SB_HASHMAP_CTRL_DELETED);
+
+    assert_true(sb_hashmap_remove(map, "chu"));
+    assert_true(sb_hashmap_remove(map, "bote"));
+    assert_int_equal(sb_hashmap_size(map), 0);
+    assert_int_equal(map->growth_left, 14);
+
+    sb_hashmap_free(map);
+}
+
+
+static void
+test_hashmap_grow(void **state)
+{
+    sb_hashmap_t *map = sb_hashmap_new(free);
+
+    // the load factor is 7/8.
+    char key[16];
+    for (size_t i = 0; i < 14; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        sb_hashmap_insert(map, key, sb_strdup(key));
+    }
+    assert_int_equal(map->capacity, 16);
+    assert_int_equal(map->growth_left, 0);
+    sb_hashmap_insert(map, "key14", sb_strdup("key14"));
+    assert_int_equal(map->capacity, 32);
+    assert_int_equal(map->growth_left, 13);
+
+    for (size_t i = 15; i < 10000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        sb_hashmap_insert(map, key, sb_strdup(key));
+    }
+    assert_int_equal(sb_hashmap_size(map), 10000);
+    assert_int_equal(map->capacity, 16384);
+
+    // the mirrored control bytes are kept in sync.
+    for (size_t i = 0; i < SB_HASHMAP_GROUP_WIDTH; i++)
+        assert_int_equal(map->ctrl[map->capacity + i], map->ctrl[i]);
+
+    for (size_t i = 0; i < 10000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        assert_string_equal(sb_hashmap_lookup(map, key), key);
+    }
+    for (size_t i = 0; i < 10000; i += 2) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        assert_true(sb_hashmap_remove(map, key));
+    }
+    assert_int_equal(sb_hashmap_size(map), 5000);
+    for (size_t i = 0; i < 10000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        if (i % 2 == 0)
+            assert_null(sb_hashmap_lookup(map, key));
+        else
+            assert_string_equal(sb_hashmap_lookup(map, key), key);
+    }
+
+    // churn must not grow the table, tombstones are reused or dropped.
+    for (size_t i = 0; i < 100000; i++) {
+        snprintf(key, sizeof(key), "churn%zu", i);
+        sb_hashmap_insert(map, key, sb_strdup(key));
+        assert_true(sb_hashmap_remove(map, key));
+    }
+    assert_int_equal(sb_hashmap_size(map), 5000);
+    assert_int_equal(map->capacity, 16384);
+
+    sb_hashmap_free(map);
+}
+
+
+static void
+mock_foreach(const char *key, void *data, void *user_data)
+{
+    assert_string_equal(key, data);
+    (*((size_t*) user_data))++;
+}
+
+
+static void
+mock_foreach_len(const char *key, size_t key_len, void *data, void *user_data)
+{
+    assert_int_equal(key[key_len], 0);
+    assert_memory_equal(key, data, key_len + 1);
+    (*((size_t*) user_data)) += key_len;
+}
+
+
+static void
+test_hashmap_foreach(void **state)
+{
+    sb_hashmap_t *map = sb_hashmap_new(free);
+    size_t counter = 0;
+
+    sb_hashmap_foreach(map, mock_foreach, &counter);
+    assert_int_equal(counter, 0);
+
+    sb_hashmap_insert(map, "bola", sb_strdup("bola"));
+    sb_hashmap_insert(map, "chu", sb_strdup("chu"));
+    sb_hashmap_insert(map, "bote", sb_strdup("bote"));
+    sb_hashmap_insert(map, "bo", sb_strdup("bo"));
+    assert_true(sb_hashmap_remove(map, "bote"));
+
+    sb_hashmap_foreach(map, mock_foreach, &counter);
+    assert_int_equal(counter, 3);
+
+    counter = 0;
+    sb_hashmap_foreach_len(map, mock_foreach_len, &counter);
+    assert_int_equal(counter, 9);
+
+    sb_hashmap_foreach(map, NULL, &counter);
+    sb_hashmap_foreach(NULL, mock_foreach, &counter);
+    assert_int_equal(counter, 9);
+
+    sb_hashmap_free(map);
+}
+
+
+int
+main(void)
+{
+    const UnitTest tests[] = {
+        unit_test(test_hashmap_new),
+        unit_test(test_hashmap_insert),
+        unit_test(test_hashmap_keep_data),
+        unit_test(test_hashmap_binary_keys),
+        unit_test(test_hashmap_remove),
+        unit_test(test_hashmap_grow),
+        unit_test(test_hashmap_foreach),
+    };
+    return run_tests(tests);
+}
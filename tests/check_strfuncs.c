@@ -14,6 +14,7 @@
 #include <stdlib.h>
 
 #include <squareball/sb-strfuncs.h>
+#include <squareball/sb-strview.h>
 
 
 static void
@@ -57,6 +58,24 @@ test_strdup_printf(void **state)
 }
 
 
+static void
+test_str_concat(void **state)
+{
+    char *str = sb_str_concat(3, "bola", "guda", "chunda");
+    assert_string_equal(str, "bolagudachunda");
+    free(str);
+    str = sb_str_concat(4, "bola", NULL, "", "guda");
+    assert_string_equal(str, "bolaguda");
+    free(str);
+    str = sb_str_concat(1, NULL);
+    assert_string_equal(str, "");
+    free(str);
+    str = sb_str_concat(0);
+    assert_string_equal(str, "");
+    free(str);
+}
+
+
 static void
 test_str_starts_with(void **state)
 {
@@ -153,23 +172,86 @@ test_str_split(void **state)
     assert_string_equal(strv[1], "guda");
     assert_string_equal(strv[2], "chunda");
     assert_null(strv[3]);
-    sb_strv_free(strv);
+    sb_strv_free_packed(strv);
     strv = sb_str_split("bola:guda:chunda", ':', 2);
     assert_string_equal(strv[0], "bola");
     assert_string_equal(strv[1], "guda:chunda");
     assert_null(strv[2]);
-    sb_strv_free(strv);
+    sb_strv_free_packed(strv);
     strv = sb_str_split("bola:guda:chunda", ':', 1);
     assert_string_equal(strv[0], "bola:guda:chunda");
     assert_null(strv[1]);
-    sb_strv_free(strv);
+    sb_strv_free_packed(strv);
     strv = sb_str_split("", ':', 1);
     assert_null(strv[0]);
-    sb_strv_free(strv);
+    sb_strv_free_packed(strv);
+    strv = sb_str_split(":bola::guda:", ':', 0);
+    assert_string_equal(strv[0], "");
+    assert_string_equal(strv[1], "bola");
+    assert_string_equal(strv[2], "");
+    assert_string_equal(strv[3], "guda");
+    assert_string_equal(strv[4], "");
+    assert_null(strv[5]);
+
+    // pieces are stored after each other, in a single allocation.
+    assert_true(strv[1] == strv[0] + 1);
+    assert_true(strv[4] == strv[3] + 5);
+    sb_strv_free_packed(strv);
+    strv = sb_str_split("bola", ':', 0);
+    assert_string_equal(strv[0], "bola");
+    assert_null(strv[1]);
+    sb_strv_free_packed(strv);
     assert_null(sb_str_split(NULL, ':', 0));
 }
 
 
+static void
+test_str_split_iter(void **state)
+{
+    const char *str = "bola:guda::chunda:";
+    sb_str_split_iter_t iter;
+    sb_strview_t piece;
+    sb_str_split_iter_init(&iter, str, ':', 0);
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_true(piece.str == str);
+    assert_int_equal(piece.len, 4);
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_true(piece.str == str + 5);
+    assert_int_equal(piece.len, 4);
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_int_equal(piece.len, 0);
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_true(sb_strview_equal(piece, sb_strview("chunda")));
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_true(piece.str == str + 18);
+    assert_int_equal(piece.len, 0);
+    assert_false(sb_str_split_iter_next(&iter, &piece));
+    assert_false(sb_str_split_iter_next(&iter, &piece));
+
+    sb_str_split_iter_init(&iter, str, ':', 2);
+    assert_true(sb_str_split_iter_next(&iter, NULL));
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_true(sb_strview_equal(piece, sb_strview("guda::chunda:")));
+    assert_false(sb_str_split_iter_next(&iter, &piece));
+
+    // not nul-terminated, and with nul bytes.
+    sb_str_split_iter_init_len(&iter, "bo\0la\nguda\nchunda", 11, '\n', 0);
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_true(sb_strview_equal(piece, sb_strview_len("bo\0la", 5)));
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_true(sb_strview_equal(piece, sb_strview("guda")));
+    assert_true(sb_str_split_iter_next(&iter, &piece));
+    assert_int_equal(piece.len, 0);
+    assert_false(sb_str_split_iter_next(&iter, &piece));
+
+    sb_str_split_iter_init(&iter, "", ':', 0);
+    assert_false(sb_str_split_iter_next(&iter, &piece));
+    sb_str_split_iter_init(&iter, NULL, ':', 0);
+    assert_false(sb_str_split_iter_next(&iter, &piece));
+    assert_false(sb_str_split_iter_next(NULL, &piece));
+}
+
+
 static void
 test_str_replace(void **state)
 {
@@ -182,6 +264,21 @@ test_str_replace(void **state)
     str = sb_str_replace("bolao", 'b', NULL);
     assert_string_equal(str, "bolao");
     free(str);
+    str = sb_str_replace("bolao", 'o', "");
+    assert_string_equal(str, "bla");
+    free(str);
+    str = sb_str_replace("ooo", 'o', "ab");
+    assert_string_equal(str, "ababab");
+    free(str);
+    str = sb_str_replace("bolao", 'x', "zaz");
+    assert_string_equal(str, "bolao");
+    free(str);
+    str = sb_str_replace("bolao", '\0', "zaz");
+    assert_string_equal(str, "bolao");
+    free(str);
+    str = sb_str_replace("", 'o', "zaz");
+    assert_string_equal(str, "");
+    free(str);
     assert_null(sb_str_replace(NULL, 'b', "zaz"));
 }
 
@@ -223,6 +320,71 @@ test_str_to_bool(void **state)
 }
 
 
+static void
+test_strv_new_packed(void **state)
+{
+    sb_strview_t pieces[] = {
+        sb_strview("bola"),
+        sb_strview(""),
+        sb_strview_len("gudachunda", 4),
+    };
+    char **strv = sb_strv_new_packed(pieces, 3);
+    assert_int_equal(sb_strv_length(strv), 3);
+    assert_string_equal(strv[0], "bola");
+    assert_string_equal(strv[1], "");
+    assert_string_equal(strv[2], "guda");
+    assert_null(strv[3]);
+    assert_true(strv[1] == strv[0] + 5);
+    assert_true(strv[2] == strv[1] + 1);
+    sb_strv_free_packed(strv);
+    strv = sb_strv_new_packed(NULL, 0);
+    assert_null(strv[0]);
+    sb_strv_free_packed(strv);
+    assert_null(sb_strv_new_packed(NULL, 1));
+}
+
+
+static void
+test_strv_pack(void **state)
+{
+    char *pieces[] = {"guda", "bola", "", "chunda", NULL};
+    char **strv = sb_strv_pack(pieces);
+    assert_int_equal(sb_strv_length(strv), 4);
+    for (size_t i = 0; i < 4; i++) {
+        assert_true(strv[i] != pieces[i]);
+        assert_string_equal(strv[i], pieces[i]);
+    }
+    assert_null(strv[4]);
+    assert_true(strv[3] == strv[0] + 11);
+    char *str = sb_strv_join(strv, ":");
+    assert_string_equal(str, "guda:bola::chunda");
+    free(str);
+    sb_strv_free_packed(strv);
+    char *pieces2[] = {NULL};
+    strv = sb_strv_pack(pieces2);
+    assert_null(strv[0]);
+    sb_strv_free_packed(strv);
+    assert_null(sb_strv_pack(NULL));
+}
+
+
+static void
+test_strv_free(void **state)
+{
+    // arrays that are not stored in a single allocation.
+    char **strv = malloc(3 * sizeof(char*));
+    strv[0] = sb_strdup("bola");
+    strv[1] = sb_strdup("guda");
+    strv[2] = NULL;
+    sb_strv_free(strv);
+    strv = malloc(sizeof(char*));
+    strv[0] = NULL;
+    sb_strv_free(strv);
+    sb_strv_free(NULL);
+    sb_strv_free_packed(NULL);
+}
+
+
 static void
 test_strv_join(void **state)
 {
@@ -234,6 +396,13 @@ test_strv_join(void **state)
     str = sb_strv_join(pieces2, ":");
     assert_string_equal(str, "");
     free(str);
+    char *pieces3[] = {"", "bola", "", NULL};
+    str = sb_strv_join(pieces3, ", ");
+    assert_string_equal(str, ", bola, ");
+    free(str);
+    str = sb_strv_join(pieces, "");
+    assert_string_equal(str, "gudabolachunda");
+    free(str);
     assert_null(sb_strv_join(pieces, NULL));
     assert_null(sb_strv_join(NULL, ":"));
     assert_null(sb_strv_join(NULL, NULL));
@@ -258,15 +427,20 @@ main(void)
         unit_test(test_strdup),
         unit_test(test_strndup),
         unit_test(test_strdup_printf),
+        unit_test(test_str_concat),
         unit_test(test_str_starts_with),
         unit_test(test_str_ends_with),
         unit_test(test_str_lstrip),
         unit_test(test_str_rstrip),
         unit_test(test_str_strip),
         unit_test(test_str_split),
+        unit_test(test_str_split_iter),
         unit_test(test_str_replace),
         unit_test(test_str_find),
         unit_test(test_str_to_bool),
+        unit_test(test_strv_new_packed),
+        unit_test(test_strv_pack),
+        unit_test(test_strv_free),
         unit_test(test_strv_join),
         unit_test(test_strv_length),
     };
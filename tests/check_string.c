@@ -12,6 +12,7 @@
 #include <cmocka.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <squareball/sb-strfuncs.h>
 #include <squareball/sb-string.h>
@@ -26,7 +27,45 @@ test_string_new(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "");
     assert_int_equal(str->len, 0);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
+    assert_true(str->str == str->small_str);
+    assert_null(sb_string_free(str, true));
+}
+
+
+static void
+test_string_new_sized(void **state)
+{
+    sb_string_t *str = sb_string_new_sized(10);
+    assert_non_null(str);
+    assert_string_equal(str->str, "");
+    assert_int_equal(str->len, 0);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
+    assert_true(str->str == str->small_str);
+    assert_null(sb_string_free(str, true));
+    str = sb_string_new_sized(100);
+    assert_string_equal(str->str, "");
+    assert_int_equal(str->len, 0);
+    assert_int_equal(str->allocated_len, 101);
+    char *buf = str->str;
+    for (size_t i = 0; i < 9; i++)
+        str = sb_string_append(str, "bolaguda");
+    str = sb_string_append_len(str, "bolagudachu", 10);
+    assert_int_equal(str->len, 82);
+    str = sb_string_append(str, "bolagudach");
+    assert_int_equal(str->len, 92);
+    str = sb_string_append(str, "bolaguda");
+    assert_int_equal(str->len, 100);
+    assert_int_equal(str->allocated_len, 101);
+    assert_true(str->str == buf);
+    str = sb_string_append_c(str, 'u');
+    assert_int_equal(str->len, 101);
+    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE * 2);
+    assert_string_equal(str->str + 82, "bolagudachbolagudau");
+    assert_null(sb_string_free(str, true));
+    str = sb_string_new_sized(0);
+    assert_string_equal(str->str, "");
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
 }
 
@@ -35,13 +74,18 @@ static void
 test_string_free(void **state)
 {
     sb_string_t *str = sb_string_new();
-    free(str->str);
-    str->str = sb_strdup("bola");
-    str->len = 4;
-    str->allocated_len = SB_STRING_CHUNK_SIZE;
+    str = sb_string_append(str, "bola");
     char *tmp = sb_string_free(str, false);
     assert_string_equal(tmp, "bola");
     free(tmp);
+    str = sb_string_new();
+    for (size_t i = 0; i < 10; i++)
+        str = sb_string_append(str, "bolaguda");
+    char *buf = str->str;
+    tmp = sb_string_free(str, false);
+    assert_true(tmp == buf);
+    assert_int_equal(strlen(tmp), 80);
+    free(tmp);
     assert_null(sb_string_free(NULL, false));
 }
 
@@ -50,15 +94,13 @@ static void
 test_string_dup(void **state)
 {
     sb_string_t *str = sb_string_new();
-    free(str->str);
-    str->str = sb_strdup("bola");
-    str->len = 4;
-    str->allocated_len = SB_STRING_CHUNK_SIZE;
+    str = sb_string_append(str, "bola");
     sb_string_t *new = sb_string_dup(str);
     assert_non_null(new);
     assert_string_equal(new->str, "bola");
     assert_int_equal(new->len, 4);
-    assert_int_equal(new->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(new->allocated_len, SB_STRING_SMALL_SIZE);
+    assert_true(new->str == new->small_str);
     assert_null(sb_string_free(new, true));
     assert_null(sb_string_free(str, true));
     assert_null(sb_string_dup(NULL));
@@ -73,7 +115,7 @@ test_string_append_len(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "guda");
     assert_int_equal(str->len, 4);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
     str = sb_string_new();
     str = sb_string_append_len(str, "guda", 4);
@@ -81,7 +123,7 @@ test_string_append_len(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "gudabola");
     assert_int_equal(str->len, 8);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
     str = sb_string_new();
     str = sb_string_append_len(str, "guda", 3);
@@ -89,7 +131,7 @@ test_string_append_len(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "gudbola");
     assert_int_equal(str->len, 7);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
     str = sb_string_new();
     str = sb_string_append_len(str, "guda", 4);
@@ -142,7 +184,7 @@ test_string_append_len(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "");
     assert_int_equal(str->len, 0);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
     assert_null(sb_string_append_len(NULL, "foo", 3));
 }
@@ -156,7 +198,7 @@ test_string_append(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "guda");
     assert_int_equal(str->len, 4);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
     str = sb_string_new();
     str = sb_string_append(str, "guda");
@@ -164,7 +206,7 @@ test_string_append(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "gudabola");
     assert_int_equal(str->len, 8);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
     str = sb_string_new();
     str = sb_string_append(str, "guda");
@@ -217,7 +259,7 @@ test_string_append(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "");
     assert_int_equal(str->len, 0);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
     assert_null(sb_string_append(NULL, "asd"));
     assert_null(sb_string_append(NULL, NULL));
@@ -243,12 +285,49 @@ test_string_append_c(void **state)
         "ccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccc"
         "cccccccccccccccccccccccccccccccccccccccccccccccccccc");
     assert_int_equal(str->len, 604);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE * 5);
+    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE * 8);
     assert_null(sb_string_free(str, true));
     assert_null(sb_string_append_c(NULL, 0));
 }
 
 
+static void
+test_string_append_grow(void **state)
+{
+    sb_string_t *str = sb_string_new();
+    size_t reallocs = 0;
+    size_t allocated_len = str->allocated_len;
+    for (size_t i = 0; i < 1000000; i++) {
+        str = sb_string_append_c(str, 'a' + i % 26);
+        if (str->allocated_len != allocated_len) {
+            assert_true(str->allocated_len >= 2 * allocated_len);
+            allocated_len = str->allocated_len;
+            reallocs++;
+        }
+    }
+    assert_int_equal(str->len, 1000000);
+    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE * 8192);
+    assert_int_equal(reallocs, 14);
+    assert_int_equal(str->str[999999], 'a' + 999999 % 26);
+    assert_int_equal(str->str[1000000], '\0');
+    assert_null(sb_string_free(str, true));
+
+    // big appends are allocated as is, rounded to the chunk size.
+    char *buf = malloc(10000);
+    for (size_t i = 0; i < 10000; i++)
+        buf[i] = 'a' + i % 26;
+    str = sb_string_new();
+    str = sb_string_append_len(str, buf, 10000);
+    assert_int_equal(str->len, 10000);
+    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE * 79);
+    str = sb_string_append_len(str, buf, 200);
+    assert_int_equal(str->len, 10200);
+    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE * 158);
+    assert_null(sb_string_free(str, true));
+    free(buf);
+}
+
+
 static void
 test_string_append_printf(void **state)
 {
@@ -260,12 +339,60 @@ test_string_append_printf(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "guda: bola 1");
     assert_int_equal(str->len, 12);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
+
+    // fills the inline buffer exactly.
+    str = sb_string_append_printf(str, "%026d", 42);
+    assert_int_equal(str->len, 38);
+    str = sb_string_append_printf(str, "%c", 'a');
+    assert_int_equal(str->len, 39);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
+    assert_string_equal(str->str,
+        "guda: bola 100000000000000000000000042a");
+
+    // doesn't fit, formatted again after growing.
+    str = sb_string_append_printf(str, "%s-%0100d", "bola", 0);
+    assert_int_equal(str->len, 144);
+    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE * 2);
+    assert_true(sb_str_starts_with(str->str + 39, "bola-0000"));
+    assert_int_equal(str->str[143], '0');
+    assert_int_equal(str->str[144], '\0');
+    for (size_t i = 0; i < 1000; i++)
+        str = sb_string_append_printf(str, "%zu,", i);
+    assert_int_equal(str->len, 144 + 10 * 2 + 90 * 3 + 900 * 4);
+    assert_true(sb_str_ends_with(str->str, ",997,998,999,"));
     assert_null(sb_string_free(str, true));
     assert_null(sb_string_append_printf(NULL, "asd"));
 }
 
 
+static sb_string_t*
+mock_append_vprintf(sb_string_t *str, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    str = sb_string_append_vprintf(str, format, ap);
+    va_end(ap);
+    return str;
+}
+
+
+static void
+test_string_append_vprintf(void **state)
+{
+    sb_string_t *str = sb_string_new();
+    str = mock_append_vprintf(str, NULL);
+    assert_string_equal(str->str, "");
+    str = mock_append_vprintf(str, "guda: %s %d", "bola", 1);
+    str = mock_append_vprintf(str, " %0100d", 2);
+    assert_int_equal(str->len, 113);
+    assert_true(sb_str_starts_with(str->str, "guda: bola 1 000"));
+    assert_true(sb_str_ends_with(str->str, "0002"));
+    assert_null(sb_string_free(str, true));
+    assert_null(mock_append_vprintf(NULL, "asd"));
+}
+
+
 static void
 test_string_append_escaped(void **state)
 {
@@ -274,29 +401,95 @@ test_string_append_escaped(void **state)
     assert_non_null(str);
     assert_string_equal(str->str, "");
     assert_int_equal(str->len, 0);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     str = sb_string_append_escaped(str, "foo \\a bar \\\\ lol");
     assert_non_null(str);
     assert_string_equal(str->str, "foo a bar \\ lol");
     assert_int_equal(str->len, 15);
-    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
     assert_null(sb_string_free(str, true));
     assert_null(sb_string_append_escaped(NULL, "asd"));
 }
 
 
+static void
+test_string_reserve(void **state)
+{
+    sb_string_t *str = sb_string_new();
+    str = sb_string_append(str, "bola");
+    str = sb_string_reserve(str, 10);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
+    assert_true(str->str == str->small_str);
+    str = sb_string_reserve(str, 200);
+    assert_string_equal(str->str, "bola");
+    assert_int_equal(str->len, 4);
+    assert_int_equal(str->allocated_len, 205);
+    char *buf = str->str;
+    for (size_t i = 0; i < 200; i++)
+        str = sb_string_append_c(str, 'a');
+    assert_int_equal(str->len, 204);
+    assert_int_equal(str->allocated_len, 205);
+    assert_true(str->str == buf);
+    str = sb_string_reserve(str, 0);
+    assert_int_equal(str->allocated_len, 205);
+    assert_null(sb_string_free(str, true));
+    assert_null(sb_string_reserve(NULL, 10));
+}
+
+
+static void
+test_string_shrink_to_fit(void **state)
+{
+    sb_string_t *str = sb_string_new();
+    str = sb_string_shrink_to_fit(str);
+    assert_string_equal(str->str, "");
+    assert_int_equal(str->len, 0);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
+    for (size_t i = 0; i < 10; i++)
+        str = sb_string_append(str, "gudabola");
+    assert_int_equal(str->allocated_len, SB_STRING_CHUNK_SIZE);
+    str = sb_string_shrink_to_fit(str);
+    assert_int_equal(str->len, 80);
+    assert_int_equal(str->allocated_len, 81);
+    assert_string_equal(str->str + 72, "gudabola");
+    str = sb_string_shrink_to_fit(str);
+    assert_int_equal(str->allocated_len, 81);
+    str = sb_string_append_c(str, 'c');
+    assert_string_equal(str->str + 72, "gudabolac");
+    assert_null(sb_string_free(str, true));
+
+    // strings that fit are moved back to the object.
+    str = sb_string_new();
+    for (size_t i = 0; i < 10; i++)
+        str = sb_string_append(str, "gudabola");
+    str->len = 8;
+    str = sb_string_shrink_to_fit(str);
+    assert_int_equal(str->allocated_len, SB_STRING_SMALL_SIZE);
+    assert_true(str->str == str->small_str);
+    str = sb_string_append_c(str, 'c');
+    assert_string_equal(str->str, "gudabolac");
+    assert_null(sb_string_free(str, true));
+    assert_null(sb_string_shrink_to_fit(NULL));
+}
+
+
 int
 main(void)
 {
     const UnitTest tests[] = {
         unit_test(test_string_new),
+        unit_test(test_string_new_sized),
         unit_test(test_string_free),
         unit_test(test_string_dup),
         unit_test(test_string_append_len),
         unit_test(test_string_append),
         unit_test(test_string_append_c),
+        unit_test(test_string_append_grow),
         unit_test(test_string_append_printf),
+        unit_test(test_string_append_vprintf),
         unit_test(test_string_append_escaped),
+        unit_test(test_string_reserve),
+        unit_test(test_string_shrink_to_fit),
     };
     return run_tests(tests);
 }
@@ -0,0 +1,214 @@
+/*
+ * squareball: A general-purpose library for C99.
+ * Copyright (C) 2014-2018 Rafael G. Martins <rafael@rafaelmartins.eng.br>
+ *
+ * This program can be distributed under the terms of the BSD License.
+ * See the file LICENSE.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <squareball/sb-strview.h>
+
+
+static void
+test_strview(void **state)
+{
+    const char *str = "bolaguda";
+    sb_strview_t v = sb_strview(str);
+    assert_true(v.str == str);
+    assert_int_equal(v.len, 8);
+    v = sb_strview("");
+    assert_non_null(v.str);
+    assert_int_equal(v.len, 0);
+    v = sb_strview(NULL);
+    assert_null(v.str);
+    assert_int_equal(v.len, 0);
+    v = sb_strview_len(str, 4);
+    assert_true(v.str == str);
+    assert_int_equal(v.len, 4);
+    v = sb_strview_len(NULL, 4);
+    assert_null(v.str);
+    assert_int_equal(v.len, 0);
+}
+
+
+static void
+test_strview_slice(void **state)
+{
+    const char *str = "bolaguda";
+    sb_strview_t v = sb_strview_slice(sb_strview(str), 2, 4);
+    assert_true(v.str == str + 2);
+    assert_int_equal(v.len, 4);
+    v = sb_strview_slice(sb_strview(str), 4, 10);
+    assert_true(v.str == str + 4);
+    assert_int_equal(v.len, 4);
+    v = sb_strview_slice(sb_strview(str), 10, 10);
+    assert_true(v.str == str + 8);
+    assert_int_equal(v.len, 0);
+    v = sb_strview_slice(sb_strview(NULL), 1, 2);
+    assert_null(v.str);
+    assert_int_equal(v.len, 0);
+}
+
+
+static void
+test_strview_dup(void **state)
+{
+    char *str = sb_strview_dup(sb_strview_len("bolaguda", 4));
+    assert_string_equal(str, "bola");
+    free(str);
+    str = sb_strview_dup(sb_strview_len("bola\0guda", 9));
+    assert_memory_equal(str, "bola\0guda", 10);
+    free(str);
+    str = sb_strview_dup(sb_strview(""));
+    assert_string_equal(str, "");
+    free(str);
+    assert_null(sb_strview_dup(sb_strview(NULL)));
+}
+
+
+static void
+test_strview_equal(void **state)
+{
+    assert_true(sb_strview_equal(sb_strview("bola"),
+        sb_strview_len("bolaguda", 4)));
+    assert_false(sb_strview_equal(sb_strview("bola"),
+        sb_strview_len("bolaguda", 5)));
+    assert_false(sb_strview_equal(sb_strview("bola"), sb_strview("guda")));
+    assert_true(sb_strview_equal(sb_strview(""), sb_strview(NULL)));
+    assert_true(sb_strview_compare(sb_strview("bola"),
+        sb_strview_len("bolaguda", 4)) == 0);
+    assert_true(sb_strview_compare(sb_strview("bola"),
+        sb_strview("bolaguda")) < 0);
+    assert_true(sb_strview_compare(sb_strview("bolaguda"),
+        sb_strview("bola")) > 0);
+    assert_true(sb_strview_compare(sb_strview("bolb"),
+        sb_strview("bolaguda")) > 0);
+    assert_true(sb_strview_compare(sb_strview(""), sb_strview("a")) < 0);
+    assert_true(sb_strview_compare(sb_strview(NULL), sb_strview("")) == 0);
+}
+
+
+static void
+test_strview_starts_with(void **state)
+{
+    sb_strview_t v = sb_strview_len("bolaguda", 6);
+    assert_true(sb_strview_starts_with(v, sb_strview("bola")));
+    assert_true(sb_strview_starts_with(v, sb_strview("bolagu")));
+    assert_false(sb_strview_starts_with(v, sb_strview("bolagud")));
+    assert_false(sb_strview_starts_with(v, sb_strview("guda")));
+    assert_true(sb_strview_starts_with(v, sb_strview("")));
+    assert_true(sb_strview_starts_with(sb_strview(NULL), sb_strview("")));
+    assert_false(sb_strview_starts_with(sb_strview(NULL), sb_strview("a")));
+}
+
+
+static void
+test_strview_ends_with(void **state)
+{
+    sb_strview_t v = sb_strview_len("bolaguda", 6);
+    assert_true(sb_strview_ends_with(v, sb_strview("agu")));
+    assert_true(sb_strview_ends_with(v, sb_strview("bolagu")));
+    assert_false(sb_strview_ends_with(v, sb_strview("guda")));
+    assert_false(sb_strview_ends_with(v, sb_strview("abolagu")));
+    assert_true(sb_strview_ends_with(v, sb_strview("")));
+    assert_false(sb_strview_ends_with(sb_strview(NULL), sb_strview("a")));
+}
+
+
+static void
+test_strview_strip(void **state)
+{
+    const char *str = " \t\n\r\f\vbola guda \t\n\r\f\v";
+    sb_strview_t v = sb_strview_lstrip(sb_strview(str));
+    assert_true(v.str == str + 6);
+    assert_int_equal(v.len, 15);
+    v = sb_strview_rstrip(sb_strview(str));
+    assert_true(v.str == str);
+    assert_int_equal(v.len, 15);
+    v = sb_strview_strip(sb_strview(str));
+    assert_true(v.str == str + 6);
+    assert_int_equal(v.len, 9);
+    assert_memory_equal(v.str, "bola guda", 9);
+
+    // only the view is stripped, not the whole string.
+    v = sb_strview_strip(sb_strview_len("  bola  guda", 8));
+    assert_true(sb_strview_equal(v, sb_strview("bola")));
+    v = sb_strview_strip(sb_strview("  \t\n "));
+    assert_int_equal(v.len, 0);
+    v = sb_strview_strip(sb_strview(NULL));
+    assert_null(v.str);
+    assert_int_equal(v.len, 0);
+}
+
+
+static void
+test_strview_find(void **state)
+{
+    const char *str = "bola\\ gu da";
+    sb_strview_t v = sb_strview(str);
+    assert_true(sb_strview_find(v, 'l') == str + 2);
+    assert_true(sb_strview_find(v, ' ') == str + 8);
+    assert_null(sb_strview_find(sb_strview_len(str, 8), ' '));
+    assert_null(sb_strview_find(v, 'x'));
+    assert_null(sb_strview_find(sb_strview(NULL), 'x'));
+    str = "bola\0guda";
+    assert_true(sb_strview_find(sb_strview_len(str, 9), 'g') == str + 5);
+}
+
+
+static void
+test_strview_split(void **state)
+{
+    const char *str = "bola:guda::chunda";
+    sb_strview_t head, tail;
+    assert_true(sb_strview_split(sb_strview(str), ':', &head, &tail));
+    assert_true(sb_strview_equal(head, sb_strview("bola")));
+    assert_true(sb_strview_equal(tail, sb_strview("guda::chunda")));
+    assert_true(sb_strview_split(tail, ':', &head, &tail));
+    assert_true(sb_strview_equal(head, sb_strview("guda")));
+    assert_true(sb_strview_split(tail, ':', &head, &tail));
+    assert_int_equal(head.len, 0);
+    assert_false(sb_strview_split(tail, ':', &head, &tail));
+    assert_true(sb_strview_equal(head, sb_strview("chunda")));
+    assert_true(tail.str == str + 17);
+    assert_int_equal(tail.len, 0);
+
+    // the view ends before the separator.
+    assert_false(sb_strview_split(sb_strview_len(str, 4), ':', &head, NULL));
+    assert_true(sb_strview_equal(head, sb_strview("bola")));
+    assert_true(sb_strview_split(sb_strview_len(str, 5), ':', NULL, &tail));
+    assert_true(tail.str == str + 5);
+    assert_int_equal(tail.len, 0);
+
+    assert_false(sb_strview_split(sb_strview(NULL), ':', &head, &tail));
+    assert_null(head.str);
+    assert_int_equal(head.len, 0);
+    assert_null(tail.str);
+    assert_int_equal(tail.len, 0);
+}
+
+
+int
+main(void)
+{
+    const UnitTest tests[] = {
+        unit_test(test_strview),
+        unit_test(test_strview_slice),
+        unit_test(test_strview_dup),
+        unit_test(test_strview_equal),
+        unit_test(test_strview_starts_with),
+        unit_test(test_strview_ends_with),
+        unit_test(test_strview_strip),
+        unit_test(test_strview_find),
+        unit_test(test_strview_split),
+    };
+    return run_tests(tests);
+}
@@ -11,8 +11,13 @@
 #include <setjmp.h>
 #include <cmocka.h>
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include <squareball/sb-error.h>
+#include <squareball/sb-file.h>
 #include <squareball/sb-trie.h>
 #include <squareball/sb-trie-private.h>
 #include <squareball/sb-strfuncs.h>
@@ -26,6 +31,8 @@ test_trie_new(void **state)
     assert_non_null(trie);
     assert_null(trie->root);
     assert_true(trie->free_func == free);
+    assert_int_equal(trie->size, 0);
+    assert_int_equal(trie->num_nodes, 0);
     sb_trie_free(trie);
 }
 
@@ -34,199 +41,105 @@ static void
 test_trie_insert(void **state)
 {
     sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_node4_t *root;
+    sb_trie_node4_t *bo;
 
     sb_trie_insert(trie, "bola", sb_strdup("guda"));
-    assert_true(trie->root->key == 'b');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'o');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'l');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == 'a');
-    assert_null(trie->root->child->child->child->data);
-    assert_true(trie->root->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->data, "guda");
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.type, SB_TRIE_NODE_4);
+    assert_int_equal(root->base.key_len, 0);
+    assert_null(root->base.data);
+    assert_int_equal(root->base.num_children, 1);
+    assert_int_equal(root->keys[0], 'b');
+    assert_int_equal(root->children[0]->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(root->children[0]->key_len, 4);
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "bola", 4);
+    assert_string_equal(root->children[0]->data, "guda");
 
 
     sb_trie_insert(trie, "chu", sb_strdup("nda"));
-    assert_true(trie->root->key == 'b');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'o');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'l');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == 'a');
-    assert_null(trie->root->child->child->child->data);
-    assert_true(trie->root->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->data, "guda");
-
-    assert_true(trie->root->next->key == 'c');
-    assert_null(trie->root->next->data);
-    assert_true(trie->root->next->child->key == 'h');
-    assert_null(trie->root->next->child->data);
-    assert_true(trie->root->next->child->child->key == 'u');
-    assert_null(trie->root->next->child->child->data);
-    assert_true(trie->root->next->child->child->child->key == '\0');
-    assert_string_equal(trie->root->next->child->child->child->data, "nda");
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.num_children, 2);
+    assert_int_equal(root->keys[0], 'b');
+    assert_int_equal(root->children[0]->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(root->children[0]->key_len, 4);
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "bola", 4);
+    assert_string_equal(root->children[0]->data, "guda");
+    assert_int_equal(root->keys[1], 'c');
+    assert_int_equal(root->children[1]->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(root->children[1]->key_len, 3);
+    assert_memory_equal(sb_trie_node_key(root->children[1]), "chu", 3);
+    assert_string_equal(root->children[1]->data, "nda");
 
 
     sb_trie_insert(trie, "bote", sb_strdup("aba"));
-    assert_true(trie->root->key == 'b');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'o');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'l');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == 'a');
-    assert_null(trie->root->child->child->child->data);
-    assert_true(trie->root->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->data, "guda");
-
-    assert_true(trie->root->next->key == 'c');
-    assert_null(trie->root->next->data);
-    assert_true(trie->root->next->child->key == 'h');
-    assert_null(trie->root->next->child->data);
-    assert_true(trie->root->next->child->child->key == 'u');
-    assert_null(trie->root->next->child->child->data);
-    assert_true(trie->root->next->child->child->child->key == '\0');
-    assert_string_equal(trie->root->next->child->child->child->data, "nda");
-
-    assert_true(trie->root->child->child->next->key == 't');
-    assert_null(trie->root->child->child->next->data);
-    assert_true(trie->root->child->child->next->child->key == 'e');
-    assert_null(trie->root->child->child->next->child->data);
-    assert_true(trie->root->child->child->next->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->next->child->child->data, "aba");
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.num_children, 2);
+    assert_int_equal(root->keys[0], 'b');
+    bo = (sb_trie_node4_t*) root->children[0];
+    assert_int_equal(bo->base.type, SB_TRIE_NODE_4);
+    assert_int_equal(bo->base.key_len, 2);
+    assert_memory_equal(sb_trie_node_key(&bo->base), "bo", 2);
+    assert_null(bo->base.data);
+    assert_int_equal(bo->base.num_children, 2);
+    assert_int_equal(bo->keys[0], 'l');
+    assert_int_equal(bo->children[0]->key_len, 2);
+    assert_memory_equal(sb_trie_node_key(bo->children[0]), "la", 2);
+    assert_string_equal(bo->children[0]->data, "guda");
+    assert_int_equal(bo->keys[1], 't');
+    assert_int_equal(bo->children[1]->key_len, 2);
+    assert_memory_equal(sb_trie_node_key(bo->children[1]), "te", 2);
+    assert_string_equal(bo->children[1]->data, "aba");
+    assert_int_equal(root->keys[1], 'c');
+    assert_memory_equal(sb_trie_node_key(root->children[1]), "chu", 3);
+    assert_string_equal(root->children[1]->data, "nda");
 
 
     sb_trie_insert(trie, "bo", sb_strdup("haha"));
-    assert_true(trie->root->key == 'b');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'o');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'l');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == 'a');
-    assert_null(trie->root->child->child->child->data);
-    assert_true(trie->root->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->data, "guda");
-
-    assert_true(trie->root->next->key == 'c');
-    assert_null(trie->root->next->data);
-    assert_true(trie->root->next->child->key == 'h');
-    assert_null(trie->root->next->child->data);
-    assert_true(trie->root->next->child->child->key == 'u');
-    assert_null(trie->root->next->child->child->data);
-    assert_true(trie->root->next->child->child->child->key == '\0');
-    assert_string_equal(trie->root->next->child->child->child->data, "nda");
-
-    assert_true(trie->root->child->child->next->key == 't');
-    assert_null(trie->root->child->child->next->data);
-    assert_true(trie->root->child->child->next->child->key == 'e');
-    assert_null(trie->root->child->child->next->child->data);
-    assert_true(trie->root->child->child->next->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->next->child->child->data, "aba");
-
-    assert_true(trie->root->child->child->next->next->key == '\0');
-    assert_string_equal(trie->root->child->child->next->next->data, "haha");
+    root = (sb_trie_node4_t*) trie->root;
+    bo = (sb_trie_node4_t*) root->children[0];
+    assert_memory_equal(sb_trie_node_key(&bo->base), "bo", 2);
+    assert_string_equal(bo->base.data, "haha");
+    assert_int_equal(bo->base.num_children, 2);
+    assert_memory_equal(sb_trie_node_key(bo->children[0]), "la", 2);
+    assert_string_equal(bo->children[0]->data, "guda");
+    assert_memory_equal(sb_trie_node_key(bo->children[1]), "te", 2);
+    assert_string_equal(bo->children[1]->data, "aba");
+    assert_memory_equal(sb_trie_node_key(root->children[1]), "chu", 3);
+    assert_string_equal(root->children[1]->data, "nda");
 
     sb_trie_free(trie);
 
 
+    // children are kept sorted, regardless of insertion order
     trie = sb_trie_new(free);
 
     sb_trie_insert(trie, "chu", sb_strdup("nda"));
-    assert_true(trie->root->key == 'c');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'h');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'u');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->data, "nda");
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.num_children, 1);
+    assert_int_equal(root->keys[0], 'c');
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "chu", 3);
+    assert_string_equal(root->children[0]->data, "nda");
 
 
     sb_trie_insert(trie, "bola", sb_strdup("guda"));
-    assert_true(trie->root->key == 'c');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'h');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'u');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->data, "nda");
-
-    assert_true(trie->root->next->key == 'b');
-    assert_null(trie->root->next->data);
-    assert_true(trie->root->next->child->key == 'o');
-    assert_null(trie->root->next->child->data);
-    assert_true(trie->root->next->child->child->key == 'l');
-    assert_null(trie->root->next->child->child->data);
-    assert_true(trie->root->next->child->child->child->key == 'a');
-    assert_null(trie->root->next->child->child->child->data);
-    assert_true(trie->root->next->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->next->child->child->child->child->data, "guda");
-
-
     sb_trie_insert(trie, "bote", sb_strdup("aba"));
-    assert_true(trie->root->key == 'c');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'h');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'u');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->data, "nda");
-
-    assert_true(trie->root->next->key == 'b');
-    assert_null(trie->root->next->data);
-    assert_true(trie->root->next->child->key == 'o');
-    assert_null(trie->root->next->child->data);
-    assert_true(trie->root->next->child->child->key == 'l');
-    assert_null(trie->root->next->child->child->data);
-    assert_true(trie->root->next->child->child->child->key == 'a');
-    assert_null(trie->root->next->child->child->child->data);
-    assert_true(trie->root->next->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->next->child->child->child->child->data, "guda");
-
-    assert_true(trie->root->next->child->child->next->key == 't');
-    assert_null(trie->root->next->child->child->next->data);
-    assert_true(trie->root->next->child->child->next->child->key == 'e');
-    assert_null(trie->root->next->child->child->next->child->data);
-    assert_true(trie->root->next->child->child->next->child->child->key == '\0');
-    assert_string_equal(trie->root->next->child->child->next->child->child->data, "aba");
-
-
     sb_trie_insert(trie, "bo", sb_strdup("haha"));
-    assert_true(trie->root->key == 'c');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'h');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'u');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->data, "nda");
-
-    assert_true(trie->root->next->key == 'b');
-    assert_null(trie->root->next->data);
-    assert_true(trie->root->next->child->key == 'o');
-    assert_null(trie->root->next->child->data);
-    assert_true(trie->root->next->child->child->key == 'l');
-    assert_null(trie->root->next->child->child->data);
-    assert_true(trie->root->next->child->child->child->key == 'a');
-    assert_null(trie->root->next->child->child->child->data);
-    assert_true(trie->root->next->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->next->child->child->child->child->data, "guda");
-
-    assert_true(trie->root->next->child->child->next->key == 't');
-    assert_null(trie->root->next->child->child->next->data);
-    assert_true(trie->root->next->child->child->next->child->key == 'e');
-    assert_null(trie->root->next->child->child->next->child->data);
-    assert_true(trie->root->next->child->child->next->child->child->key == '\0');
-    assert_string_equal(trie->root->next->child->child->next->child->child->data, "aba");
-
-    assert_true(trie->root->next->child->child->next->next->key == '\0');
-    assert_string_equal(trie->root->next->child->child->next->next->data, "haha");
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.num_children, 2);
+    assert_int_equal(root->keys[0], 'b');
+    bo = (sb_trie_node4_t*) root->children[0];
+    assert_memory_equal(sb_trie_node_key(&bo->base), "bo", 2);
+    assert_string_equal(bo->base.data, "haha");
+    assert_int_equal(bo->keys[0], 'l');
+    assert_memory_equal(sb_trie_node_key(bo->children[0]), "la", 2);
+    assert_string_equal(bo->children[0]->data, "guda");
+    assert_int_equal(bo->keys[1], 't');
+    assert_memory_equal(sb_trie_node_key(bo->children[1]), "te", 2);
+    assert_string_equal(bo->children[1]->data, "aba");
+    assert_int_equal(root->keys[1], 'c');
+    assert_memory_equal(sb_trie_node_key(root->children[1]), "chu", 3);
+    assert_string_equal(root->children[1]->data, "nda");
 
     sb_trie_free(trie);
 }
@@ -236,30 +149,22 @@ static void
 test_trie_insert_duplicated(void **state)
 {
     sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_node4_t *root;
 
     sb_trie_insert(trie, "bola", sb_strdup("guda"));
-    assert_true(trie->root->key == 'b');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'o');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'l');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == 'a');
-    assert_null(trie->root->child->child->child->data);
-    assert_true(trie->root->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->data, "guda");
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.num_children, 1);
+    assert_int_equal(root->children[0]->key_len, 4);
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "bola", 4);
+    assert_string_equal(root->children[0]->data, "guda");
 
     sb_trie_insert(trie, "bola", sb_strdup("asdf"));
-    assert_true(trie->root->key == 'b');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'o');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'l');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == 'a');
-    assert_null(trie->root->child->child->child->data);
-    assert_true(trie->root->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->data, "asdf");
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.num_children, 1);
+    assert_int_equal(root->children[0]->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(root->children[0]->key_len, 4);
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "bola", 4);
+    assert_string_equal(root->children[0]->data, "asdf");
 
     sb_trie_free(trie);
 
@@ -269,6 +174,84 @@ test_trie_insert_duplicated(void **state)
 }
 
 
+static void
+mock_foreach_slot(const char *key, void *data, void *user_data)
+{
+    sb_string_t *str = user_data;
+    sb_string_append_printf(str, "%s=%s;", key,
+        data == NULL ? "(null)" : (char*) data);
+}
+
+
+static void
+test_trie_get_slot(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    bool created = true;
+
+    assert_null(sb_trie_get_slot(NULL, "bola", &created));
+    assert_false(created);
+    created = true;
+    assert_null(sb_trie_get_slot(trie, NULL, &created));
+    assert_false(created);
+
+    void **slot = sb_trie_get_slot(trie, "bola", &created);
+    assert_non_null(slot);
+    assert_true(created);
+    assert_null(*slot);
+    *slot = sb_strdup("guda");
+    assert_int_equal(sb_trie_size(trie), 1);
+    assert_string_equal(sb_trie_lookup(trie, "bola"), "guda");
+
+    slot = sb_trie_get_slot(trie, "bola", &created);
+    assert_false(created);
+    assert_string_equal(*slot, "guda");
+
+    // splits the edge of "bola", and keeps the NULL data.
+    slot = sb_trie_get_slot(trie, "bo", &created);
+    assert_true(created);
+    assert_null(*slot);
+    slot = sb_trie_get_slot(trie, "bote", NULL);
+    *slot = sb_strdup("aba");
+    slot = sb_trie_get_slot_len(trie, "chu\0", 4, &created);
+    assert_true(created);
+    *slot = sb_strdup("nda");
+    assert_int_equal(sb_trie_size(trie), 4);
+
+    assert_null(sb_trie_lookup(trie, "bo"));
+    assert_string_equal(sb_trie_lookup(trie, "bote"), "aba");
+    assert_null(sb_trie_lookup(trie, "chu"));
+    assert_string_equal(sb_trie_lookup_len(trie, "chu\0", 4), "nda");
+
+    sb_string_t *str = sb_string_new();
+    sb_trie_foreach(trie, mock_foreach_slot, str);
+    assert_string_equal(str->str, "bo=(null);bola=guda;bote=aba;chu=nda;");
+    sb_string_free(str, true);
+
+    // replacing a key with NULL data frees nothing.
+    sb_trie_insert(trie, "bo", sb_strdup("haha"));
+    assert_int_equal(sb_trie_size(trie), 4);
+    assert_string_equal(sb_trie_lookup(trie, "bo"), "haha");
+
+    assert_true(sb_trie_remove(trie, "bola"));
+    slot = sb_trie_get_slot(trie, "bola", &created);
+    assert_true(created);
+    assert_null(*slot);
+    assert_true(sb_trie_remove(trie, "bola"));
+    assert_int_equal(sb_trie_size(trie), 3);
+
+    sb_trie_free(trie);
+
+    trie = sb_trie_new_concurrent(free);
+    if (trie != NULL) {
+        assert_null(sb_trie_get_slot(trie, "bola", &created));
+        assert_false(created);
+        assert_int_equal(sb_trie_size(trie), 0);
+        sb_trie_free(trie);
+    }
+}
+
+
 static void
 test_trie_keep_data(void **state)
 {
@@ -363,13 +346,221 @@ test_trie_size(void **state)
     assert_int_equal(sb_trie_size(trie), 7);
     assert_int_equal(sb_trie_size(NULL), 0);
 
+    sb_trie_insert(trie, "bola", sb_strdup("guda2"));
+    sb_trie_insert(trie, "", sb_strdup("empty"));
+    assert_int_equal(sb_trie_size(trie), 8);
+
+    sb_trie_free(trie);
+}
+
+
+static void
+test_trie_memory_usage(void **state)
+{
+    size_t nodes;
+    size_t bytes;
+
+    sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_memory_usage(trie, &nodes, &bytes);
+    assert_int_equal(nodes, 0);
+    assert_int_equal(bytes, sizeof(sb_trie_t));
+
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    sb_trie_insert(trie, "chu", sb_strdup("nda"));
+    sb_trie_insert(trie, "bote", sb_strdup("aba"));
+    sb_trie_insert(trie, "bo", sb_strdup("haha"));
+
+    // root, "bo", "la", "te" and "chu"
+    sb_trie_memory_usage(trie, &nodes, &bytes);
+    assert_int_equal(nodes, 5);
+    assert_int_equal(bytes, sizeof(sb_trie_t) + sizeof(sb_trie_arena_chunk_t) +
+        SB_TRIE_ARENA_MIN_CHUNK_SIZE);
+
+    sb_trie_memory_usage(trie, NULL, &bytes);
+    sb_trie_memory_usage(trie, &nodes, NULL);
+    assert_int_equal(nodes, 5);
+
     sb_trie_free(trie);
+
+    trie = sb_trie_new(NULL);
+    assert_true(sb_trie_enable_filter(trie, 0.01));
+    sb_trie_memory_usage(trie, &nodes, &bytes);
+    assert_int_equal(nodes, 0);
+    assert_int_equal(bytes, sizeof(sb_trie_t) + sizeof(sb_trie_filter_t) +
+        trie->filter->num_bits / 8);
+    sb_trie_free(trie);
+
+    sb_trie_memory_usage(NULL, &nodes, &bytes);
+    assert_int_equal(nodes, 0);
+    assert_int_equal(bytes, 0);
+}
+
+
+static void
+test_trie_memory_usage_split(void **state)
+{
+    size_t nodes;
+    size_t bytes;
+
+    // long edges are allocated individually. splitting them must release
+    // them with their original sizes, including when the remaining of the
+    // edge fits the size classes.
+    char *key = sb_malloc(2 * SB_TRIE_ARENA_MAX_CLASS_SIZE + 1);
+    memset(key, 'a', 2 * SB_TRIE_ARENA_MAX_CLASS_SIZE);
+    key[2 * SB_TRIE_ARENA_MAX_CLASS_SIZE] = '\0';
+
+    sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_insert(trie, key, sb_strdup("long"));
+    sb_trie_insert_len(trie, key, SB_TRIE_ARENA_MAX_CLASS_SIZE / 2,
+        sb_strdup("medium"));
+    sb_trie_insert_len(trie, key, SB_TRIE_ARENA_MAX_CLASS_SIZE + 16,
+        sb_strdup("large"));
+    sb_trie_insert_len(trie, key, 16, sb_strdup("short"));
+    assert_int_equal(sb_trie_size(trie), 4);
+    assert_string_equal(sb_trie_lookup(trie, key), "long");
+    assert_string_equal(sb_trie_lookup_len(trie, key,
+        SB_TRIE_ARENA_MAX_CLASS_SIZE / 2), "medium");
+    assert_string_equal(sb_trie_lookup_len(trie, key,
+        SB_TRIE_ARENA_MAX_CLASS_SIZE + 16), "large");
+    assert_string_equal(sb_trie_lookup_len(trie, key, 16), "short");
+
+    // root, and a node for each key.
+    sb_trie_memory_usage(trie, &nodes, NULL);
+    assert_int_equal(nodes, 5);
+
+    assert_true(sb_trie_remove(trie, key));
+    assert_true(sb_trie_remove_len(trie, key,
+        SB_TRIE_ARENA_MAX_CLASS_SIZE + 16));
+    assert_true(sb_trie_remove_len(trie, key,
+        SB_TRIE_ARENA_MAX_CLASS_SIZE / 2));
+    assert_true(sb_trie_remove_len(trie, key, 16));
+    assert_int_equal(sb_trie_size(trie), 0);
+
+    // only the chunks are left.
+    sb_trie_memory_usage(trie, &nodes, &bytes);
+    assert_null(trie->arena.large);
+    size_t chunks = 0;
+    for (sb_trie_arena_chunk_t *c = trie->arena.chunks; c != NULL; c = c->next)
+        chunks += sizeof(sb_trie_arena_chunk_t) + c->size;
+    assert_int_equal(bytes, sizeof(sb_trie_t) + chunks);
+
+    sb_trie_free(trie);
+    free(key);
+}
+
+
+static void
+test_trie_filter(void **state)
+{
+    size_t filtered = 1;
+    size_t walked = 1;
+    char key[32];
+
+    sb_trie_t *trie = sb_trie_new(free);
+    assert_false(sb_trie_enable_filter(NULL, 0.01));
+    assert_false(sb_trie_enable_filter(trie, 0));
+    assert_false(sb_trie_enable_filter(trie, 1));
+    assert_false(sb_trie_enable_filter(trie, -0.5));
+    assert_null(trie->filter);
+    sb_trie_filter_stats(trie, &filtered, &walked);
+    assert_int_equal(filtered, 0);
+    assert_int_equal(walked, 0);
+
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    sb_trie_insert(trie, "chu", sb_strdup("nda"));
+    assert_true(sb_trie_enable_filter(trie, 0.01));
+    assert_non_null(trie->filter);
+    assert_int_equal(trie->filter->num_hashes, 7);
+    assert_int_equal(trie->filter->capacity, SB_TRIE_FILTER_MIN_CAPACITY);
+    assert_int_equal(trie->filter->num_keys, 2);
+    assert_string_equal(sb_trie_lookup(trie, "bola"), "guda");
+    assert_string_equal(sb_trie_lookup(trie, "chu"), "nda");
+    sb_trie_filter_stats(trie, &filtered, &walked);
+    assert_int_equal(filtered, 0);
+    assert_int_equal(walked, 2);
+
+    // the filter grows with the trie, and never rejects existing keys.
+    for (size_t i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        sb_trie_insert(trie, key, sb_strdup(key));
+    }
+    bool created;
+    void **slot = sb_trie_get_slot(trie, "slot", &created);
+    assert_true(created);
+    *slot = sb_strdup("data");
+    sb_trie_insert(trie, "bola", sb_strdup("asdf"));
+    assert_int_equal(sb_trie_size(trie), 1003);
+    assert_int_equal(trie->filter->num_keys, 1003);
+    assert_true(trie->filter->capacity >= 1003);
+    for (size_t i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        assert_string_equal(sb_trie_lookup(trie, key), key);
+    }
+    assert_string_equal(sb_trie_lookup(trie, "slot"), "data");
+    assert_string_equal(sb_trie_lookup(trie, "bola"), "asdf");
+
+    // most of the missing keys are rejected by the filter.
+    sb_trie_filter_stats(trie, &filtered, &walked);
+    assert_int_equal(filtered, 0);
+    assert_int_equal(walked, 1004);
+    for (size_t i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "missing%zu", i);
+        assert_null(sb_trie_lookup(trie, key));
+        assert_false(sb_trie_remove(trie, key));
+    }
+    sb_trie_filter_stats(trie, &filtered, &walked);
+    assert_true(filtered > 950);
+    assert_int_equal(filtered + walked, 2004);
+
+    // removed keys are stale until the filter is rebuilt.
+    for (size_t i = 0; i < 900; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        assert_true(sb_trie_remove(trie, key));
+        assert_null(sb_trie_lookup(trie, key));
+    }
+    assert_int_equal(sb_trie_size(trie), 103);
+    assert_true(trie->filter->stale <= trie->filter->num_keys / 2);
+    assert_true(trie->filter->num_keys < 1003);
+    for (size_t i = 900; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        assert_string_equal(sb_trie_lookup(trie, key), key);
+    }
+
+    // a new rate rebuilds the filter, keeping the stats.
+    assert_true(sb_trie_enable_filter(trie, 0.5));
+    assert_int_equal(trie->filter->num_hashes, 1);
+    assert_int_equal(trie->filter->num_keys, 103);
+    assert_int_equal(trie->filter->stale, 0);
+    assert_string_equal(sb_trie_lookup(trie, "chu"), "nda");
+    sb_trie_filter_stats(trie, &filtered, NULL);
+    assert_true(filtered > 950);
+
+    sb_trie_disable_filter(trie);
+    assert_null(trie->filter);
+    sb_trie_filter_stats(trie, &filtered, &walked);
+    assert_int_equal(filtered, 0);
+    assert_int_equal(walked, 0);
+    assert_string_equal(sb_trie_lookup(trie, "chu"), "nda");
+    sb_trie_disable_filter(trie);
+    sb_trie_disable_filter(NULL);
+    sb_trie_free(trie);
+
+    // concurrent tries don't support filters.
+    trie = sb_trie_new_concurrent(NULL);
+    if (trie != NULL) {
+        assert_false(sb_trie_enable_filter(trie, 0.01));
+        sb_trie_free(trie);
+    }
+
+    sb_trie_filter_stats(NULL, &filtered, &walked);
+    assert_int_equal(filtered, 0);
+    assert_int_equal(walked, 0);
 }
 
 
 static size_t counter;
-static char *expected_keys[] = {"chu", "copa", "bola", "bote", "bo", "b", "test", "testa"};
-static char *expected_datas[] = {"nda", "bu", "guda", "aba", "haha", "c", "asd", "lol"};
+static char *expected_keys[] = {"b", "bo", "bola", "bote", "chu", "copa", "test", "testa"};
+static char *expected_datas[] = {"c", "haha", "guda", "aba", "nda", "bu", "asd", "lol"};
 
 static void
 mock_foreach(const char *key, void *data, void *user_data)
@@ -405,50 +596,1220 @@ test_trie_foreach(void **state)
 }
 
 
+static void
+mock_foreach_prefix(const char *key, void *data, void *user_data)
+{
+    sb_string_t *str = user_data;
+    sb_string_append_printf(str, "%s=%s;", key, (char*) data);
+}
+
+
+static void
+test_trie_foreach_prefix(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+
+    sb_trie_insert(trie, "chu", sb_strdup("nda"));
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    sb_trie_insert(trie, "bote", sb_strdup("aba"));
+    sb_trie_insert(trie, "bo", sb_strdup("haha"));
+    sb_trie_insert(trie, "copa", sb_strdup("bu"));
+    sb_trie_insert(trie, "b", sb_strdup("c"));
+    sb_trie_insert(trie, "test", sb_strdup("asd"));
+    sb_trie_insert(trie, "testa", sb_strdup("lol"));
+
+    sb_string_t *str = sb_string_new();
+    sb_trie_foreach_prefix(trie, "bo", mock_foreach_prefix, str);
+    assert_string_equal(str->str, "bo=haha;bola=guda;bote=aba;");
+    sb_string_free(str, true);
+
+    str = sb_string_new();
+    sb_trie_foreach_prefix(trie, "bol", mock_foreach_prefix, str);
+    assert_string_equal(str->str, "bola=guda;");
+    sb_string_free(str, true);
+
+    str = sb_string_new();
+    sb_trie_foreach_prefix(trie, "t", mock_foreach_prefix, str);
+    assert_string_equal(str->str, "test=asd;testa=lol;");
+    sb_string_free(str, true);
+
+    str = sb_string_new();
+    sb_trie_foreach_prefix(trie, "testa", mock_foreach_prefix, str);
+    assert_string_equal(str->str, "testa=lol;");
+    sb_string_free(str, true);
+
+    str = sb_string_new();
+    sb_trie_foreach_prefix(trie, "", mock_foreach_prefix, str);
+    assert_string_equal(str->str, "b=c;bo=haha;bola=guda;bote=aba;chu=nda;"
+        "copa=bu;test=asd;testa=lol;");
+    sb_string_free(str, true);
+
+    str = sb_string_new();
+    sb_trie_foreach_prefix(trie, "x", mock_foreach_prefix, str);
+    sb_trie_foreach_prefix(trie, "bolax", mock_foreach_prefix, str);
+    sb_trie_foreach_prefix(trie, "bx", mock_foreach_prefix, str);
+    sb_trie_foreach_prefix(trie, "testab", mock_foreach_prefix, str);
+    sb_trie_foreach_prefix(trie, NULL, mock_foreach_prefix, str);
+    sb_trie_foreach_prefix(NULL, "b", mock_foreach_prefix, str);
+    sb_trie_foreach_prefix(trie, "b", NULL, str);
+    assert_string_equal(str->str, "");
+    sb_string_free(str, true);
+
+    sb_trie_free(trie);
+}
+
+
+static void
+test_trie_longest_prefix(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    size_t len = 1;
+
+    assert_null(sb_trie_longest_prefix(trie, "/api/v1", &len));
+    assert_int_equal(len, 0);
+
+    sb_trie_insert(trie, "/api", sb_strdup("api"));
+    sb_trie_insert(trie, "/api/v1/", sb_strdup("v1"));
+    sb_trie_insert(trie, "/api/v2/users", sb_strdup("v2-users"));
+    sb_trie_insert(trie, "/static", sb_strdup("static"));
+
+    assert_string_equal(sb_trie_longest_prefix(trie, "/api/v1/users", &len),
+        "v1");
+    assert_int_equal(len, 8);
+    assert_string_equal(sb_trie_longest_prefix(trie, "/api/v1/", &len), "v1");
+    assert_int_equal(len, 8);
+    assert_string_equal(sb_trie_longest_prefix(trie, "/api/v1", &len), "api");
+    assert_int_equal(len, 4);
+    assert_string_equal(sb_trie_longest_prefix(trie, "/api/v2/user", &len),
+        "api");
+    assert_int_equal(len, 4);
+    assert_string_equal(sb_trie_longest_prefix(trie, "/api/v2/users/1", &len),
+        "v2-users");
+    assert_int_equal(len, 13);
+    assert_string_equal(sb_trie_longest_prefix(trie, "/static", NULL),
+        "static");
+    assert_null(sb_trie_longest_prefix(trie, "/ap", &len));
+    assert_int_equal(len, 0);
+    assert_null(sb_trie_longest_prefix(trie, "", &len));
+    assert_int_equal(len, 0);
+
+    sb_trie_insert(trie, "", sb_strdup("root"));
+    assert_string_equal(sb_trie_longest_prefix(trie, "/ap", &len), "root");
+    assert_int_equal(len, 0);
+    assert_string_equal(sb_trie_longest_prefix(trie, "/apix", &len), "api");
+    assert_int_equal(len, 4);
+
+    assert_null(sb_trie_longest_prefix(trie, NULL, &len));
+    assert_null(sb_trie_longest_prefix(NULL, "/api", &len));
+    assert_int_equal(len, 0);
+
+    sb_trie_free(trie);
+}
+
+
+static size_t free_counter;
+
+static void
+mock_free(void *ptr)
+{
+    free_counter++;
+    free(ptr);
+}
+
+
+static void
+test_trie_remove(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(mock_free);
+    sb_trie_node4_t *root;
+    sb_trie_node4_t *bo;
+    size_t nodes;
+
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    sb_trie_insert(trie, "chu", sb_strdup("nda"));
+    sb_trie_insert(trie, "bote", sb_strdup("aba"));
+    sb_trie_insert(trie, "bo", sb_strdup("haha"));
+    free_counter = 0;
+
+    assert_false(sb_trie_remove(trie, "b"));
+    assert_false(sb_trie_remove(trie, "bol"));
+    assert_false(sb_trie_remove(trie, "bolas"));
+    assert_false(sb_trie_remove(trie, "x"));
+    assert_false(sb_trie_remove(trie, ""));
+    assert_false(sb_trie_remove(trie, NULL));
+    assert_false(sb_trie_remove(NULL, "bola"));
+    assert_int_equal(free_counter, 0);
+    assert_int_equal(sb_trie_size(trie), 4);
+
+    // node with children: only the data goes away
+    assert_true(sb_trie_remove(trie, "bo"));
+    assert_int_equal(free_counter, 1);
+    assert_int_equal(sb_trie_size(trie), 3);
+    assert_null(sb_trie_lookup(trie, "bo"));
+    assert_false(sb_trie_remove(trie, "bo"));
+    root = (sb_trie_node4_t*) trie->root;
+    bo = (sb_trie_node4_t*) root->children[0];
+    assert_memory_equal(sb_trie_node_key(&bo->base), "bo", 2);
+    assert_null(bo->base.data);
+    assert_int_equal(bo->base.num_children, 2);
+
+    // leaf: pruned, and its parent is merged with its remaining child
+    assert_true(sb_trie_remove(trie, "bote"));
+    assert_int_equal(free_counter, 2);
+    assert_int_equal(sb_trie_size(trie), 2);
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.num_children, 2);
+    assert_int_equal(root->keys[0], 'b');
+    assert_int_equal(root->children[0]->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(root->children[0]->key_len, 4);
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "bola", 4);
+    assert_string_equal(root->children[0]->data, "guda");
+    assert_int_equal(root->keys[1], 'c');
+    sb_trie_memory_usage(trie, &nodes, NULL);
+    assert_int_equal(nodes, 3);
+
+    assert_true(sb_trie_remove(trie, "chu"));
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->base.num_children, 1);
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "bola", 4);
+    assert_string_equal(sb_trie_lookup(trie, "bola"), "guda");
+
+    // last key: the trie is empty again
+    assert_true(sb_trie_remove(trie, "bola"));
+    assert_int_equal(free_counter, 4);
+    assert_int_equal(sb_trie_size(trie), 0);
+    assert_null(trie->root);
+    sb_trie_memory_usage(trie, &nodes, NULL);
+    assert_int_equal(nodes, 0);
+
+    // and usable
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    sb_trie_insert(trie, "bolaoo", sb_strdup("asdf"));
+    sb_trie_insert(trie, "", sb_strdup("empty"));
+    assert_true(sb_trie_remove(trie, "bola"));
+    root = (sb_trie_node4_t*) trie->root;
+    assert_string_equal(root->base.data, "empty");
+    assert_int_equal(root->children[0]->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(root->children[0]->key_len, 6);
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "bolaoo", 6);
+    assert_true(sb_trie_remove(trie, "bolaoo"));
+    assert_int_equal(trie->root->type, SB_TRIE_NODE_LEAF);
+    assert_string_equal(trie->root->data, "empty");
+    assert_true(sb_trie_remove(trie, ""));
+    assert_null(trie->root);
+
+    free_counter = 0;
+    sb_trie_free(trie);
+    assert_int_equal(free_counter, 0);
+}
+
+
+static void
+test_trie_remove_shrink(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    char key[3] = {'a', 0, 0};
+
+    for (int i = 1; i < 256; i++) {
+        key[1] = i;
+        sb_trie_insert(trie, key, sb_strndup(key + 1, 1));
+    }
+
+    for (int i = 1; i < 255; i++) {
+        key[1] = i;
+        assert_true(sb_trie_remove(trie, key));
+        assert_null(sb_trie_lookup(trie, key));
+
+        sb_trie_node_t *a = ((sb_trie_node4_t*) trie->root)->children[0];
+        size_t n = 255 - i;
+        if (n == 1) {
+            // merged with the last child
+            assert_int_equal(a->type, SB_TRIE_NODE_LEAF);
+            assert_int_equal(a->key_len, 2);
+            break;
+        }
+        assert_int_equal(a->num_children, n);
+        if (n <= 3)
+            assert_int_equal(a->type, SB_TRIE_NODE_4);
+        else if (n <= 12)
+            assert_int_equal(a->type, SB_TRIE_NODE_16);
+        else if (n <= 40)
+            assert_int_equal(a->type, SB_TRIE_NODE_48);
+        else
+            assert_int_equal(a->type, SB_TRIE_NODE_256);
+
+        for (int j = i + 1; j < 256; j++) {
+            key[1] = j;
+            char *data = sb_trie_lookup(trie, key);
+            assert_non_null(data);
+            assert_int_equal((unsigned char) *data, j);
+        }
+    }
+
+    assert_int_equal(sb_trie_size(trie), 1);
+    assert_string_equal(sb_trie_lookup(trie, "a\xff"), "\xff");
+
+    // removing and adding children around the boundaries does not grow and
+    // shrink the node every time.
+    for (int i = 1; i < 17; i++) {
+        key[1] = i;
+        sb_trie_insert(trie, key, sb_strndup(key + 1, 1));
+    }
+    sb_trie_node_t *a = ((sb_trie_node4_t*) trie->root)->children[0];
+    assert_int_equal(a->type, SB_TRIE_NODE_48);
+    key[1] = 1;
+    assert_true(sb_trie_remove(trie, key));
+    a = ((sb_trie_node4_t*) trie->root)->children[0];
+    assert_int_equal(a->type, SB_TRIE_NODE_48);
+    sb_trie_insert(trie, key, sb_strndup(key + 1, 1));
+    a = ((sb_trie_node4_t*) trie->root)->children[0];
+    assert_int_equal(a->type, SB_TRIE_NODE_48);
+
+    sb_trie_free(trie);
+}
+
+
 static void
 test_trie_inserted_after_prefix(void **state)
 {
     sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_node4_t *root;
+    sb_trie_node4_t *bola;
 
     sb_trie_insert(trie, "bola", sb_strdup("guda"));
-    assert_true(trie->root->key == 'b');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'o');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'l');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == 'a');
-    assert_null(trie->root->child->child->child->data);
-    assert_true(trie->root->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->data, "guda");
+    root = (sb_trie_node4_t*) trie->root;
+    assert_int_equal(root->children[0]->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(root->children[0]->key_len, 4);
+    assert_memory_equal(sb_trie_node_key(root->children[0]), "bola", 4);
+    assert_string_equal(root->children[0]->data, "guda");
 
     sb_trie_insert(trie, "bolaoo", sb_strdup("asdf"));
-    assert_true(trie->root->key == 'b');
-    assert_null(trie->root->data);
-    assert_true(trie->root->child->key == 'o');
-    assert_null(trie->root->child->data);
-    assert_true(trie->root->child->child->key == 'l');
-    assert_null(trie->root->child->child->data);
-    assert_true(trie->root->child->child->child->key == 'a');
-    assert_null(trie->root->child->child->child->data);
-    assert_true(trie->root->child->child->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->data, "guda");
-    assert_non_null(trie->root->child->child->child->child->next);
-    assert_true(trie->root->child->child->child->child->next->key == 'o');
-    assert_null(trie->root->child->child->child->child->next->data);
-    assert_true(trie->root->child->child->child->child->next->child->key == 'o');
-    assert_null(trie->root->child->child->child->child->next->child->data);
-    assert_true(trie->root->child->child->child->child->next->child->child->key == '\0');
-    assert_string_equal(trie->root->child->child->child->child->next->child->child->data, "asdf");
+    root = (sb_trie_node4_t*) trie->root;
+    bola = (sb_trie_node4_t*) root->children[0];
+    assert_int_equal(bola->base.type, SB_TRIE_NODE_4);
+    assert_int_equal(bola->base.key_len, 4);
+    assert_memory_equal(sb_trie_node_key(&bola->base), "bola", 4);
+    assert_string_equal(bola->base.data, "guda");
+    assert_int_equal(bola->base.num_children, 1);
+    assert_int_equal(bola->keys[0], 'o');
+    assert_int_equal(bola->children[0]->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(bola->children[0]->key_len, 2);
+    assert_memory_equal(sb_trie_node_key(bola->children[0]), "oo", 2);
+    assert_string_equal(bola->children[0]->data, "asdf");
 
     assert_int_equal(sb_trie_size(trie), 2);
     assert_string_equal(sb_trie_lookup(trie, "bola"), "guda");
     assert_string_equal(sb_trie_lookup(trie, "bolaoo"), "asdf");
+    assert_null(sb_trie_lookup(trie, "bol"));
+    assert_null(sb_trie_lookup(trie, "bolao"));
+
+    sb_trie_free(trie);
+}
+
+
+static void
+test_trie_empty_key(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+
+    sb_trie_insert(trie, "", sb_strdup("guda"));
+    assert_int_equal(trie->root->type, SB_TRIE_NODE_LEAF);
+    assert_int_equal(trie->root->key_len, 0);
+    assert_string_equal(trie->root->data, "guda");
+
+    sb_trie_insert(trie, "bola", sb_strdup("asdf"));
+    assert_int_equal(trie->root->type, SB_TRIE_NODE_4);
+    assert_int_equal(trie->root->key_len, 0);
+    assert_string_equal(trie->root->data, "guda");
+
+    assert_int_equal(sb_trie_size(trie), 2);
+    assert_string_equal(sb_trie_lookup(trie, ""), "guda");
+    assert_string_equal(sb_trie_lookup(trie, "bola"), "asdf");
 
     sb_trie_free(trie);
 }
 
 
+static void
+mock_foreach_len(const char *key, size_t key_len, void *data,
+    void *user_data)
+{
+    sb_string_t *str = user_data;
+    for (size_t i = 0; i < key_len; i++)
+        sb_string_append_printf(str, "%02x", (unsigned char) key[i]);
+    assert_int_equal(key[key_len], 0);
+    sb_string_append_printf(str, "=%s;", (char*) data);
+}
+
+
+static void
+test_trie_binary_keys(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+
+    // keys that differ only after a NUL byte, and keys that end with one.
+    sb_trie_insert_len(trie, "a\0b", 3, sb_strdup("anb"));
+    sb_trie_insert_len(trie, "a\0c", 3, sb_strdup("anc"));
+    sb_trie_insert_len(trie, "a\0", 2, sb_strdup("an"));
+    sb_trie_insert_len(trie, "\0", 1, sb_strdup("n"));
+    sb_trie_insert(trie, "a", sb_strdup("a"));
+    assert_int_equal(sb_trie_size(trie), 5);
+
+    assert_string_equal(sb_trie_lookup_len(trie, "a\0b", 3), "anb");
+    assert_string_equal(sb_trie_lookup_len(trie, "a\0c", 3), "anc");
+    assert_string_equal(sb_trie_lookup_len(trie, "a\0", 2), "an");
+    assert_string_equal(sb_trie_lookup_len(trie, "\0", 1), "n");
+    assert_string_equal(sb_trie_lookup_len(trie, "a", 1), "a");
+    assert_string_equal(sb_trie_lookup(trie, "a"), "a");
+    assert_null(sb_trie_lookup_len(trie, "a\0d", 3));
+    assert_null(sb_trie_lookup_len(trie, "", 0));
+    assert_null(sb_trie_lookup_len(trie, "a\0b", 2 + 2));
+    assert_null(sb_trie_lookup(trie, ""));
+
+    size_t len;
+    assert_string_equal(sb_trie_longest_prefix_len(trie, "a\0bc", 4, &len),
+        "anb");
+    assert_int_equal(len, 3);
+    assert_string_equal(sb_trie_longest_prefix_len(trie, "a\0d", 3, &len),
+        "an");
+    assert_int_equal(len, 2);
+    assert_string_equal(sb_trie_longest_prefix(trie, "a\0b", &len), "a");
+    assert_int_equal(len, 1);
+
+    sb_string_t *str = sb_string_new();
+    sb_trie_foreach_len(trie, mock_foreach_len, str);
+    assert_string_equal(str->str, "00=n;61=a;6100=an;610062=anb;610063=anc;");
+    sb_string_free(str, true);
+
+    str = sb_string_new();
+    sb_trie_foreach_prefix_len(trie, "a\0", 2, mock_foreach_len, str);
+    assert_string_equal(str->str, "6100=an;610062=anb;610063=anc;");
+    sb_string_free(str, true);
+
+    size_t image_len;
+    char *buf = sb_trie_freeze(trie, NULL, NULL, &image_len);
+    sb_trie_image_t *image = sb_trie_image_new(buf, image_len, NULL);
+    assert_non_null(image);
+    assert_string_equal(sb_trie_image_lookup_len(image, "a\0c", 3, &len),
+        "anc");
+    assert_int_equal(len, 3);
+    assert_string_equal(sb_trie_image_lookup_len(image, "\0", 1, NULL), "n");
+    assert_null(sb_trie_image_lookup_len(image, "a\0d", 3, NULL));
+    assert_string_equal(sb_trie_image_lookup(image, "a", NULL), "a");
+    str = sb_string_new();
+    sb_trie_image_foreach_len(image, mock_foreach_len, str);
+    sb_trie_image_foreach_len(NULL, mock_foreach_len, str);
+    sb_trie_image_foreach_len(image, NULL, str);
+    assert_string_equal(str->str, "00=n;61=a;6100=an;610062=anb;610063=anc;");
+    sb_string_free(str, true);
+    sb_trie_image_free(image);
+    free(buf);
+
+    assert_false(sb_trie_remove_len(trie, "a\0d", 3));
+    assert_true(sb_trie_remove_len(trie, "a\0", 2));
+    assert_null(sb_trie_lookup_len(trie, "a\0", 2));
+    assert_string_equal(sb_trie_lookup_len(trie, "a\0b", 3), "anb");
+    assert_true(sb_trie_remove_len(trie, "a\0b", 3));
+    assert_true(sb_trie_remove_len(trie, "a\0c", 3));
+    assert_true(sb_trie_remove_len(trie, "\0", 1));
+    assert_int_equal(sb_trie_size(trie), 1);
+    assert_string_equal(sb_trie_lookup(trie, "a"), "a");
+
+    assert_null(sb_trie_lookup_len(NULL, "a", 1));
+    assert_null(sb_trie_lookup_len(trie, NULL, 0));
+    assert_false(sb_trie_remove_len(trie, NULL, 0));
+
+    sb_trie_free(trie);
+}
+
+
+static char*
+mock_iter(sb_trie_iter_t *iter, size_t n)
+{
+    sb_string_t *str = sb_string_new();
+    const char *key;
+    size_t key_len;
+    void *data;
+    for (size_t i = 0; i < n && sb_trie_iter_next(iter, &key, &key_len, &data);
+        i++)
+    {
+        assert_int_equal(strlen(key), key_len);
+        sb_string_append_printf(str, "%s=%s;", key, (char*) data);
+    }
+    return sb_string_free(str, false);
+}
+
+
+static void
+test_trie_iter(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_iter_t iter;
+    char *str;
+
+    sb_trie_iter_init(&iter, trie);
+    assert_false(sb_trie_iter_next(&iter, NULL, NULL, NULL));
+    sb_trie_iter_clear(&iter);
+
+    sb_trie_insert(trie, "chu", sb_strdup("nda"));
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    sb_trie_insert(trie, "bote", sb_strdup("aba"));
+    sb_trie_insert(trie, "bo", sb_strdup("haha"));
+    sb_trie_insert(trie, "copa", sb_strdup("bu"));
+    sb_trie_insert(trie, "b", sb_strdup("c"));
+    sb_trie_insert(trie, "test", sb_strdup("asd"));
+    sb_trie_insert(trie, "testa", sb_strdup("lol"));
+    sb_trie_insert(trie, "", sb_strdup("empty"));
+
+    sb_trie_iter_init(&iter, trie);
+    str = mock_iter(&iter, -1);
+    assert_string_equal(str, "=empty;b=c;bo=haha;bola=guda;bote=aba;chu=nda;"
+        "copa=bu;test=asd;testa=lol;");
+    free(str);
+    assert_false(sb_trie_iter_next(&iter, NULL, NULL, NULL));
+
+    // pages of 3 elements.
+    sb_trie_iter_seek(&iter, "");
+    str = mock_iter(&iter, 3);
+    assert_string_equal(str, "=empty;b=c;bo=haha;");
+    free(str);
+    str = mock_iter(&iter, 3);
+    assert_string_equal(str, "bola=guda;bote=aba;chu=nda;");
+    free(str);
+    str = mock_iter(&iter, 3);
+    assert_string_equal(str, "copa=bu;test=asd;testa=lol;");
+    free(str);
+    str = mock_iter(&iter, 3);
+    assert_string_equal(str, "");
+    free(str);
+
+    sb_trie_iter_seek(&iter, "bo");
+    str = mock_iter(&iter, 2);
+    assert_string_equal(str, "bo=haha;bola=guda;");
+    free(str);
+    sb_trie_iter_seek(&iter, "bol");
+    str = mock_iter(&iter, 1);
+    assert_string_equal(str, "bola=guda;");
+    free(str);
+    sb_trie_iter_seek(&iter, "bolb");
+    str = mock_iter(&iter, 2);
+    assert_string_equal(str, "bote=aba;chu=nda;");
+    free(str);
+    sb_trie_iter_seek(&iter, "bolaa");
+    str = mock_iter(&iter, 1);
+    assert_string_equal(str, "bote=aba;");
+    free(str);
+    sb_trie_iter_seek(&iter, "a");
+    str = mock_iter(&iter, 1);
+    assert_string_equal(str, "b=c;");
+    free(str);
+    sb_trie_iter_seek(&iter, "cop");
+    str = mock_iter(&iter, 1);
+    assert_string_equal(str, "copa=bu;");
+    free(str);
+    sb_trie_iter_seek(&iter, "tes");
+    str = mock_iter(&iter, -1);
+    assert_string_equal(str, "test=asd;testa=lol;");
+    free(str);
+    sb_trie_iter_seek(&iter, "testaa");
+    assert_false(sb_trie_iter_next(&iter, NULL, NULL, NULL));
+    sb_trie_iter_seek(&iter, "u");
+    assert_false(sb_trie_iter_next(&iter, NULL, NULL, NULL));
+
+    // resume after modifying the trie.
+    sb_trie_iter_seek(&iter, "bola");
+    assert_true(sb_trie_remove(trie, "bola"));
+    sb_trie_insert(trie, "bolb", sb_strdup("x"));
+    sb_trie_iter_seek(&iter, "bola");
+    str = mock_iter(&iter, 2);
+    assert_string_equal(str, "bolb=x;bote=aba;");
+    free(str);
+    sb_trie_iter_clear(&iter);
+    sb_trie_iter_clear(&iter);
+
+    sb_trie_free(trie);
+
+    // all the node layouts.
+    trie = sb_trie_new(NULL);
+    char keys[256][3];
+    for (size_t i = 0; i < 256; i++) {
+        keys[i][0] = 'x';
+        keys[i][1] = (char) i;
+        keys[i][2] = (char) i;
+        if (i % 2 == 0)
+            sb_trie_insert_len(trie, keys[i], 3, keys[i]);
+    }
+    for (size_t n = 0; n < 256; n++) {
+        char key[2] = {'x', (char) n};
+        sb_trie_iter_init(&iter, trie);
+        sb_trie_iter_seek_len(&iter, key, 2);
+        const char *k;
+        size_t k_len;
+        void *data;
+        for (size_t i = n + n % 2; i < 256; i += 2) {
+            assert_true(sb_trie_iter_next(&iter, &k, &k_len, &data));
+            assert_int_equal(k_len, 3);
+            assert_memory_equal(k, keys[i], 3);
+            assert_true(data == keys[i]);
+        }
+        assert_false(sb_trie_iter_next(&iter, &k, &k_len, &data));
+        sb_trie_iter_clear(&iter);
+        if (n % 2 == 0 && n < 250)
+            sb_trie_remove_len(trie, keys[n], 3);
+    }
+    sb_trie_free(trie);
+
+    sb_trie_iter_init(&iter, NULL);
+    assert_false(sb_trie_iter_next(&iter, NULL, NULL, NULL));
+    sb_trie_iter_clear(&iter);
+    assert_false(sb_trie_iter_next(NULL, NULL, NULL, NULL));
+}
+
+
+static size_t grow_counter;
+
+static void
+mock_foreach_grow(const char *key, void *data, void *user_data)
+{
+    grow_counter++;
+    assert_int_equal(strlen(key), 2);
+    assert_int_equal(key[0], 'a');
+    assert_int_equal((unsigned char) key[1], grow_counter);
+    assert_int_equal((unsigned char) *((char*) data), grow_counter);
+}
+
+
+static void
+test_trie_node_grow(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    char key[3] = {'a', 0, 0};
+
+    // insert in reverse order, to make sure that children stay sorted
+    // for every node type.
+    for (int i = 255; i > 0; i--) {
+        key[1] = i;
+        sb_trie_insert(trie, key, sb_strndup(key + 1, 1));
+
+        sb_trie_node_t *a = ((sb_trie_node4_t*) trie->root)->children[0];
+        size_t n = 256 - i;
+        if (n == 1) {
+            assert_int_equal(a->type, SB_TRIE_NODE_LEAF);
+            assert_int_equal(a->key_len, 2);
+            continue;
+        }
+        assert_int_equal(a->num_children, n);
+        if (n <= 4)
+            assert_int_equal(a->type, SB_TRIE_NODE_4);
+        else if (n <= 16)
+            assert_int_equal(a->type, SB_TRIE_NODE_16);
+        else if (n <= 48)
+            assert_int_equal(a->type, SB_TRIE_NODE_48);
+        else
+            assert_int_equal(a->type, SB_TRIE_NODE_256);
+        assert_int_equal(a->key_len, 1);
+        assert_memory_equal(sb_trie_node_key(a), "a", 1);
+
+        for (int j = 255; j >= i; j--) {
+            key[1] = j;
+            char *data = sb_trie_lookup(trie, key);
+            assert_non_null(data);
+            assert_int_equal((unsigned char) *data, j);
+        }
+        key[1] = i - 1;
+        assert_null(sb_trie_lookup(trie, key));
+    }
+
+    assert_int_equal(sb_trie_size(trie), 255);
+    grow_counter = 0;
+    sb_trie_foreach(trie, mock_foreach_grow, NULL);
+    assert_int_equal(grow_counter, 255);
+
+    sb_trie_free(trie);
+}
+
+
+static void
+test_trie_arena(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    char key[16];
+
+    for (size_t i = 0; i < 10000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        sb_trie_insert(trie, key, sb_strdup(key));
+    }
+
+    // nodes are carved from a few big chunks
+    size_t chunks = 0;
+    for (sb_trie_arena_chunk_t *c = trie->arena.chunks; c != NULL; c = c->next)
+        chunks++;
+    assert_true(chunks > 1);
+    assert_true(chunks < 32);
+    assert_null(trie->arena.large);
+
+    // nodes released when growing are reused
+    size_t free_blocks = 0;
+    for (size_t i = 0; i < SB_TRIE_ARENA_NUM_CLASSES; i++)
+        if (trie->arena.free_list[i] != NULL)
+            free_blocks++;
+    assert_true(free_blocks > 0);
+
+    // keys bigger than the biggest size class are allocated individually
+    char *big = malloc(SB_TRIE_ARENA_MAX_CLASS_SIZE + 1);
+    memset(big, 'a', SB_TRIE_ARENA_MAX_CLASS_SIZE);
+    big[SB_TRIE_ARENA_MAX_CLASS_SIZE] = '\0';
+    sb_trie_insert(trie, big, sb_strdup("big"));
+    assert_non_null(trie->arena.large);
+    assert_null(trie->arena.large->next);
+
+    for (size_t i = 0; i < 10000; i++) {
+        snprintf(key, sizeof(key), "key%zu", i);
+        assert_string_equal(sb_trie_lookup(trie, key), key);
+    }
+    assert_string_equal(sb_trie_lookup(trie, big), "big");
+    big[SB_TRIE_ARENA_MAX_CLASS_SIZE - 1] = '\0';
+    assert_null(sb_trie_lookup(trie, big));
+    free(big);
+
+    sb_trie_free(trie);
+}
+
+
+static size_t deep_counter;
+
+static void
+mock_foreach_deep(const char *key, void *data, void *user_data)
+{
+    // keys are visited in order: "aaa...ab" comes before "aa...ab"
+    size_t len = strlen(key);
+    assert_int_equal(len, *((size_t*) user_data) - deep_counter++);
+    assert_int_equal(key[len - 1], 'b');
+    assert_int_equal(len, strlen(data));
+}
+
+
+static void
+test_trie_deep(void **state)
+{
+    // a trie with one level per byte of the longest key, to make sure that
+    // walking it does not depend on native stack.
+    sb_trie_t *trie = sb_trie_new(free);
+    size_t depth = 5000;
+    char *key = malloc(depth + 2);
+
+    for (size_t i = 0; i <= depth; i++) {
+        memset(key, 'a', i);
+        key[i] = 'b';
+        key[i + 1] = '\0';
+        sb_trie_insert(trie, key, sb_strdup(key));
+    }
+
+    assert_int_equal(sb_trie_size(trie), depth + 1);
+    assert_string_equal(sb_trie_lookup(trie, key), key);
+
+    deep_counter = 0;
+    size_t max = depth + 1;
+    sb_trie_foreach(trie, mock_foreach_deep, &max);
+    assert_int_equal(deep_counter, depth + 1);
+
+    free(key);
+    sb_trie_free(trie);
+}
+
+
+static void
+test_trie_freeze(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_insert(trie, "chu", sb_strdup("nda"));
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    sb_trie_insert(trie, "bote", sb_strdup("aba"));
+    sb_trie_insert(trie, "bo", sb_strdup("haha"));
+    sb_trie_insert(trie, "copa", sb_strdup("bu"));
+    sb_trie_insert(trie, "b", sb_strdup("c"));
+    sb_trie_insert(trie, "test", sb_strdup("asd"));
+    sb_trie_insert(trie, "testa", sb_strdup("lol"));
+    sb_trie_insert(trie, "", sb_strdup("empty"));
+
+    // enough children for all the node layouts.
+    char key[3] = {'x', 0, 0};
+    for (size_t i = 1; i < 256; i++) {
+        key[1] = i;
+        sb_trie_insert(trie, key, sb_strdup(key));
+    }
+
+    size_t len;
+    assert_null(sb_trie_freeze(NULL, NULL, NULL, &len));
+    assert_null(sb_trie_freeze(trie, NULL, NULL, NULL));
+    char *buf = sb_trie_freeze(trie, NULL, NULL, &len);
+    assert_non_null(buf);
+    assert_int_equal(len % 8, 0);
+    sb_trie_free(trie);
+
+    sb_trie_image_t *image = sb_trie_image_new(buf, len, NULL);
+    assert_non_null(image);
+    assert_int_equal(sb_trie_image_size(image), 264);
+
+    size_t value_len;
+    assert_string_equal(sb_trie_image_lookup(image, "bo", &value_len),
+        "haha");
+    assert_int_equal(value_len, 4);
+    assert_string_equal(sb_trie_image_lookup(image, "bola", NULL), "guda");
+    assert_string_equal(sb_trie_image_lookup(image, "testa", NULL), "lol");
+    assert_string_equal(sb_trie_image_lookup(image, "", NULL), "empty");
+    assert_string_equal(sb_trie_image_lookup(image, "x\x80", NULL), "x\x80");
+    assert_string_equal(sb_trie_image_lookup(image, "x\xff", NULL), "x\xff");
+    assert_null(sb_trie_image_lookup(image, "x", &value_len));
+    assert_int_equal(value_len, 0);
+    assert_null(sb_trie_image_lookup(image, "bol", NULL));
+    assert_null(sb_trie_image_lookup(image, "bolas", NULL));
+    assert_null(sb_trie_image_lookup(image, "chub", NULL));
+    assert_null(sb_trie_image_lookup(image, "d", NULL));
+    assert_null(sb_trie_image_lookup(image, NULL, NULL));
+    assert_null(sb_trie_image_lookup(NULL, "bo", NULL));
+
+    sb_string_t *str = sb_string_new();
+    sb_trie_image_foreach(image, mock_foreach_prefix, str);
+    sb_trie_image_foreach(NULL, mock_foreach_prefix, str);
+    sb_trie_image_foreach(image, NULL, str);
+    assert_true(sb_str_starts_with(str->str,
+        "=empty;b=c;bo=haha;bola=guda;bote=aba;chu=nda;copa=bu;test=asd;"
+        "testa=lol;x\x01=x\x01;x\x02=x\x02;"));
+    assert_true(sb_str_ends_with(str->str, "x\xfe=x\xfe;x\xff=x\xff;"));
+    sb_string_free(str, true);
+
+    sb_trie_image_free(image);
+    free(buf);
+
+    // empty tries are valid, too.
+    trie = sb_trie_new(free);
+    buf = sb_trie_freeze(trie, NULL, NULL, &len);
+    sb_trie_free(trie);
+    image = sb_trie_image_new(buf, len, NULL);
+    assert_non_null(image);
+    assert_int_equal(sb_trie_image_size(image), 0);
+    assert_null(sb_trie_image_lookup(image, "", NULL));
+    str = sb_string_new();
+    sb_trie_image_foreach(image, mock_foreach_prefix, str);
+    assert_string_equal(str->str, "");
+    sb_string_free(str, true);
+    sb_trie_image_free(image);
+    free(buf);
+}
+
+
+static const void*
+mock_serialize(void *data, size_t *len, void *user_data)
+{
+    assert_string_equal(user_data, "foo");
+    *len = sizeof(int);
+    return data;
+}
+
+
+static void
+test_trie_freeze_serializer(void **state)
+{
+    int values[] = {10, 20, 30};
+    sb_trie_t *trie = sb_trie_new(NULL);
+    sb_trie_insert(trie, "a", &values[0]);
+    sb_trie_insert(trie, "ab", &values[1]);
+    sb_trie_insert(trie, "b", &values[2]);
+
+    size_t len;
+    char *buf = sb_trie_freeze(trie, mock_serialize, "foo", &len);
+    sb_trie_free(trie);
+
+    sb_trie_image_t *image = sb_trie_image_new(buf, len, NULL);
+    size_t value_len;
+    const int *v = sb_trie_image_lookup(image, "ab", &value_len);
+    assert_non_null(v);
+    assert_int_equal(value_len, sizeof(int));
+    assert_int_equal(*v, 20);
+    v = sb_trie_image_lookup(image, "b", NULL);
+    assert_int_equal(*v, 30);
+    sb_trie_image_free(image);
+    free(buf);
+}
+
+
+static void
+test_trie_image_invalid(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    size_t len;
+    char *buf = sb_trie_freeze(trie, NULL, NULL, &len);
+    sb_trie_free(trie);
+
+    sb_error_t *err = NULL;
+    assert_null(sb_trie_image_new(NULL, len, &err));
+    assert_null(err);
+    assert_null(sb_trie_image_new(buf, 10, &err));
+    assert_non_null(err);
+    assert_string_equal(sb_error_to_string(err),
+        "trie: Invalid image: Truncated header");
+    sb_error_free(err);
+    err = NULL;
+    assert_null(sb_trie_image_new(buf, len - 8, &err));
+    assert_non_null(err);
+    assert_string_equal(sb_error_to_string(err),
+        "trie: Invalid image: Wrong size");
+    sb_error_free(err);
+    err = NULL;
+    buf[0] = 'X';
+    assert_null(sb_trie_image_new(buf, len, &err));
+    assert_non_null(err);
+    assert_string_equal(sb_error_to_string(err),
+        "trie: Invalid image: Bad magic");
+    sb_error_free(err);
+    assert_null(sb_trie_image_new(buf, len, NULL));
+    free(buf);
+}
+
+
+static void
+test_trie_image_open(void **state)
+{
+    sb_trie_t *trie = sb_trie_new(free);
+    sb_trie_insert(trie, "bola", sb_strdup("guda"));
+    sb_trie_insert(trie, "bote", sb_strdup("aba"));
+    size_t len;
+    char *buf = sb_trie_freeze(trie, NULL, NULL, &len);
+    sb_trie_free(trie);
+
+    char path[] = "check_trie_XXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+
+    sb_error_t *err = NULL;
+    sb_file_put_contents(path, buf, len, &err);
+    assert_null(err);
+    free(buf);
+
+    sb_trie_image_t *image = sb_trie_image_open(path, &err);
+    assert_null(err);
+    assert_non_null(image);
+    assert_int_equal(sb_trie_image_size(image), 2);
+    assert_string_equal(sb_trie_image_lookup(image, "bote", NULL), "aba");
+    assert_null(sb_trie_image_lookup(image, "bot", NULL));
+    sb_trie_image_free(image);
+
+    sb_file_put_contents(path, "bola", 4, &err);
+    assert_null(sb_trie_image_open(path, &err));
+    assert_non_null(err);
+    sb_error_free(err);
+    err = NULL;
+    unlink(path);
+
+    assert_null(sb_trie_image_open(path, &err));
+    assert_non_null(err);
+    sb_error_free(err);
+}
+
+
+static size_t
+mock_retired(sb_trie_t *trie, size_t *nodes)
+{
+    size_t rv = 0;
+    *nodes = 0;
+    for (size_t i = 0; i < trie->sync->retired_len; i++) {
+        if (trie->sync->retired[i].size == 0)
+            rv++;
+        else
+            (*nodes)++;
+    }
+    return rv;
+}
+
+
+static void
+test_trie_concurrent(void **state)
+{
+    sb_trie_t *trie = sb_trie_new_concurrent(mock_free);
+    if (trie == NULL)  // not supported by the compiler
+        return;
+    assert_non_null(trie->sync);
+    assert_int_equal((uintptr_t) trie->sync % SB_TRIE_SYNC_CACHE_LINE, 0);
+    sb_trie_t *ref = sb_trie_new(free);
+
+    char key[16];
+    for (size_t i = 0; i < 300; i++) {
+        snprintf(key, sizeof(key), "k%zu", i * 7 % 300);
+        sb_trie_insert(trie, key, sb_strdup(key));
+        sb_trie_insert(ref, key, sb_strdup(key));
+    }
+
+    // updates never change nodes visible to readers.
+    sb_trie_node_t *root = trie->root;
+    sb_trie_node_t *k1 = ((sb_trie_node4_t*) root)->children[0];
+    void *data = sb_trie_lookup(trie, "k1");
+    size_t retired_nodes;
+    free_counter = 0;
+    size_t retired = mock_retired(trie, &retired_nodes);
+    sb_trie_insert(trie, "k1", sb_strdup("bola"));
+    assert_int_equal(free_counter + mock_retired(trie, &retired_nodes),
+        retired + 1);
+    assert_true(trie->root != root);
+    assert_true(((sb_trie_node4_t*) trie->root)->children[0] != k1);
+    assert_string_equal(sb_trie_lookup(trie, "k1"), "bola");
+    assert_true(sb_trie_lookup(trie, "k1") != data);
+    sb_trie_insert(trie, "k1", sb_strdup("k1"));
+
+    free_counter = 0;
+    retired = mock_retired(trie, &retired_nodes);
+    for (size_t i = 0; i < 300; i += 3) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        assert_true(sb_trie_remove(trie, key));
+        assert_true(sb_trie_remove(ref, key));
+        assert_false(sb_trie_remove(trie, key));
+    }
+    assert_int_equal(free_counter + mock_retired(trie, &retired_nodes),
+        retired + 100);
+    assert_false(sb_trie_remove(trie, "bola"));
+
+    // retired nodes are released in batches.
+    size_t nodes;
+    size_t ref_nodes;
+    sb_trie_memory_usage(trie, &nodes, NULL);
+    sb_trie_memory_usage(ref, &ref_nodes, NULL);
+    mock_retired(trie, &retired_nodes);
+    assert_int_equal(nodes - retired_nodes, ref_nodes);
+    assert_true(trie->sync->retired_len < SB_TRIE_SYNC_MAX_RETIRED);
+    assert_int_equal(trie->sync->fresh_len, 0);
+    assert_int_equal(sb_trie_size(trie), 200);
+
+    for (size_t i = 0; i < 300; i++) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        if (i % 3 == 0)
+            assert_null(sb_trie_lookup(trie, key));
+        else
+            assert_string_equal(sb_trie_lookup(trie, key), key);
+    }
+
+    sb_string_t *str = sb_string_new();
+    sb_string_t *ref_str = sb_string_new();
+    sb_trie_foreach(trie, mock_foreach_prefix, str);
+    sb_trie_foreach(ref, mock_foreach_prefix, ref_str);
+    assert_string_equal(str->str, ref_str->str);
+    sb_string_free(str, true);
+    sb_string_free(ref_str, true);
+
+    // critical sections can be nested.
+    unsigned int token1 = sb_trie_read_lock(trie);
+    unsigned int token2 = sb_trie_read_lock(trie);
+    assert_string_equal(sb_trie_lookup(trie, "k2"), "k2");
+    sb_trie_read_unlock(trie, token2);
+    sb_trie_read_unlock(trie, token1);
+    for (size_t i = 0; i < SB_TRIE_SYNC_STRIPES; i++) {
+        assert_int_equal(trie->sync->readers[0][i].count, 0);
+        assert_int_equal(trie->sync->readers[1][i].count, 0);
+    }
+
+    // a regular trie ignores critical sections.
+    assert_int_equal(sb_trie_read_lock(ref), 0);
+    sb_trie_read_unlock(ref, 0);
+
+    for (size_t i = 0; i < 300; i++) {
+        snprintf(key, sizeof(key), "k%zu", i);
+        sb_trie_remove(trie, key);
+    }
+    assert_null(trie->root);
+    sb_trie_memory_usage(trie, &nodes, NULL);
+    mock_retired(trie, &retired_nodes);
+    assert_int_equal(nodes, retired_nodes);
+
+    free_counter = 0;
+    retired = mock_retired(trie, &retired_nodes);
+    sb_trie_free(trie);
+    assert_int_equal(free_counter, retired);
+    sb_trie_free(ref);
+}
+
+
+static void
+test_trie_build_sorted(void **state)
+{
+    const char *keys[] = {"", "b", "bo", "bola", "bola", "bote", "chu", "copa",
+        "test", "testa"};
+    char *values[] = {"empty", "c", "haha", "guda1", "guda", "aba", "nda",
+        "bu", "asd", "lol"};
+    size_t n = sizeof(keys) / sizeof(keys[0]);
+
+    void **data = malloc(n * sizeof(void*));
+    for (size_t i = 0; i < n; i++)
+        data[i] = sb_strdup(values[i]);
+
+    free_counter = 0;
+    sb_trie_t *trie = sb_trie_build_sorted(keys, data, n, mock_free);
+    assert_non_null(trie);
+    assert_int_equal(free_counter, 1);
+    assert_int_equal(sb_trie_size(trie), 9);
+    assert_string_equal(sb_trie_lookup(trie, ""), "empty");
+    assert_string_equal(sb_trie_lookup(trie, "bola"), "guda");
+    assert_string_equal(sb_trie_lookup(trie, "testa"), "lol");
+    assert_null(sb_trie_lookup(trie, "bol"));
+    assert_null(sb_trie_lookup(trie, "t"));
+
+    sb_trie_t *ref = sb_trie_new(free);
+    for (size_t i = 0; i < n; i++)
+        sb_trie_insert(ref, keys[i], sb_strdup(values[i]));
+
+    sb_string_t *str = sb_string_new();
+    sb_string_t *ref_str = sb_string_new();
+    sb_trie_foreach(trie, mock_foreach_prefix, str);
+    sb_trie_foreach(ref, mock_foreach_prefix, ref_str);
+    assert_string_equal(str->str, ref_str->str);
+    sb_string_free(str, true);
+    sb_string_free(ref_str, true);
+
+    size_t nodes;
+    size_t ref_nodes;
+    sb_trie_memory_usage(trie, &nodes, NULL);
+    sb_trie_memory_usage(ref, &ref_nodes, NULL);
+    assert_int_equal(nodes, ref_nodes);
+
+    // the built trie is a regular trie.
+    assert_true(sb_trie_remove(trie, "bo"));
+    sb_trie_insert(trie, "bolas", sb_strdup("asd"));
+    assert_string_equal(sb_trie_lookup(trie, "bolas"), "asd");
+    assert_null(sb_trie_lookup(trie, "bo"));
+
+    free_counter = 0;
+    sb_trie_free(trie);
+    assert_int_equal(free_counter, 9);
+    sb_trie_free(ref);
+
+    // invalid input is rejected, and elements are not touched.
+    keys[1] = "z";
+    free_counter = 0;
+    assert_null(sb_trie_build_sorted(keys, data, n, mock_free));
+    keys[1] = "b";
+    data[2] = NULL;
+    assert_null(sb_trie_build_sorted(keys, data, n, mock_free));
+    assert_null(sb_trie_build_sorted(NULL, data, n, mock_free));
+    assert_int_equal(free_counter, 0);
+    free(data);
+
+    trie = sb_trie_build_sorted(NULL, NULL, 0, free);
+    assert_non_null(trie);
+    assert_null(trie->root);
+    assert_int_equal(sb_trie_size(trie), 0);
+    sb_trie_free(trie);
+}
+
+
+static void
+test_trie_build_sorted_len(void **state)
+{
+    // keys that differ only after a NUL byte, and keys that end with one.
+    const char *keys[] = {"\0", "a", "a\0", "a\0b", "a\0b", "a\0c", "ab"};
+    size_t key_lens[] = {1, 1, 2, 3, 3, 3, 2};
+    char *values[] = {"n", "a", "an", "anb1", "anb", "anc", "ab"};
+    size_t n = sizeof(keys) / sizeof(keys[0]);
+
+    void **data = malloc(n * sizeof(void*));
+    for (size_t i = 0; i < n; i++)
+        data[i] = sb_strdup(values[i]);
+
+    free_counter = 0;
+    sb_trie_t *trie = sb_trie_build_sorted_len(keys, key_lens, data, n,
+        mock_free);
+    assert_non_null(trie);
+    assert_int_equal(free_counter, 1);
+    assert_int_equal(sb_trie_size(trie), 6);
+    assert_string_equal(sb_trie_lookup_len(trie, "\0", 1), "n");
+    assert_string_equal(sb_trie_lookup_len(trie, "a", 1), "a");
+    assert_string_equal(sb_trie_lookup_len(trie, "a\0", 2), "an");
+    assert_string_equal(sb_trie_lookup_len(trie, "a\0b", 3), "anb");
+    assert_string_equal(sb_trie_lookup_len(trie, "a\0c", 3), "anc");
+    assert_string_equal(sb_trie_lookup(trie, "ab"), "ab");
+    assert_null(sb_trie_lookup_len(trie, "", 0));
+    assert_null(sb_trie_lookup_len(trie, "a\0d", 3));
+
+    sb_trie_t *ref = sb_trie_new(free);
+    for (size_t i = 0; i < n; i++)
+        sb_trie_insert_len(ref, keys[i], key_lens[i], sb_strdup(values[i]));
+
+    sb_string_t *str = sb_string_new();
+    sb_string_t *ref_str = sb_string_new();
+    sb_trie_foreach_len(trie, mock_foreach_len, str);
+    sb_trie_foreach_len(ref, mock_foreach_len, ref_str);
+    assert_string_equal(str->str, ref_str->str);
+    sb_string_free(str, true);
+    sb_string_free(ref_str, true);
+
+    size_t nodes;
+    size_t ref_nodes;
+    sb_trie_memory_usage(trie, &nodes, NULL);
+    sb_trie_memory_usage(ref, &ref_nodes, NULL);
+    assert_int_equal(nodes, ref_nodes);
+
+    free_counter = 0;
+    sb_trie_free(trie);
+    assert_int_equal(free_counter, 6);
+    sb_trie_free(ref);
+
+    // keys before their prefixes, and bytes after NUL bytes out of order,
+    // are rejected.
+    key_lens[4] = 2;
+    free_counter = 0;
+    assert_null(sb_trie_build_sorted_len(keys, key_lens, data, n, mock_free));
+    key_lens[4] = 3;
+    keys[4] = "a\0a";
+    assert_null(sb_trie_build_sorted_len(keys, key_lens, data, n, mock_free));
+    keys[4] = "a\0b";
+    assert_null(sb_trie_build_sorted_len(keys, NULL, data, n, mock_free));
+    assert_null(sb_trie_build_sorted_len(NULL, key_lens, data, n, mock_free));
+    assert_int_equal(free_counter, 0);
+    free(data);
+
+    trie = sb_trie_build_sorted_len(NULL, NULL, NULL, 0, free);
+    assert_non_null(trie);
+    assert_int_equal(sb_trie_size(trie), 0);
+    sb_trie_free(trie);
+}
+
+
+static void
+test_trie_build_sorted_node_types(void **state)
+{
+    // same layouts as the ones created by inserts.
+    char *keys[256];
+    size_t n = 0;
+    for (size_t i = 1; i < 256; i++) {
+        if (i < 5 || (i > 20 && i < 37) || (i > 50 && i < 99) || i > 100)
+            keys[n++] = sb_strdup_printf("a%c", (int) i);
+    }
+    keys[n++] = sb_strdup("b");
+
+    for (size_t c = 1; c <= n; c++) {
+        sb_trie_t *trie = sb_trie_build_sorted((const char *const*) keys,
+            (void**) keys, c, NULL);
+        sb_trie_t *ref = sb_trie_new(NULL);
+        for (size_t i = 0; i < c; i++)
+            sb_trie_insert(ref, keys[i], keys[i]);
+
+        sb_trie_node_t *a = ((sb_trie_node4_t*) trie->root)->children[0];
+        sb_trie_node_t *ref_a = ((sb_trie_node4_t*) ref->root)->children[0];
+        assert_int_equal(a->type, ref_a->type);
+        assert_int_equal(a->num_children, ref_a->num_children);
+        assert_int_equal(a->key_len, ref_a->key_len);
+        assert_int_equal(trie->root->num_children, ref->root->num_children);
+        for (size_t i = 0; i < c; i++)
+            assert_ptr_equal(sb_trie_lookup(trie, keys[i]), keys[i]);
+
+        sb_trie_free(trie);
+        sb_trie_free(ref);
+    }
+
+    for (size_t i = 0; i < n; i++)
+        free(keys[i]);
+}
+
+
 int
 main(void)
 {
@@ -456,11 +1817,33 @@ main(void)
         unit_test(test_trie_new),
         unit_test(test_trie_insert),
         unit_test(test_trie_insert_duplicated),
+        unit_test(test_trie_get_slot),
         unit_test(test_trie_keep_data),
         unit_test(test_trie_lookup),
         unit_test(test_trie_size),
+        unit_test(test_trie_memory_usage),
+        unit_test(test_trie_memory_usage_split),
+        unit_test(test_trie_filter),
         unit_test(test_trie_foreach),
+        unit_test(test_trie_foreach_prefix),
+        unit_test(test_trie_iter),
+        unit_test(test_trie_longest_prefix),
+        unit_test(test_trie_remove),
+        unit_test(test_trie_remove_shrink),
         unit_test(test_trie_inserted_after_prefix),
+        unit_test(test_trie_empty_key),
+        unit_test(test_trie_binary_keys),
+        unit_test(test_trie_node_grow),
+        unit_test(test_trie_arena),
+        unit_test(test_trie_deep),
+        unit_test(test_trie_build_sorted),
+        unit_test(test_trie_build_sorted_len),
+        unit_test(test_trie_build_sorted_node_types),
+        unit_test(test_trie_concurrent),
+        unit_test(test_trie_freeze),
+        unit_test(test_trie_freeze_serializer),
+        unit_test(test_trie_image_invalid),
+        unit_test(test_trie_image_open),
     };
     return run_tests(tests);
 }